@@ -0,0 +1,102 @@
+/*
+* BME280 driver hot paths: raw frame parsing, compensation and the
+* measurement delay computation. Built once per compensation backend
+* (BME280_FLOAT_ENABLE, BME280_64BIT_ENABLE, BME280_32BIT_ENABLE).
+*/
+
+#include <stdio.h>
+#include <string.h>
+
+#include <bme280.h>
+
+#include "benchlib.h"
+
+#if defined(BME280_64BIT_ENABLE)
+#define BACKEND "int64"
+#elif defined(BME280_32BIT_ENABLE)
+#define BACKEND "int32"
+#else
+#define BACKEND "float"
+#endif
+
+// Datasheet example calibration (same as the simulated sensor)
+static const struct bme280_calib_data CALIB = {
+    .dig_t1 = 27504, .dig_t2 = 26435, .dig_t3 = -1000,
+    .dig_p1 = 36477, .dig_p2 = -10685, .dig_p3 = 3024, .dig_p4 = 2855, .dig_p5 = 140,
+    .dig_p6 = -7, .dig_p7 = 15500, .dig_p8 = -14600, .dig_p9 = 6000,
+    .dig_h1 = 75, .dig_h2 = 362, .dig_h3 = 0, .dig_h4 = 324, .dig_h5 = 0, .dig_h6 = 30
+};
+
+// Burst read of 0xF7..0xFE: pressure 415148, temperature 519888, humidity 30000
+static const uint8_t FRAME[BME280_P_T_H_DATA_LEN] = { 0x65, 0x5A, 0xC0, 0x7E, 0xED, 0x00, 0x75, 0x30 };
+
+static void parse(void *ctx, uint64_t iters){
+    uint8_t frame[BME280_P_T_H_DATA_LEN];
+    struct bme280_uncomp_data raw;
+    uint64_t acc = 0;
+    memcpy(frame, FRAME, sizeof(frame));
+    for(uint64_t i = 0; i < iters; i++){
+        frame[5] = (uint8_t) i; // keep the input live
+        bme280_parse_sensor_data(frame, &raw);
+        acc += raw.temperature;
+    }
+    bench_sink += acc;
+}
+
+static void compensate(void *ctx, uint64_t iters){
+    uint8_t comp = *(const uint8_t *) ctx;
+    struct bme280_calib_data calib = CALIB;
+    struct bme280_uncomp_data raw;
+    struct bme280_data data;
+    double acc = 0;
+    bme280_parse_sensor_data(FRAME, &raw);
+    for(uint64_t i = 0; i < iters; i++){
+        raw.temperature = 519888 + (i & 0x3FF);
+        bme280_compensate_data(comp, &raw, &data, &calib);
+        acc += data.temperature + data.pressure + data.humidity;
+    }
+    bench_sink += (uint64_t) acc;
+}
+
+// Pure variant: reads the shared calibration in place, no private copy
+static void compensateR(void *ctx, uint64_t iters){
+    uint8_t comp = *(const uint8_t *) ctx;
+    struct bme280_uncomp_data raw;
+    struct bme280_data data;
+    double acc = 0;
+    bme280_parse_sensor_data(FRAME, &raw);
+    for(uint64_t i = 0; i < iters; i++){
+        raw.temperature = 519888 + (i & 0x3FF);
+        bme280_compensate_data_r(comp, &raw, &data, &CALIB);
+        acc += data.temperature + data.pressure + data.humidity;
+    }
+    bench_sink += (uint64_t) acc;
+}
+
+static void measDelay(void *ctx, uint64_t iters){
+    static const uint8_t OSR[] = { BME280_OVERSAMPLING_1X, BME280_OVERSAMPLING_2X, BME280_OVERSAMPLING_4X,
+        BME280_OVERSAMPLING_8X, BME280_OVERSAMPLING_16X };
+    struct bme280_settings settings = { 0 };
+    uint64_t acc = 0;
+    for(uint64_t i = 0; i < iters; i++){
+        settings.osr_t = OSR[i % 5];
+        settings.osr_p = OSR[(i + 1) % 5];
+        settings.osr_h = OSR[(i + 2) % 5];
+        acc += bme280_cal_meas_delay(&settings);
+    }
+    bench_sink += acc;
+}
+
+int main(void){
+    uint8_t temp = BME280_TEMP, all = BME280_ALL;
+
+    bench_begin("bme280", BACKEND);
+    bench_run("parse_sensor_data", parse, NULL);
+    bench_run("compensate_data_temp", compensate, &temp);
+    bench_run("compensate_data_all", compensate, &all);
+    bench_run("compensate_data_r_temp", compensateR, &temp);
+    bench_run("compensate_data_r_all", compensateR, &all);
+    bench_run("cal_meas_delay", measDelay, NULL);
+    bench_end();
+    return 0;
+}
@@ -0,0 +1,280 @@
+/*
+* Compares the compressed history blocks against the CSV text log.
+*
+* Usage: bench_gorilla [-w prefix] [data.csv]
+* Without a file a synthetic week at 2 samples/s is generated (hysteresis
+* cycling of TI around TR, daily cycle on TE, setpoint step every 6h).
+* With -w the series is also written as prefix.csv and prefix.gor, in the
+* logger's formats (the 0.01 oC week without a file), which `make check`
+* queries through both tlquery readers.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <csvlog.h>
+#include <gorilla.h>
+
+#define CHANNELS 3
+#define WEEK_SAMPLES (7 * 24 * 3600 * 2)
+
+struct series {
+    size_t n;
+    int64_t *ts;
+    float *values; // TR, TI, TE interleaved
+};
+
+static uint64_t rng_state = 0x9E3779B97F4A7C15ULL;
+
+static double rnd(void){
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 7;
+    rng_state ^= rng_state << 17;
+    return (rng_state >> 11) * (1.0 / 9007199254740992.0);
+}
+
+static double now(void){
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static void alloc(struct series *s, size_t n){
+    s->n = 0;
+    s->ts = malloc(n * sizeof(int64_t));
+    s->values = malloc(n * CHANNELS * sizeof(float));
+    if(!s->ts || !s->values){
+        fprintf(stderr, "Sem memória\n");
+        exit(1);
+    }
+}
+
+static void synthetic(struct series *s, int quantize){
+    alloc(s, WEEK_SAMPLES);
+    int64_t t = 1596240000000LL;
+    double ti = 25.0;
+    int heating = 1;
+    for(size_t i = 0; i < WEEK_SAMPLES; i++){
+        double hours = i / 7200.0;
+        double tr = 30.0 + 5.0 * ((int) (hours / 6) % 3);
+        double te = 24.0 + 3.0 * sin(2 * M_PI * hours / 24.0) + (rnd() - 0.5) * 0.04;
+
+        if(ti < tr - 0.5){
+            heating = 1;
+        }else if(ti > tr + 0.5){
+            heating = 0;
+        }
+        ti += heating ? 0.01 : -0.008;
+        double ti_read = ti + (rnd() - 0.5) * 0.05;
+
+        float *v = &s->values[i * CHANNELS];
+        v[0] = (float) tr;
+        v[1] = (float) ti_read;
+        v[2] = (float) te;
+        if(quantize){
+            for(int c = 0; c < CHANNELS; c++){
+                v[c] = roundf(v[c] * 100.0f) / 100.0f;
+            }
+        }
+        // 500ms tick plus acquisition jitter
+        s->ts[i] = t;
+        t += 500 + (int64_t) (rnd() * 4);
+        s->n++;
+    }
+}
+
+// Rows parsed as tlquery does (csvlog.c), malformed ones skipped
+static int loadCsv(struct series *s, const char *path){
+    struct csvlog log;
+    if(csvlog_open(&log, path)){
+        return -1;
+    }
+    size_t cap = 1 << 16;
+    alloc(s, cap);
+
+    const char *p = log.data, *end = log.data + log.size;
+    while(p < end){
+        struct csvlog_row row;
+        bool ok;
+        p = csvlog_next(p, end, &row, &ok);
+        if(!ok){
+            continue;
+        }
+        if(s->n == cap){
+            int64_t *ts = realloc(s->ts, cap * 2 * sizeof(int64_t));
+            if(ts){
+                s->ts = ts;
+            }
+            float *values = realloc(s->values, cap * 2 * CHANNELS * sizeof(float));
+            if(values){
+                s->values = values;
+            }
+            if(!ts || !values){
+                fprintf(stderr, "Sem memória\n");
+                exit(1);
+            }
+            cap *= 2;
+        }
+        s->ts[s->n] = row.ts_ms;
+        s->values[s->n * CHANNELS + 0] = row.reference_temp;
+        s->values[s->n * CHANNELS + 1] = row.intern_temp;
+        s->values[s->n * CHANNELS + 2] = row.extern_temp;
+        s->n++;
+    }
+    csvlog_close(&log);
+    return 0;
+}
+
+static int formatRow(char *row, size_t len, int64_t ts_ms, const float *v){
+    struct tm tm;
+    time_t sec = (time_t) (ts_ms / 1000);
+    char date[32];
+    localtime_r(&sec, &tm);
+    asctime_r(&tm, date);
+    return snprintf(row, len, "%0.2lf, %0.2lf, %0.2lf, %s", v[0], v[1], v[2], date);
+}
+
+static int writeFiles(const char *prefix, const struct series *s, const uint8_t *blocks, size_t len){
+    char path[4096];
+    snprintf(path, sizeof(path), "%s.csv", prefix);
+    FILE *csv = fopen(path, "w");
+    if(!csv){
+        return -1;
+    }
+    fprintf(csv, "Temperatura referência (oC), Temperatura interna (oC), Temperatura externa (oC), Data e Hora\n");
+    char row[128];
+    for(size_t i = 0; i < s->n; i++){
+        formatRow(row, sizeof(row), s->ts[i], &s->values[i * CHANNELS]);
+        fputs(row, csv);
+    }
+    int res = fclose(csv);
+
+    snprintf(path, sizeof(path), "%s.gor", prefix);
+    FILE *gor = fopen(path, "w");
+    if(!gor){
+        return -1;
+    }
+    size_t written = fwrite(blocks, 1, len, gor);
+    if(fclose(gor) || res || written != len){
+        return -1;
+    }
+    return 0;
+}
+
+static void run(const char *name, const struct series *s, const char *write_prefix){
+    // CSV: same row format as the logger
+    char row[128];
+    size_t csv_bytes = 0;
+    double t0 = now();
+    for(size_t i = 0; i < s->n; i++){
+        csv_bytes += formatRow(row, sizeof(row), s->ts[i], &s->values[i * CHANNELS]);
+    }
+    double csv_time = now() - t0;
+
+    // Encode
+    size_t cap = s->n * 24 + GORILLA_BLOCK_BYTES;
+    uint8_t *out = malloc(cap);
+    if(!out){
+        fprintf(stderr, "Sem memória\n");
+        exit(1);
+    }
+    size_t out_len = 0, blocks = 0;
+    static struct gorilla_encoder enc;
+    const uint8_t *block;
+    size_t len;
+
+    t0 = now();
+    gorilla_encoder_init(&enc, CHANNELS);
+    for(size_t i = 0; i < s->n; i++){
+        if(!gorilla_encode(&enc, s->ts[i], &s->values[i * CHANNELS])){
+            len = gorilla_finish(&enc, &block);
+            memcpy(out + out_len, block, len);
+            out_len += len;
+            blocks++;
+            gorilla_encoder_init(&enc, CHANNELS);
+            gorilla_encode(&enc, s->ts[i], &s->values[i * CHANNELS]);
+        }
+    }
+    len = gorilla_finish(&enc, &block);
+    memcpy(out + out_len, block, len);
+    out_len += len;
+    blocks++;
+    double enc_time = now() - t0;
+
+    // Decode and verify
+    static int64_t ts[GORILLA_BLOCK_SAMPLES];
+    static float values[GORILLA_BLOCK_SAMPLES * CHANNELS];
+    size_t pos = 0, decoded = 0, mismatches = 0;
+    t0 = now();
+    while(pos < out_len){
+        struct gorilla_block_info info;
+        if(gorilla_block_info(out + pos, out_len - pos, &info)){
+            break;
+        }
+        int n = gorilla_decode(out + pos, out_len - pos, ts, values, GORILLA_BLOCK_SAMPLES);
+        if(n < 0){
+            break;
+        }
+        for(int i = 0; i < n; i++){
+            if(ts[i] != s->ts[decoded + i]
+                || memcmp(&values[i * CHANNELS], &s->values[(decoded + i) * CHANNELS], CHANNELS * sizeof(float))){
+                mismatches++;
+            }
+        }
+        decoded += n;
+        pos += info.size;
+    }
+    double dec_time = now() - t0;
+
+    printf("%s: %zu amostras, %zu blocos\n", name, s->n, blocks);
+    printf("  CSV      %10zu bytes  %6.2f bytes/amostra  formatação %8.2f Mamostras/s\n",
+        csv_bytes, (double) csv_bytes / s->n, s->n / csv_time / 1e6);
+    printf("  Gorilla  %10zu bytes  %6.2f bytes/amostra  codificação %7.2f Mamostras/s  decodificação %7.2f Mamostras/s\n",
+        out_len, (double) out_len / s->n, s->n / enc_time / 1e6, decoded / dec_time / 1e6);
+    printf("  Razão %.1fx, verificação: %zu amostras decodificadas, %zu divergentes\n",
+        (double) csv_bytes / out_len, decoded, mismatches);
+    if(write_prefix){
+        if(writeFiles(write_prefix, s, out, out_len)){
+            fprintf(stderr, "Não foi possivel gravar %s.csv e %s.gor\n", write_prefix, write_prefix);
+            exit(1);
+        }
+        printf("  Gravados %s.csv e %s.gor\n", write_prefix, write_prefix);
+    }
+    free(out);
+}
+
+int main(int argc, char *argv[]){
+    const char *write_prefix = NULL;
+    int opt;
+    while((opt = getopt(argc, argv, "w:")) != -1){
+        if(opt == 'w'){
+            write_prefix = optarg;
+        }else{
+            fprintf(stderr, "Uso: %s [-w prefixo] [data.csv]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    struct series s;
+    if(optind < argc){
+        if(loadCsv(&s, argv[optind])){
+            fprintf(stderr, "Não foi possivel abrir %s\n", argv[optind]);
+            return 1;
+        }
+        run(argv[optind], &s, write_prefix);
+    }else{
+        synthetic(&s, 0);
+        run("Semana sintética (float bruto)", &s, NULL);
+        free(s.ts);
+        free(s.values);
+        synthetic(&s, 1);
+        run("Semana sintética (0.01 oC)", &s, write_prefix);
+    }
+    free(s.ts);
+    free(s.values);
+    return 0;
+}
@@ -0,0 +1,542 @@
+/*
+* Timing of the controller's periodic tasks under synthetic system load.
+*
+* Usage: bench_jitter [-t segundos] [-p periodo_ms] [-w pwm_ms] [-s default,fifo,pinned,fifo+pinned]
+*                     [-l none,cpu,mem,io,...] [-j hogs] [-C cpu] [-d dir] [-o saida.json]
+*
+* The tasks of the headless controller run on the simulated HAL: an
+* interval timer posts the acquisition and LCD semaphores from SIGALRM as
+* ualarm does in main.c, the acquisition thread reads TE (BME280 forced
+* mode), TI and publishes the sample, the control thread runs the PID on
+* every sample and the PWM thread drives the outputs, with full-rate
+* logging. The forced-mode read waits for the conversion
+* (bme280_cal_meas_delay, 46 ms with the loop.c settings on the sensor),
+* so periods below that overrun by construction. For every scheduler
+* configuration and background load (CPU, memory bandwidth and fsync
+* hogs) it records:
+*
+*   tick lateness   acquisition thread wake-up minus the nominal tick
+*   overruns        ticks whose work ended after the next tick was due
+*   control period  spread of the interval between two control steps
+*   PWM lateness    worst edge of the PWM thread (pwm_get_stats)
+*/
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <pthread.h>
+#include <semaphore.h>
+#include <signal.h>
+#include <sys/time.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <bme280.h>
+#include <control.h>
+#include <hal.h>
+#include <hal_sim.h>
+#include <logger.h>
+#include <plant.h>
+#include <sample.h>
+#include <state.h>
+
+#include "load.h"
+#include "rt.h"
+
+#define MAX_TICKS 200000
+#define MAX_LOADS 8
+#define HISTERESIS 4.0f
+
+// As in bench_latency: below the PWM thread, control above acquisition
+#define SENSORS_RT_PRIORITY 40
+#define CONTROL_RT_PRIORITY 45
+#define LCD_RT_PRIORITY 30
+
+struct run_result {
+    int sched;
+    const char *load;
+    bool skipped;
+    int ticks;
+    int overruns;
+    double late_p50_us, late_p99_us, late_max_us;
+    int steps; // control steps
+    double period_sd_us, period_max_dev_us;
+    int64_t pwm_max_us;
+    uint64_t pwm_periods;
+};
+
+static int period_ms = 500;
+static int rt_cpu = -1;
+static int sched_config;
+static float reference;
+
+static struct bme280_dev dev;
+
+static bool stopping;
+static pthread_barrier_t started;
+static int thread_errors;
+
+static sem_t hold_sensors;
+static sem_t hold_lcd;
+
+// Filled by the acquisition and control threads, one run at a time
+static int64_t first_tick_ns;
+static int64_t wake_ns[MAX_TICKS];
+static int64_t done_ns[MAX_TICKS];
+static int ticks;
+static int64_t step_ns[MAX_TICKS];
+static int steps;
+static uint64_t first_seq; // samples of earlier runs are not counted
+
+static int64_t nowNs(void){
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t) ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+static void handleAlarm(int signal){
+    sem_post(&hold_sensors);
+    sem_post(&hold_lcd);
+}
+
+static void startedBarrier(int priority){
+    if(rt_apply(sched_config, priority, rt_cpu)){
+        __atomic_add_fetch(&thread_errors, 1, __ATOMIC_RELAXED);
+    }
+    pthread_barrier_wait(&started);
+}
+
+// watchSensors
+static void *sensors(void *args){
+    startedBarrier(SENSORS_RT_PRIORITY);
+    while(true){
+        sem_wait(&hold_sensors);
+        if(__atomic_load_n(&stopping, __ATOMIC_ACQUIRE)){
+            break;
+        }
+        int64_t wake = nowNs();
+
+        float te = 0, ti = 0;
+        struct bme280_data data;
+        if(bme280_start_forced_r(&dev.settings, &dev) == BME280_OK){
+            dev.delay_us(1000 * bme280_cal_meas_delay(&dev.settings), dev.intf_ptr);
+            if(bme280_get_sensor_data_r(BME280_TEMP, &data, &dev) == BME280_OK){
+                te = data.temperature;
+            }
+        }
+        int res = hal->uart->read_ti(&ti);
+        int64_t sensed_ns = sample_monotonic_ns();
+        if(!res){
+            struct sample s;
+            s.ts_ms = 0;
+            s.sensed_ns = sensed_ns;
+            s.reference_temp = reference;
+            s.intern_temp = ti;
+            s.extern_temp = te;
+            sample_publish(&s);
+            logger_push_sample(reference, ti, te);
+        }
+
+        if(ticks < MAX_TICKS){
+            wake_ns[ticks] = wake;
+            done_ns[ticks] = nowNs();
+            ticks++;
+        }
+    }
+    return NULL;
+}
+
+// handleLCD
+static void *lcd(void *args){
+    startedBarrier(LCD_RT_PRIORITY);
+    while(true){
+        sem_wait(&hold_lcd);
+        if(__atomic_load_n(&stopping, __ATOMIC_ACQUIRE)){
+            break;
+        }
+        struct sample s;
+        char line[HAL_LCD_COLS + 1];
+        sample_latest(&s);
+        snprintf(line, sizeof(line), "TR %.2f ", s.reference_temp);
+        hal->lcd->write_line(0, line);
+        snprintf(line, sizeof(line), "TI%.2f TE%.2f ", s.intern_temp, s.extern_temp);
+        hal->lcd->write_line(1, line);
+    }
+    return NULL;
+}
+
+// handleGPIO; the first step starts the PWM thread, which inherits this
+// thread's policy and affinity
+static void *control(void *args){
+    struct sample_cursor cursor = {0};
+    struct sample s = {0};
+    startedBarrier(CONTROL_RT_PRIORITY);
+    while(!__atomic_load_n(&stopping, __ATOMIC_ACQUIRE)){
+        int wake = sample_wait(&cursor, &s, CONTROL_IDLE_MS);
+        if(!(wake & SAMPLE_WAKE_NEW) || s.seq < first_seq){
+            continue;
+        }
+        struct control_input in;
+        in.running = true;
+        in.reference_temp = s.reference_temp;
+        in.intern_temp = s.intern_temp;
+        in.histeresis_temp = HISTERESIS;
+        in.extern_temp = s.extern_temp;
+        in.reference_raw = in.reference_temp;
+        in.intern_raw = in.intern_temp;
+        in.sensed_ns = s.sensed_ns;
+        control_step(&in);
+        if(steps < MAX_TICKS){
+            step_ns[steps++] = nowNs();
+        }
+    }
+    return NULL;
+}
+
+static int cmpDouble(const void *a, const void *b){
+    double x = *(const double *) a, y = *(const double *) b;
+    return (x > y) - (x < y);
+}
+
+static double percentile(const double *sorted, int n, double p){
+    int i = (int) (p * (n - 1) + 0.5);
+    return sorted[i];
+}
+
+static void setTimer(int ms){
+    struct itimerval it;
+    it.it_interval.tv_sec = ms / 1000;
+    it.it_interval.tv_usec = (ms % 1000) * 1000;
+    it.it_value = it.it_interval;
+    setitimer(ITIMER_REAL, &it, NULL);
+}
+
+static void summarize(struct run_result *res){
+    static double v[MAX_TICKS];
+    int64_t period_ns = period_ms * 1000000LL;
+
+    // Wake-up k answers the k-th expiry of the timer
+    res->ticks = ticks;
+    for(int k = 0; k < ticks; k++){
+        int64_t due = first_tick_ns + k * period_ns;
+        v[k] = (wake_ns[k] - due) / 1000.0;
+        if(done_ns[k] > due + period_ns){
+            res->overruns++;
+        }
+    }
+    if(ticks){
+        qsort(v, ticks, sizeof(double), cmpDouble);
+        res->late_p50_us = percentile(v, ticks, 0.50);
+        res->late_p99_us = percentile(v, ticks, 0.99);
+        res->late_max_us = v[ticks - 1];
+    }
+
+    res->steps = steps;
+    if(steps > 2){
+        double sum = 0, sq = 0, max_dev = 0;
+        for(int k = 1; k < steps; k++){
+            double d = (step_ns[k] - step_ns[k - 1]) / 1000.0;
+            sum += d;
+            sq += d * d;
+            double dev = fabs(d - period_ms * 1000.0);
+            if(dev > max_dev){
+                max_dev = dev;
+            }
+        }
+        int n = steps - 1;
+        double mean = sum / n;
+        res->period_sd_us = sqrt(fmax(sq / n - mean * mean, 0));
+        res->period_max_dev_us = max_dev;
+    }
+}
+
+static void run(int sched, const char *load_name, const struct load_config *load, int seconds, struct run_result *res){
+    pthread_t sensors_thread, lcd_thread, control_thread;
+    sigset_t wait_set;
+
+    memset(res, 0, sizeof(*res));
+    res->sched = sched;
+    res->load = load_name;
+
+    if(load_start(load)){
+        fprintf(stderr, "Falha ao iniciar a carga %s\n", load_name);
+        exit(1);
+    }
+
+    sched_config = sched;
+    stopping = false;
+    thread_errors = 0;
+    ticks = steps = 0;
+    struct sample last = {0};
+    sample_latest(&last);
+    first_seq = last.seq + 1;
+    sem_init(&hold_sensors, 0, 0);
+    sem_init(&hold_lcd, 0, 0);
+    control_request_mode(CONTROL_PID);
+
+    pthread_barrier_init(&started, NULL, 4);
+    pthread_create(&sensors_thread, NULL, sensors, NULL);
+    pthread_create(&lcd_thread, NULL, lcd, NULL);
+    pthread_create(&control_thread, NULL, control, NULL);
+    pthread_barrier_wait(&started);
+
+    if(thread_errors){
+        res->skipped = true;
+    }else{
+        int64_t start = nowNs();
+        first_tick_ns = start + period_ms * 1000000LL;
+        setTimer(period_ms);
+        // SIGALRM stays blocked everywhere else, so it lands here
+        pthread_sigmask(SIG_BLOCK, NULL, &wait_set);
+        sigdelset(&wait_set, SIGALRM);
+        while(nowNs() - start < seconds * 1000000000LL){
+            sigsuspend(&wait_set);
+        }
+        setTimer(0);
+    }
+
+    __atomic_store_n(&stopping, true, __ATOMIC_RELEASE);
+    sem_post(&hold_sensors);
+    sem_post(&hold_lcd);
+    sample_setpoint_changed();
+    pthread_join(sensors_thread, NULL);
+    pthread_join(lcd_thread, NULL);
+    pthread_join(control_thread, NULL);
+    pthread_barrier_destroy(&started);
+
+    struct control_status status;
+    control_get_status(&status);
+    res->pwm_max_us = status.pwm.max_jitter_us;
+    res->pwm_periods = status.pwm.periods;
+
+    // Back to hysteresis: stops the PWM thread before the next configuration
+    struct control_input in = { false, reference, reference, HISTERESIS, 0 };
+    control_request_mode(CONTROL_HYSTERESIS);
+    control_step(&in);
+    load_stop();
+    sem_destroy(&hold_sensors);
+    sem_destroy(&hold_lcd);
+
+    if(!res->skipped){
+        summarize(res);
+    }
+}
+
+static void printTable(const struct run_result *results, int count){
+    printf("%-12s %-12s %6s %9s %9s %9s %8s %10s %10s %9s\n",
+        "Escalonador", "Carga", "Ticks", "Atraso50", "Atraso99", "AtrasoMáx", "Overruns",
+        "Período σ", "Período Δ", "PWM máx");
+    for(int i = 0; i < count; i++){
+        const struct run_result *r = &results[i];
+        if(r->skipped){
+            printf("%-12s %-12s %s\n", rt_name(r->sched), r->load, "sem permissão (CAP_SYS_NICE?)");
+            continue;
+        }
+        printf("%-12s %-12s %6d %9.1f %9.1f %9.1f %8d %10.1f %10.1f %9lld\n",
+            rt_name(r->sched), r->load, r->ticks, r->late_p50_us, r->late_p99_us, r->late_max_us,
+            r->overruns, r->period_sd_us, r->period_max_dev_us, (long long) r->pwm_max_us);
+    }
+    printf("(tempos em us)\n");
+}
+
+static int writeJson(const char *path, const struct run_result *results, int count, int hogs, int pwm_ms){
+    FILE *out = fopen(path, "w");
+    if(!out){
+        return -1;
+    }
+    const char *revision = getenv("BENCH_REVISION");
+    fprintf(out, "{\"suite\": \"jitter\", \"revision\": ");
+    if(revision && *revision){
+        fprintf(out, "\"%s\"", revision);
+    }else{
+        fprintf(out, "null");
+    }
+    fprintf(out, ", \"period_ms\": %d, \"pwm_period_ms\": %d, \"hogs\": %d, \"runs\": [", period_ms, pwm_ms, hogs);
+    for(int i = 0; i < count; i++){
+        const struct run_result *r = &results[i];
+        fprintf(out, "%s\n  {\"sched\": \"%s\", \"load\": \"%s\", ", i ? "," : "", rt_name(r->sched), r->load);
+        if(r->skipped){
+            fprintf(out, "\"skipped\": true}");
+            continue;
+        }
+        fprintf(out, "\"skipped\": false, \"ticks\": %d, \"overruns\": %d, \"late_p50_us\": %.1f, "
+            "\"late_p99_us\": %.1f, \"late_max_us\": %.1f, \"control_steps\": %d, \"period_sd_us\": %.1f, "
+            "\"period_max_dev_us\": %.1f, \"pwm_periods\": %llu, \"pwm_max_late_us\": %lld}",
+            r->ticks, r->overruns, r->late_p50_us, r->late_p99_us, r->late_max_us, r->steps,
+            r->period_sd_us, r->period_max_dev_us, (unsigned long long) r->pwm_periods, (long long) r->pwm_max_us);
+    }
+    fprintf(out, "\n]}\n");
+    fclose(out);
+    return 0;
+}
+
+static void printUsage(const char *name){
+    printf("Uso: %s [-t segundos] [-p periodo_ms] [-w pwm_ms] [-s escalonadores] [-l cargas] [-j hogs] [-C cpu] [-d dir] [-o saida.json]\n", name);
+    printf("  -t  Duração de cada execução (padrão 10 s)\n");
+    printf("  -p  Período do alarme de aquisição em ms (padrão 500, como o controlador)\n");
+    printf("  -w  Período do PWM em ms (padrão 100)\n");
+    printf("  -s  Lista de: default, fifo, pinned, fifo+pinned (padrão todos)\n");
+    printf("  -l  Lista de cargas: none ou cpu, mem, io combinados com '+' (padrão none,cpu,mem,io,cpu+mem+io)\n");
+    printf("  -j  Processos de carga de cada tipo (padrão: número de CPUs)\n");
+    printf("  -C  CPU das configurações fixadas (padrão: a última)\n");
+    printf("  -d  Diretório dos arquivos da carga de E/S (padrão /tmp)\n");
+    printf("  -o  Grava os resultados em JSON\n");
+}
+
+int main(int argc, char *argv[]){
+    int seconds = 10;
+    int pwm_ms = 100;
+    int hogs = (int) sysconf(_SC_NPROCESSORS_ONLN);
+    const char *sched_list = "default,fifo,pinned,fifo+pinned";
+    const char *load_list = "none,cpu,mem,io,cpu+mem+io";
+    const char *json_path = NULL;
+    struct load_config load = {0};
+    int opt;
+
+    while((opt = getopt(argc, argv, "t:p:w:s:l:j:C:d:o:h")) != -1){
+        switch(opt){
+            case 't':
+                seconds = atoi(optarg);
+                break;
+            case 'p':
+                period_ms = atoi(optarg);
+                break;
+            case 'w':
+                pwm_ms = atoi(optarg);
+                break;
+            case 's':
+                sched_list = optarg;
+                break;
+            case 'l':
+                load_list = optarg;
+                break;
+            case 'j':
+                hogs = atoi(optarg);
+                break;
+            case 'C':
+                rt_cpu = atoi(optarg);
+                break;
+            case 'd':
+                load.dir = optarg;
+                break;
+            case 'o':
+                json_path = optarg;
+                break;
+            case 'h':
+                printUsage(argv[0]);
+                return 0;
+            default:
+                printUsage(argv[0]);
+                return 1;
+        }
+    }
+    if(seconds <= 0 || period_ms <= 0 || pwm_ms <= 0 || hogs < 0 || hogs > LOAD_MAX_HOGS / 3
+        || (int64_t) seconds * 1000 / period_ms >= MAX_TICKS){
+        printUsage(argv[0]);
+        return 1;
+    }
+    if(rt_cpu < 0){
+        rt_cpu = (int) sysconf(_SC_NPROCESSORS_ONLN) - 1;
+    }
+
+    int scheds[RT_CONFIGS], sched_count = 0;
+    const char *loads[MAX_LOADS];
+    int load_count = 0;
+    char scheds_buf[128], loads_buf[256];
+    char *save, *tok;
+    snprintf(scheds_buf, sizeof(scheds_buf), "%s", sched_list);
+    for(tok = strtok_r(scheds_buf, ",", &save); tok && sched_count < RT_CONFIGS; tok = strtok_r(NULL, ",", &save)){
+        if((scheds[sched_count++] = rt_parse(tok)) < 0){
+            fprintf(stderr, "Escalonador desconhecido: %s\n", tok);
+            return 1;
+        }
+    }
+    snprintf(loads_buf, sizeof(loads_buf), "%s", load_list);
+    for(tok = strtok_r(loads_buf, ",", &save); tok && load_count < MAX_LOADS; tok = strtok_r(NULL, ",", &save)){
+        struct load_config check;
+        if(load_parse(tok, hogs, &check)){
+            fprintf(stderr, "Carga desconhecida: %s\n", tok);
+            return 1;
+        }
+        loads[load_count++] = tok;
+    }
+
+    // Simulated chamber; the reference sits just above it so the PID
+    // output stays inside (0, 1) and the PWM has edges to schedule
+    struct plant_model model;
+    plant_model_defaults(&model);
+    hal_select("sim");
+    hal_sim_configure(&model, 0, 1);
+    reference = model.initial + 2;
+    hal->lcd->init();
+
+    static struct hal_i2c_dev i2c_dev;
+    hal->i2c->open(&i2c_dev, "sim", BME280_I2C_ADDR_PRIM);
+    dev.intf = BME280_I2C_INTF;
+    dev.read = hal->i2c->read;
+    dev.write = hal->i2c->write;
+    dev.delay_us = hal->i2c->delay_us;
+    dev.intf_ptr = &i2c_dev;
+    // Same settings as loop.c, written once
+    dev.settings.osr_h = BME280_OVERSAMPLING_1X;
+    dev.settings.osr_p = BME280_OVERSAMPLING_16X;
+    dev.settings.osr_t = BME280_OVERSAMPLING_2X;
+    dev.settings.filter = BME280_FILTER_COEFF_16;
+    if(bme280_init(&dev) != BME280_OK
+        || bme280_set_sensor_settings(BME280_OSR_PRESS_SEL | BME280_OSR_TEMP_SEL | BME280_OSR_HUM_SEL | BME280_FILTER_SEL, &dev) != BME280_OK){
+        fprintf(stderr, "Falha na inicialização do BME280 simulado\n");
+        return 1;
+    }
+
+    struct control_config cfg;
+    control_defaults(&cfg);
+    cfg.pid_period_ms = period_ms;
+    cfg.pwm_period_ms = pwm_ms;
+    // Every period writes its edges
+    cfg.pwm_min_on_ms = cfg.pwm_min_off_ms = 0;
+    hal->gpio->init();
+    control_init(&cfg);
+    sample_init(false);
+    rt_lock_memory();
+
+    // Only the main thread takes SIGALRM, as in the controller; every
+    // thread started from here on inherits the blocked mask
+    sigset_t alarm_set;
+    sigemptyset(&alarm_set);
+    sigaddset(&alarm_set, SIGALRM);
+    pthread_sigmask(SIG_BLOCK, &alarm_set, NULL);
+    signal(SIGALRM, handleAlarm);
+
+    char data_path[256], events_path[256];
+    const char *dir = load.dir ? load.dir : "/tmp";
+    snprintf(data_path, sizeof(data_path), "%s/jitter_data_%d.csv", dir, (int) getpid());
+    snprintf(events_path, sizeof(events_path), "%s/jitter_events_%d.csv", dir, (int) getpid());
+    if(logger_start(data_path, events_path, NULL, NULL)){
+        fprintf(stderr, "Não foi possivel abrir %s\n", data_path);
+        return 1;
+    }
+
+    static struct run_result results[RT_CONFIGS * MAX_LOADS];
+    int count = 0;
+    for(int l = 0; l < load_count; l++){
+        load_parse(loads[l], hogs, &load);
+        for(int s = 0; s < sched_count; s++){
+            fprintf(stderr, "%s / %s...\n", rt_name(scheds[s]), loads[l]);
+            run(scheds[s], loads[l], &load, seconds, &results[count++]);
+        }
+    }
+
+    control_shutdown();
+    logger_stop();
+    unlink(data_path);
+    unlink(events_path);
+
+    printTable(results, count);
+    if(json_path && writeJson(json_path, results, count, hogs, pwm_ms)){
+        fprintf(stderr, "Não foi possivel gravar %s\n", json_path);
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,434 @@
+/*
+* Sense-to-actuate latency: time from a new reading leaving the UART to the
+* GPIO write that reacts to it.
+*
+* Usage: bench_latency [-n degraus] [-p periodo_ms] [-s default,fifo,pinned,fifo+pinned]
+*                      [-l none,cpu,io,cpu+io] [-j hogs] [-C cpu] [-d dir] [-o saida.json]
+*
+* Runs the program's own watchSensors and handleGPIO (loop.c) on the
+* simulated HAL, with a timer posting hold_sensors every period in place of
+* the 500 ms alarm. The simulated chamber is frozen at CHAMBER_TEMP and each
+* step moves the potentiometer to the other side of it, so the hysteresis
+* must flip heater and fan in one masked write. The latency is taken, as in
+* control.c, from the sample's sensed_ns (TI read back from the UART) to
+* that write, timestamped by the hal_sim write hook. The run is repeated for
+* every scheduler configuration and background load.
+*/
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <pthread.h>
+#include <semaphore.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <config.h>
+#include <control.h>
+#include <hal.h>
+#include <hal_sim.h>
+#include <logger.h>
+#include <loop.h>
+#include <sample.h>
+#include <state.h>
+
+#include "load.h"
+#include "rt.h"
+
+#define MAX_STEPS 100000
+#define MAX_LOADS 4
+#define CHAMBER_TEMP 40.0f
+#define HISTERESIS 4.0f
+#define TR_LOW 30.0f  // fan on
+#define TR_HIGH 50.0f // heater on
+
+// Below the PWM thread (PWM_RT_PRIORITY), control above acquisition
+#define SENSORS_RT_PRIORITY 40
+#define CONTROL_RT_PRIORITY 45
+
+struct run_result {
+    int sched;
+    const char *load;
+    bool skipped;
+    int steps;
+    int missed;
+    double min_us, p50_us, p90_us, p99_us, max_us, mean_us;
+};
+
+static int period_ms = 10;
+static int rt_cpu = -1;
+static int sched_config;
+
+static pthread_barrier_t started;
+static int thread_errors;
+
+// Step in flight: the TR it set and the latency of the write reacting to it
+static float target_tr = TR_LOW;
+static bool step_pending = false;
+static int64_t reaction_ns;
+static sem_t reacted;
+
+// Probe ---------------------------------------------------------------------
+
+// Control thread, right after the GPIO write of hal_sim
+static void onWrite(uint32_t value, uint32_t mask){
+    int64_t t = sample_monotonic_ns();
+    if(!__atomic_load_n(&step_pending, __ATOMIC_ACQUIRE)){
+        return;
+    }
+    struct sample s;
+    if(sample_latest(&s) && s.reference_raw == target_tr){
+        reaction_ns = t - s.sensed_ns;
+        __atomic_store_n(&step_pending, false, __ATOMIC_RELEASE);
+        sem_post(&reacted);
+    }
+}
+
+// Control path --------------------------------------------------------------
+
+static void startedBarrier(int priority){
+    if(rt_apply(sched_config, priority, rt_cpu)){
+        __atomic_add_fetch(&thread_errors, 1, __ATOMIC_RELAXED);
+    }
+    pthread_barrier_wait(&started);
+}
+
+// The alarm of main.c, every period_ms
+static void *ticker(void *args){
+    struct timespec next;
+    startedBarrier(SENSORS_RT_PRIORITY);
+    clock_gettime(CLOCK_MONOTONIC, &next);
+    while(!stopping){
+        next.tv_nsec += period_ms * 1000000L;
+        while(next.tv_nsec >= 1000000000L){
+            next.tv_sec++;
+            next.tv_nsec -= 1000000000L;
+        }
+        clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &next, NULL);
+        sem_post(&hold_sensors);
+    }
+    return NULL;
+}
+
+static void *sensors(void *args){
+    startedBarrier(SENSORS_RT_PRIORITY);
+    return watchSensors(args);
+}
+
+static void *control(void *args){
+    startedBarrier(CONTROL_RT_PRIORITY);
+    return handleGPIO(args);
+}
+
+static void sensorFailed(int8_t rslt){
+    fprintf(stderr, "Falha na leitura do sensor BME280 simulado (%+d)\n", rslt);
+    exit(1);
+}
+
+// Driver ----------------------------------------------------------------------
+
+static uint64_t rng_state = 0x9E3779B97F4A7C15ULL;
+
+static uint64_t rnd(void){
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 7;
+    rng_state ^= rng_state << 17;
+    return rng_state;
+}
+
+static void sleepNs(int64_t ns){
+    struct timespec ts = { ns / 1000000000LL, ns % 1000000000LL };
+    nanosleep(&ts, NULL);
+}
+
+static int cmpDouble(const void *a, const void *b){
+    double x = *(const double *) a, y = *(const double *) b;
+    return (x > y) - (x < y);
+}
+
+static double percentile(const double *sorted, int n, double p){
+    int i = (int) (p * (n - 1) + 0.5);
+    return sorted[i];
+}
+
+static void run(int sched, const char *load_name, const struct load_config *load, int steps, struct run_result *res){
+    static double latency_us[MAX_STEPS];
+    pthread_t ticker_thread, sensors_thread, control_thread;
+    int n = 0;
+
+    memset(res, 0, sizeof(*res));
+    res->sched = sched;
+    res->load = load_name;
+    res->steps = steps;
+
+    if(load_start(load)){
+        fprintf(stderr, "Falha ao iniciar a carga %s\n", load_name);
+        exit(1);
+    }
+
+    sched_config = sched;
+    stopping = 0;
+    while(sem_trywait(&hold_sensors) == 0){
+    }
+    thread_errors = 0;
+    pthread_barrier_init(&started, NULL, 4);
+    pthread_create(&ticker_thread, NULL, ticker, NULL);
+    pthread_create(&sensors_thread, NULL, sensors, NULL);
+    pthread_create(&control_thread, NULL, control, NULL);
+    pthread_barrier_wait(&started);
+
+    if(thread_errors){
+        res->skipped = true;
+    }else{
+        // Let the loop settle on the current TR
+        sleepNs(5LL * period_ms * 1000000LL);
+        for(int k = 0; k < steps; k++){
+            while(sem_trywait(&reacted) == 0){
+            }
+            target_tr = target_tr == TR_LOW ? TR_HIGH : TR_LOW;
+            __atomic_store_n(&step_pending, true, __ATOMIC_RELEASE);
+            hal_sim_set_potentiometer(target_tr);
+
+            struct timespec deadline;
+            clock_gettime(CLOCK_REALTIME, &deadline);
+            deadline.tv_sec += 1 + (10 * period_ms) / 1000;
+            if(sem_timedwait(&reacted, &deadline)){
+                // No write for this step: drop it so it cannot match a later one
+                __atomic_store_n(&step_pending, false, __ATOMIC_RELEASE);
+                res->missed++;
+            }else{
+                latency_us[n++] = reaction_ns / 1000.0;
+            }
+            // Random phase against the acquisition period
+            sleepNs((int64_t) (rnd() % (period_ms * 1000)) * 1000);
+        }
+    }
+
+    // As stopThreads in main.c
+    stopping = 1;
+    pthread_join(ticker_thread, NULL);
+    sem_post(&hold_sensors);
+    sample_setpoint_changed();
+    pthread_join(sensors_thread, NULL);
+    pthread_join(control_thread, NULL);
+    pthread_barrier_destroy(&started);
+    load_stop();
+
+    if(n){
+        double sum = 0;
+        qsort(latency_us, n, sizeof(double), cmpDouble);
+        for(int i = 0; i < n; i++){
+            sum += latency_us[i];
+        }
+        res->min_us = latency_us[0];
+        res->p50_us = percentile(latency_us, n, 0.50);
+        res->p90_us = percentile(latency_us, n, 0.90);
+        res->p99_us = percentile(latency_us, n, 0.99);
+        res->max_us = latency_us[n - 1];
+        res->mean_us = sum / n;
+    }
+}
+
+static void printTable(const struct run_result *results, int count){
+    printf("%-12s %-7s %6s %8s %9s %9s %9s %9s %9s %9s\n",
+        "Escalonador", "Carga", "Degr.", "Perdidos", "Mín(us)", "p50", "p90", "p99", "Máx", "Média");
+    for(int i = 0; i < count; i++){
+        const struct run_result *r = &results[i];
+        if(r->skipped){
+            printf("%-12s %-7s %s\n", rt_name(r->sched), r->load, "sem permissão (CAP_SYS_NICE?)");
+            continue;
+        }
+        printf("%-12s %-7s %6d %8d %9.1f %9.1f %9.1f %9.1f %9.1f %9.1f\n",
+            rt_name(r->sched), r->load, r->steps, r->missed,
+            r->min_us, r->p50_us, r->p90_us, r->p99_us, r->max_us, r->mean_us);
+    }
+}
+
+static int writeJson(const char *path, const struct run_result *results, int count, int hogs){
+    FILE *out = fopen(path, "w");
+    if(!out){
+        return -1;
+    }
+    const char *revision = getenv("BENCH_REVISION");
+    fprintf(out, "{\"suite\": \"latency\", \"revision\": ");
+    if(revision && *revision){
+        fprintf(out, "\"%s\"", revision);
+    }else{
+        fprintf(out, "null");
+    }
+    fprintf(out, ", \"period_ms\": %d, \"hogs\": %d, \"runs\": [", period_ms, hogs);
+    for(int i = 0; i < count; i++){
+        const struct run_result *r = &results[i];
+        fprintf(out, "%s\n  {\"sched\": \"%s\", \"load\": \"%s\", ", i ? "," : "", rt_name(r->sched), r->load);
+        if(r->skipped){
+            fprintf(out, "\"skipped\": true}");
+            continue;
+        }
+        fprintf(out, "\"skipped\": false, \"steps\": %d, \"missed\": %d, \"min_us\": %.1f, \"p50_us\": %.1f, "
+            "\"p90_us\": %.1f, \"p99_us\": %.1f, \"max_us\": %.1f, \"mean_us\": %.1f}",
+            r->steps, r->missed, r->min_us, r->p50_us, r->p90_us, r->p99_us, r->max_us, r->mean_us);
+    }
+    fprintf(out, "\n]}\n");
+    fclose(out);
+    return 0;
+}
+
+static void printUsage(const char *name){
+    printf("Uso: %s [-n degraus] [-p periodo_ms] [-s escalonadores] [-l cargas] [-j hogs] [-C cpu] [-d dir] [-o saida.json]\n", name);
+    printf("  -n  Degraus de TI por execução (padrão 300)\n");
+    printf("  -p  Período de aquisição em ms (padrão 10)\n");
+    printf("  -s  Lista de: default, fifo, pinned, fifo+pinned (padrão todos)\n");
+    printf("  -l  Lista de: none, cpu, io, cpu+io (padrão todas)\n");
+    printf("  -j  Processos de carga de cada tipo (padrão: número de CPUs)\n");
+    printf("  -C  CPU das configurações fixadas (padrão: a última)\n");
+    printf("  -d  Diretório dos arquivos da carga de E/S (padrão /tmp)\n");
+    printf("  -o  Grava os resultados em JSON\n");
+}
+
+int main(int argc, char *argv[]){
+    int steps = 300;
+    int hogs = (int) sysconf(_SC_NPROCESSORS_ONLN);
+    const char *sched_list = "default,fifo,pinned,fifo+pinned";
+    const char *load_list = "none,cpu,io,cpu+io";
+    const char *json_path = NULL;
+    struct load_config load = {0};
+    int opt;
+
+    while((opt = getopt(argc, argv, "n:p:s:l:j:C:d:o:h")) != -1){
+        switch(opt){
+            case 'n':
+                steps = atoi(optarg);
+                break;
+            case 'p':
+                period_ms = atoi(optarg);
+                break;
+            case 's':
+                sched_list = optarg;
+                break;
+            case 'l':
+                load_list = optarg;
+                break;
+            case 'j':
+                hogs = atoi(optarg);
+                break;
+            case 'C':
+                rt_cpu = atoi(optarg);
+                break;
+            case 'd':
+                load.dir = optarg;
+                break;
+            case 'o':
+                json_path = optarg;
+                break;
+            case 'h':
+                printUsage(argv[0]);
+                return 0;
+            default:
+                printUsage(argv[0]);
+                return 1;
+        }
+    }
+    if(steps <= 0 || steps > MAX_STEPS || period_ms <= 0 || hogs < 0 || hogs > LOAD_MAX_HOGS / 3){
+        printUsage(argv[0]);
+        return 1;
+    }
+    if(rt_cpu < 0){
+        rt_cpu = (int) sysconf(_SC_NPROCESSORS_ONLN) - 1;
+    }
+
+    int scheds[RT_CONFIGS], sched_count = 0;
+    const char *loads[MAX_LOADS];
+    int load_count = 0;
+    char scheds_buf[128], loads_buf[128];
+    char *save, *tok;
+    snprintf(scheds_buf, sizeof(scheds_buf), "%s", sched_list);
+    for(tok = strtok_r(scheds_buf, ",", &save); tok && sched_count < RT_CONFIGS; tok = strtok_r(NULL, ",", &save)){
+        if((scheds[sched_count++] = rt_parse(tok)) < 0){
+            fprintf(stderr, "Escalonador desconhecido: %s\n", tok);
+            return 1;
+        }
+    }
+    snprintf(loads_buf, sizeof(loads_buf), "%s", load_list);
+    for(tok = strtok_r(loads_buf, ",", &save); tok && load_count < MAX_LOADS; tok = strtok_r(NULL, ",", &save)){
+        struct load_config check;
+        if(load_parse(tok, hogs, &check)){
+            fprintf(stderr, "Carga desconhecida: %s\n", tok);
+            return 1;
+        }
+        loads[load_count++] = tok;
+    }
+
+    // Chamber held at CHAMBER_TEMP: no heating, no noise, flat ambient
+    struct plant_model model;
+    plant_model_defaults(&model);
+    model.gain_heater = model.gain_fan = 0;
+    model.noise = 0;
+    model.ambient = model.initial = CHAMBER_TEMP;
+    model.ambient_amplitude = 0;
+    hal_select("sim");
+    hal_sim_configure(&model, target_tr, 1);
+    hal_sim_set_write_hook(onWrite);
+
+    // Potentiometer reference, no input filters
+    struct config defaults;
+    config_defaults(&defaults);
+    filter_init(&ti_filter, &defaults.filter_ti);
+    filter_init(&tr_filter, &defaults.filter_tr);
+    thermal_model = model;
+    input_mode = POTENTIOMETER_INPUT;
+    histeresis_temp = HISTERESIS;
+    reference_temp_ready = histeresis_temp_ready = true;
+    running = true;
+    sem_init(&hold_sensors, 0, 0);
+    int8_t rslt;
+    if(loop_sensor_open(&rslt)){
+        fprintf(stderr, "Falha na inicialização do BME280 simulado (%+d)\n", rslt);
+        return 1;
+    }
+    loop_sensor_failed = sensorFailed;
+
+    // Hysteresis with no dwell times: every step is one GPIO write
+    struct control_config cfg;
+    control_defaults(&cfg);
+    cfg.min_on_ms = 0;
+    cfg.min_off_ms = 0;
+    control_init(&cfg);
+    sample_init(false);
+    sem_init(&reacted, 0, 0);
+    rt_lock_memory();
+
+    // Full-rate logging, as with -f
+    log_mode = LOG_MODE_FULL_RATE;
+    char data_path[256], events_path[256];
+    const char *dir = load.dir ? load.dir : "/tmp";
+    snprintf(data_path, sizeof(data_path), "%s/latency_data_%d.csv", dir, (int) getpid());
+    snprintf(events_path, sizeof(events_path), "%s/latency_events_%d.csv", dir, (int) getpid());
+    if(logger_start(data_path, events_path, NULL, NULL)){
+        fprintf(stderr, "Não foi possivel abrir %s\n", data_path);
+        return 1;
+    }
+
+    static struct run_result results[RT_CONFIGS * MAX_LOADS];
+    int count = 0;
+    for(int l = 0; l < load_count; l++){
+        load_parse(loads[l], hogs, &load);
+        for(int s = 0; s < sched_count; s++){
+            fprintf(stderr, "%s / %s...\n", rt_name(scheds[s]), loads[l]);
+            run(scheds[s], loads[l], &load, steps, &results[count++]);
+        }
+    }
+
+    control_shutdown();
+    logger_stop();
+    unlink(data_path);
+    unlink(events_path);
+
+    printTable(results, count);
+    if(json_path && writeJson(json_path, results, count, hogs)){
+        fprintf(stderr, "Não foi possivel gravar %s\n", json_path);
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,144 @@
+/*
+* Per-sample costs outside the sensor driver: LCD frame encoding, CSV row
+* formatting, logger throughput to disk, the UART protocol and one update
+* of each control law.
+*
+* Usage: bench_micro [dir]
+* The logger benchmark writes its files under dir (default /tmp).
+*/
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sched.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <controller.h>
+#include <lcd_encode.h>
+#include <state.h>
+#include <logger.h>
+#include <uart_utils.h>
+
+#include "benchlib.h"
+
+#define LCD_FRAME_WRITES ((1 + 16) * LCD_WRITES_PER_BYTE * 2)
+
+struct log_paths {
+    char data[256];
+    char events[256];
+};
+
+// Same lines as handleLCD, encoded into the PCF8574 write sequence
+static void lcdFrame(void *ctx, uint64_t iters){
+    char line1[17], line2[17]; // 16 columns
+    uint8_t writes[LCD_FRAME_WRITES];
+    uint64_t acc = 0;
+    for(uint64_t i = 0; i < iters; i++){
+        float ti = 25.0f + (i & 0xFF) * 0.01f;
+        snprintf(line1, sizeof(line1), "TR %.2f ", 40.0f);
+        snprintf(line2, sizeof(line2), "TI%.2f TE%.2f ", ti, 23.5f);
+        size_t n = lcd_encode_line(LINE1, line1, writes);
+        n += lcd_encode_line(LINE2, line2, writes + n);
+        acc += n + writes[n - 1];
+    }
+    bench_sink += acc;
+}
+
+static void csvRow(void *ctx, uint64_t iters){
+    struct log_record rec = { .type = LOG_REC_SAMPLE, .reference_temp = 40.0f, .extern_temp = 23.5f };
+    char row[128];
+    uint64_t acc = 0;
+    clock_gettime(CLOCK_REALTIME, &rec.ts);
+    for(uint64_t i = 0; i < iters; i++){
+        rec.intern_temp = 25.0f + (i & 0xFF) * 0.01f;
+        acc += logger_format_record(row, sizeof(row), &rec);
+    }
+    bench_sink += acc;
+}
+
+// Producer to file through the writer thread, start and stop included
+static void loggerThroughput(void *ctx, uint64_t iters){
+    const struct log_paths *paths = ctx;
+    unlink(paths->data);
+    unlink(paths->events);
+    if(logger_start(paths->data, paths->events, NULL, NULL)){
+        fprintf(stderr, "Erro ao abrir %s\n", paths->data);
+        exit(1);
+    }
+    for(uint64_t i = 0; i < iters; i++){
+        // Queue full: wait for the writer instead of counting a drop
+        while(!logger_push_sample(40.0f, 25.0f + (i & 0xFF) * 0.01f, 23.5f)){
+            sched_yield();
+        }
+    }
+    logger_stop();
+}
+
+static void uartEncode(void *ctx, uint64_t iters){
+    uint8_t req[UART_REQUEST_SIZE];
+    uint64_t acc = 0;
+    for(uint64_t i = 0; i < iters; i++){
+        uart_encode_request(i & 1 ? UART_CMD_TR : UART_CMD_TI, req);
+        acc += req[0];
+    }
+    bench_sink += acc;
+}
+
+static void uartDecode(void *ctx, uint64_t iters){
+    uint8_t answer[sizeof(float)];
+    float value, acc = 0;
+    for(uint64_t i = 0; i < iters; i++){
+        value = 25.0f + (i & 0xFF) * 0.01f;
+        memcpy(answer, &value, sizeof(value));
+        if(!uart_decode_temperature(answer, sizeof(answer), &value)){
+            acc += value;
+        }
+    }
+    bench_sink += (uint64_t) acc;
+}
+
+// One output per call: the virtual time moves a whole PID period each time
+static void controllerUpdate(void *ctx, uint64_t iters){
+    struct controller_config cfg = {0};
+    struct controller c;
+    cfg.type = *(const int *) ctx;
+    cfg.pid = (struct pid_controller_config) { 0.5f, 0.002f, 10.0f, 0, 1000 };
+    plant_model_defaults(&cfg.smith.model);
+    cfg.smith.lambda_s = SMITH_DEFAULT_LAMBDA_S;
+    cfg.smith.feedforward = true;
+    cfg.smith.period_ms = 1000;
+    controller_init(&c, &cfg);
+    struct controller_input in = { 0, 40.0f, 25.0f, 0.5f, 23.5f };
+    uint64_t acc = 0;
+    for(uint64_t i = 0; i < iters; i++){
+        in.now_ms = (int64_t) i * 1000;
+        in.temp = 38.0f + (i & 0xFF) * 0.01f;
+        acc += controller_update(&c, &in) + c.out.state;
+    }
+    bench_sink += acc;
+}
+
+int main(int argc, char *argv[]){
+    const char *dir = argc > 1 ? argv[1] : "/tmp";
+    struct log_paths paths;
+    snprintf(paths.data, sizeof(paths.data), "%s/bench_data_%d.csv", dir, (int) getpid());
+    snprintf(paths.events, sizeof(paths.events), "%s/bench_events_%d.csv", dir, (int) getpid());
+
+    bench_begin("micro", NULL);
+    bench_run("lcd_frame", lcdFrame, NULL);
+    bench_run("csv_row", csvRow, NULL);
+    bench_run_sample("logger_sample", loggerThroughput, &paths, 50000000LL);
+    bench_run("uart_encode_request", uartEncode, NULL);
+    bench_run("uart_decode_temperature", uartDecode, NULL);
+    int types[CONTROLLER_TYPES] = { CONTROL_HYSTERESIS, CONTROL_PID, CONTROL_SMITH };
+    bench_run("controller_hysteresis", controllerUpdate, &types[0]);
+    bench_run("controller_pid", controllerUpdate, &types[1]);
+    bench_run("controller_smith", controllerUpdate, &types[2]);
+    bench_end();
+
+    unlink(paths.data);
+    unlink(paths.events);
+    return 0;
+}
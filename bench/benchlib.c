@@ -0,0 +1,164 @@
+/*
+* Micro-benchmark harness: calibrates a batch size, warms up, then times
+* BENCH_SAMPLES batches and reports median and MAD per operation, in
+* nanoseconds and (when perf_event_open is allowed) user-space cycles.
+* Output is one JSON object per suite on stdout.
+*/
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <sys/utsname.h>
+#include <linux/perf_event.h>
+
+#include "benchlib.h"
+
+volatile uint64_t bench_sink;
+
+static int cycles_fd = -1;
+static int results = 0;
+
+static int64_t now_ns(void){
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t) ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+static int openCycles(void){
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.type = PERF_TYPE_HARDWARE;
+    attr.size = sizeof(attr);
+    attr.config = PERF_COUNT_HW_CPU_CYCLES;
+    attr.disabled = 1;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    return (int) syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+}
+
+static int cmpDouble(const void *a, const void *b){
+    double x = *(const double *) a, y = *(const double *) b;
+    return (x > y) - (x < y);
+}
+
+static double median(double *v, int n){
+    qsort(v, n, sizeof(double), cmpDouble);
+    return n % 2 ? v[n / 2] : (v[n / 2 - 1] + v[n / 2]) / 2;
+}
+
+// Median absolute deviation; v is left sorted by median()
+static double mad(const double *v, int n, double med){
+    double dev[BENCH_SAMPLES];
+    for(int i = 0; i < n; i++){
+        dev[i] = v[i] > med ? v[i] - med : med - v[i];
+    }
+    return median(dev, n);
+}
+
+static void printString(const char *s){
+    putchar('"');
+    for(; *s; s++){
+        if(*s == '"' || *s == '\\'){
+            putchar('\\');
+        }
+        putchar(*s);
+    }
+    putchar('"');
+}
+
+void bench_begin(const char *suite, const char *variant){
+    const char *revision = getenv("BENCH_REVISION");
+    struct utsname host;
+
+    cycles_fd = openCycles();
+    results = 0;
+    printf("{\"suite\": ");
+    printString(suite);
+    printf(", \"variant\": ");
+    if(variant){
+        printString(variant);
+    }else{
+        printf("null");
+    }
+    printf(", \"revision\": ");
+    if(revision && *revision){
+        printString(revision);
+    }else{
+        printf("null");
+    }
+    printf(", \"machine\": ");
+    printString(uname(&host) ? "" : host.machine);
+    printf(", \"samples\": %d, \"cycles\": %s, \"results\": [", BENCH_SAMPLES, cycles_fd < 0 ? "false" : "true");
+    fflush(stdout);
+}
+
+// Runs one batch, returns elapsed ns and fills *cycles (-1 when unavailable)
+static int64_t sample(bench_fn fn, void *ctx, uint64_t iters, int64_t *cycles){
+    uint64_t count = 0;
+    if(cycles_fd >= 0){
+        ioctl(cycles_fd, PERF_EVENT_IOC_RESET, 0);
+        ioctl(cycles_fd, PERF_EVENT_IOC_ENABLE, 0);
+    }
+    int64_t t0 = now_ns();
+    fn(ctx, iters);
+    int64_t elapsed = now_ns() - t0;
+    if(cycles_fd >= 0){
+        ioctl(cycles_fd, PERF_EVENT_IOC_DISABLE, 0);
+        if(read(cycles_fd, &count, sizeof(count)) != sizeof(count)){
+            count = 0;
+        }
+    }
+    *cycles = cycles_fd >= 0 ? (int64_t) count : -1;
+    return elapsed;
+}
+
+void bench_run_sample(const char *name, bench_fn fn, void *ctx, int64_t sample_ns){
+    double ns[BENCH_SAMPLES], cyc[BENCH_SAMPLES];
+    int64_t cycles;
+    uint64_t iters = 1;
+
+    // Calibrate: double the batch until one sample is long enough
+    while(sample(fn, ctx, iters, &cycles) < sample_ns && iters < (1ULL << 40)){
+        iters *= 2;
+    }
+    for(int i = 0; i < BENCH_WARMUP_SAMPLES; i++){
+        sample(fn, ctx, iters, &cycles);
+    }
+    for(int i = 0; i < BENCH_SAMPLES; i++){
+        ns[i] = (double) sample(fn, ctx, iters, &cycles) / iters;
+        cyc[i] = (double) cycles / iters;
+    }
+
+    double ns_med = median(ns, BENCH_SAMPLES);
+    double ns_mad = mad(ns, BENCH_SAMPLES, ns_med);
+
+    printf("%s\n  {\"name\": ", results++ ? "," : "");
+    printString(name);
+    printf(", \"iterations\": %llu, \"median_ns\": %.3f, \"mad_ns\": %.3f",
+        (unsigned long long) iters, ns_med, ns_mad);
+    if(cycles >= 0){
+        double cyc_med = median(cyc, BENCH_SAMPLES);
+        printf(", \"median_cycles\": %.1f, \"mad_cycles\": %.1f}", cyc_med, mad(cyc, BENCH_SAMPLES, cyc_med));
+    }else{
+        printf(", \"median_cycles\": null, \"mad_cycles\": null}");
+    }
+    fflush(stdout);
+}
+
+void bench_run(const char *name, bench_fn fn, void *ctx){
+    bench_run_sample(name, fn, ctx, BENCH_SAMPLE_NS);
+}
+
+void bench_end(void){
+    printf("\n]}\n");
+    fflush(stdout);
+    if(cycles_fd >= 0){
+        close(cycles_fd);
+        cycles_fd = -1;
+    }
+}
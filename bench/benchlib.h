@@ -0,0 +1,25 @@
+#ifndef BENCHLIB_H
+#define BENCHLIB_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Each sample runs the body enough times to take at least this long
+#define BENCH_SAMPLE_NS 200000LL
+#define BENCH_WARMUP_SAMPLES 5
+#define BENCH_SAMPLES 31
+
+// Body under test: must run its operation iters times
+typedef void (*bench_fn)(void *ctx, uint64_t iters);
+
+// Results feed into this so the compiler cannot drop the work
+extern volatile uint64_t bench_sink;
+
+// Opens the JSON object of one suite (revision from $BENCH_REVISION)
+void bench_begin(const char *suite, const char *variant);
+void bench_run(const char *name, bench_fn fn, void *ctx);
+// Same, with a longer sample for bodies that carry setup cost
+void bench_run_sample(const char *name, bench_fn fn, void *ctx, int64_t sample_ns);
+void bench_end(void);
+
+#endif
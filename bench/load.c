@@ -0,0 +1,137 @@
+#define _GNU_SOURCE
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/prctl.h>
+#include <sys/wait.h>
+
+#include "load.h"
+
+static pid_t hogs[LOAD_MAX_HOGS];
+static int hog_count = 0;
+
+static void cpuHog(void){
+    volatile unsigned long spin = 0;
+    while(true){
+        spin++;
+    }
+}
+
+static void memHog(void){
+    char *a = malloc(LOAD_MEM_BYTES), *b = malloc(LOAD_MEM_BYTES);
+    if(!a || !b){
+        _exit(1);
+    }
+    memset(a, 0x5A, LOAD_MEM_BYTES);
+    while(true){
+        memcpy(b, a, LOAD_MEM_BYTES);
+        memcpy(a, b, LOAD_MEM_BYTES);
+    }
+}
+
+static void ioHog(const char *dir){
+    static char chunk[LOAD_IO_CHUNK];
+    char path[256];
+    snprintf(path, sizeof(path), "%s/load_io_%d.tmp", dir, (int) getpid());
+    int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0600);
+    if(fd < 0){
+        _exit(1);
+    }
+    // Gone from the directory, the blocks are freed when the hog is killed
+    unlink(path);
+    memset(chunk, 0xA5, sizeof(chunk));
+    off_t written = 0;
+    while(true){
+        if(write(fd, chunk, sizeof(chunk)) < 0){
+            _exit(1);
+        }
+        fsync(fd);
+        written += sizeof(chunk);
+        // Keep the file bounded (64 MiB)
+        if(written >= 64 * 1024 * 1024){
+            ftruncate(fd, 0);
+            lseek(fd, 0, SEEK_SET);
+            written = 0;
+        }
+    }
+}
+
+#define HOG_CPU 0
+#define HOG_MEM 1
+#define HOG_IO 2
+
+static int spawn(int kind, const char *dir){
+    if(hog_count == LOAD_MAX_HOGS){
+        return -1;
+    }
+    pid_t pid = fork();
+    if(pid < 0){
+        return -1;
+    }
+    if(pid == 0){
+        prctl(PR_SET_PDEATHSIG, SIGKILL);
+        if(kind == HOG_IO){
+            ioHog(dir);
+        }else if(kind == HOG_MEM){
+            memHog();
+        }
+        cpuHog();
+    }
+    hogs[hog_count++] = pid;
+    return 0;
+}
+
+int load_parse(const char *name, int n, struct load_config *cfg){
+    cfg->cpu_hogs = 0;
+    cfg->mem_hogs = 0;
+    cfg->io_hogs = 0;
+    if(strcmp(name, "none") == 0){
+        return 0;
+    }
+    const char *p = name;
+    while(*p){
+        size_t len = strcspn(p, "+");
+        if(len == 3 && strncmp(p, "cpu", 3) == 0){
+            cfg->cpu_hogs = n;
+        }else if(len == 3 && strncmp(p, "mem", 3) == 0){
+            cfg->mem_hogs = n;
+        }else if(len == 2 && strncmp(p, "io", 2) == 0){
+            cfg->io_hogs = n;
+        }else{
+            return -1;
+        }
+        p += len;
+        if(*p == '+'){
+            p++;
+        }
+    }
+    return 0;
+}
+
+int load_start(const struct load_config *cfg){
+    const char *dir = cfg->dir ? cfg->dir : "/tmp";
+    int counts[3] = { cfg->cpu_hogs, cfg->mem_hogs, cfg->io_hogs };
+    for(int kind = HOG_CPU; kind <= HOG_IO; kind++){
+        for(int i = 0; i < counts[kind]; i++){
+            if(spawn(kind, dir)){
+                load_stop();
+                return -1;
+            }
+        }
+    }
+    return 0;
+}
+
+void load_stop(void){
+    for(int i = 0; i < hog_count; i++){
+        kill(hogs[i], SIGKILL);
+    }
+    for(int i = 0; i < hog_count; i++){
+        waitpid(hogs[i], NULL, 0);
+    }
+    hog_count = 0;
+}
@@ -0,0 +1,25 @@
+#ifndef LOAD_H
+#define LOAD_H
+
+// Background load for the timing benchmarks: hogs are child processes
+// (like the other services on the Pi), killed by load_stop or when the
+// benchmark dies.
+
+#define LOAD_MAX_HOGS 64
+#define LOAD_IO_CHUNK (256 * 1024) // bytes written between two fsync
+#define LOAD_MEM_BYTES (32 * 1024 * 1024) // copied back and forth, well past the caches
+
+struct load_config {
+    int cpu_hogs; // busy loops
+    int mem_hogs; // memcpy loops (memory bandwidth)
+    int io_hogs;  // write + fsync loops
+    const char *dir; // where the io hogs write (unlinked files)
+};
+
+// Parses "none" or kinds joined by '+' ("cpu", "mem", "io", "cpu+io"...),
+// n hogs of each kind
+int load_parse(const char *name, int n, struct load_config *cfg);
+int load_start(const struct load_config *cfg);
+void load_stop(void);
+
+#endif
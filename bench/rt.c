@@ -0,0 +1,56 @@
+#define _GNU_SOURCE
+#include <string.h>
+#include <errno.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/mman.h>
+
+#include "rt.h"
+
+static const char *NAMES[RT_CONFIGS] = { "default", "fifo", "pinned", "fifo+pinned" };
+
+int rt_parse(const char *name){
+    for(int i = 0; i < RT_CONFIGS; i++){
+        if(strcmp(name, NAMES[i]) == 0){
+            return i;
+        }
+    }
+    return -1;
+}
+
+const char *rt_name(int config){
+    return config >= 0 && config < RT_CONFIGS ? NAMES[config] : "?";
+}
+
+int rt_apply(int config, int priority, int cpu){
+    struct sched_param param;
+    int res;
+
+    if(config == RT_PINNED || config == RT_FIFO_PINNED){
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        CPU_SET(cpu, &set);
+        res = pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+        if(res){
+            errno = res;
+            return -1;
+        }
+    }
+    if(config == RT_FIFO || config == RT_FIFO_PINNED){
+        param.sched_priority = priority;
+        res = pthread_setschedparam(pthread_self(), SCHED_FIFO, &param);
+    }else{
+        param.sched_priority = 0;
+        res = pthread_setschedparam(pthread_self(), SCHED_OTHER, &param);
+    }
+    if(res){
+        errno = res;
+        return -1;
+    }
+    return 0;
+}
+
+void rt_lock_memory(void){
+    // Best effort: needs CAP_IPC_LOCK or a large enough RLIMIT_MEMLOCK
+    mlockall(MCL_CURRENT | MCL_FUTURE);
+}
@@ -0,0 +1,20 @@
+#ifndef RT_H
+#define RT_H
+
+#include <stdbool.h>
+
+// Scheduler configurations compared by the timing benchmarks
+#define RT_DEFAULT 0 // SCHED_OTHER, any CPU
+#define RT_FIFO 1    // SCHED_FIFO at the given priority
+#define RT_PINNED 2  // SCHED_OTHER, one CPU
+#define RT_FIFO_PINNED 3
+#define RT_CONFIGS 4
+
+int rt_parse(const char *name);
+const char *rt_name(int config);
+// Applies config to the calling thread; -1 (errno set) if not permitted
+int rt_apply(int config, int priority, int cpu);
+// Locks memory once, so page faults stay out of the measurements
+void rt_lock_memory(void);
+
+#endif
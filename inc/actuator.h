@@ -0,0 +1,45 @@
+#ifndef ACTUATOR_H
+#define ACTUATOR_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Heater and fan outputs (active low). The module owns the pins: it caches
+// the written levels, updates both outputs with one masked register write,
+// holds each output for a minimum on/off time, counts transitions and on
+// time, and logs every transition to events.csv. An output is not turned
+// on while the other one is held on against its request.
+
+#define ACTUATOR_HEATER 0
+#define ACTUATOR_FAN 1
+#define ACTUATOR_OUTPUTS 2
+
+#define ACTUATOR_DEFAULT_MIN_ON_MS 0
+#define ACTUATOR_DEFAULT_MIN_OFF_MS 0
+
+struct actuator_output_stats {
+    bool on;
+    uint64_t transitions;
+    uint64_t deferred; // requests held back by the minimum dwell time
+    int64_t on_ms;
+    float duty; // on time / time since actuator_init
+};
+
+struct actuator_stats {
+    struct actuator_output_stats out[ACTUATOR_OUTPUTS];
+    uint64_t requests;
+    uint64_t writes; // masked register writes
+};
+
+int actuator_init(uint8_t heater_pin, uint8_t fan_pin, int min_on_ms, int min_off_ms);
+
+// Control state recorded with the following transition events
+void actuator_set_state(int state);
+// Requests both outputs; changes inside the dwell time wait for a later request
+void actuator_set(bool heater_on, bool fan_on);
+// Both outputs off now, ignoring the dwell times (shutdown)
+void actuator_off(void);
+
+void actuator_get_stats(struct actuator_stats *stats);
+
+#endif
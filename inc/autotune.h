@@ -0,0 +1,67 @@
+#ifndef AUTOTUNE_H
+#define AUTOTUNE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Relay-feedback auto-tuning (Astrom-Hagglund). A relay with hysteresis
+// eps switches the output between +d (heater) and -d (fan) around the
+// setpoint; the plant settles into a limit cycle of amplitude a and period
+// Pu, giving the ultimate gain Ku = 4d / (pi * sqrt(a^2 - eps^2)).
+
+#define AUTOTUNE_DEFAULT_CYCLES 4
+#define AUTOTUNE_RELAY_AMPLITUDE 1.0f // output units (-1 fan .. 1 heater)
+#define AUTOTUNE_MIN_HYSTERESIS 0.1f
+#define AUTOTUNE_MAX_HALF_CYCLE_MS (2 * 3600 * 1000)
+
+#define AUTOTUNE_RULE_ZN 0 // Ziegler-Nichols, quarter decay ratio
+#define AUTOTUNE_RULE_TL 1 // Tyreus-Luyben, less overshoot
+
+// Expected 2% settling time in ultimate periods (rules of thumb: quarter
+// decay reaches 2% after ln(50)/ln(4) ~ 2.8 periods; TL trades speed for damping)
+#define AUTOTUNE_SETTLING_PERIODS_ZN 2.8f
+#define AUTOTUNE_SETTLING_PERIODS_TL 4.0f
+
+#define AUTOTUNE_IDLE 0
+#define AUTOTUNE_RUNNING 1
+#define AUTOTUNE_DONE 2
+#define AUTOTUNE_FAILED 3
+
+struct autotune_result {
+    float amplitude; // oC, half peak-to-peak
+    float period_s;  // ultimate period
+    float ku;
+    float kp;
+    float ki;        // 1/s
+    float kd;        // s
+    float settling_s;
+};
+
+struct autotune {
+    int status;
+    int rule;
+    int cycles;      // cycles measured after the first (discarded) one
+    float setpoint;
+    float eps;
+    float relay;     // current output, +d or -d
+
+    int64_t last_switch_ms;
+    int64_t last_rise_ms; // last switch to heating
+    float peak_max;
+    float peak_min;
+    int completed;   // full cycles seen, including the discarded one
+
+    double sum_period_s;
+    double sum_max;
+    double sum_min;
+
+    struct autotune_result result;
+};
+
+void autotune_start(struct autotune *at, float setpoint, float eps, int cycles, int rule);
+float autotune_step(struct autotune *at, int64_t now_ms, float measurement);
+void autotune_gains(int rule, float ku, float pu, struct autotune_result *res);
+int autotune_save(const char *path, const struct autotune *at);
+const char *autotune_rule_name(int rule);
+
+#endif
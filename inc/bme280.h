@@ -365,6 +365,95 @@ int8_t bme280_compensate_data(uint8_t sensor_comp,
                               struct bme280_data *comp_data,
                               struct bme280_calib_data *calib_data);
 
+/**
+ * \ingroup bme280
+ * \defgroup bme280ApiReentrant Reentrant
+ * @brief Sensor data access that does not write to shared state
+ *
+ * The calls below only read the device structure and the calibration data:
+ * t_fine is kept on the stack and the interface result is returned, not
+ * stored in intf_rslt. Several threads may read the same bme280_dev (or
+ * share one calibration block) at once. Bus access is still the caller's to
+ * serialize, and the settings are caller owned: set them once with
+ * bme280_set_sensor_settings before the threads start.
+ */
+
+/*!
+ * \ingroup bme280ApiReentrant
+ * \page bme280_api_bme280_compensate_data_r bme280_compensate_data_r
+ * \code
+ * int8_t bme280_compensate_data_r(uint8_t sensor_comp,
+ *                               const struct bme280_uncomp_data *uncomp_data,
+ *                               struct bme280_data *comp_data,
+ *                               const struct bme280_calib_data *calib_data);
+ * \endcode
+ * @details Same as bme280_compensate_data, as a pure function of the raw
+ * data and the calibration: calib_data->t_fine is neither read nor written.
+ *
+ * @param[in] sensor_comp : Used to select pressure and/or temperature and/or
+ * humidity.
+ * @param[in] uncomp_data : Contains the uncompensated pressure, temperature and
+ * humidity data.
+ * @param[out] comp_data : Contains the compensated pressure and/or temperature
+ * and/or humidity data.
+ * @param[in] calib_data : Pointer to the calibration data structure.
+ *
+ * @return Result of API execution status.
+ *
+ * @retval   0 -> Success.
+ * @retval < 0 -> Fail.
+ *
+ */
+int8_t bme280_compensate_data_r(uint8_t sensor_comp,
+                                const struct bme280_uncomp_data *uncomp_data,
+                                struct bme280_data *comp_data,
+                                const struct bme280_calib_data *calib_data);
+
+/*!
+ * \ingroup bme280ApiReentrant
+ * \page bme280_api_bme280_get_sensor_data_r bme280_get_sensor_data_r
+ * \code
+ * int8_t bme280_get_sensor_data_r(uint8_t sensor_comp, struct bme280_data *comp_data, const struct bme280_dev *dev);
+ * \endcode
+ * @details Same as bme280_get_sensor_data, without writing to dev.
+ *
+ * @param[in] sensor_comp : Variable which selects which data to be read from
+ * the sensor (BME280_PRESS, BME280_TEMP, BME280_HUM, BME280_ALL).
+ * @param[out] comp_data : Structure instance of bme280_data.
+ * @param[in] dev : Structure instance of bme280_dev.
+ *
+ * @return Result of API execution status
+ *
+ * @retval   0 -> Success.
+ * @retval < 0 -> Fail.
+ *
+ */
+int8_t bme280_get_sensor_data_r(uint8_t sensor_comp, struct bme280_data *comp_data, const struct bme280_dev *dev);
+
+/*!
+ * \ingroup bme280ApiReentrant
+ * \page bme280_api_bme280_start_forced_r bme280_start_forced_r
+ * \code
+ * int8_t bme280_start_forced_r(const struct bme280_settings *settings, const struct bme280_dev *dev);
+ * \endcode
+ * @details Starts one forced mode conversion with the temperature and
+ * pressure oversampling in settings, in a single register write. The sensor
+ * must be in sleep mode (after bme280_init or a finished forced conversion);
+ * the humidity oversampling, filter and standby time are the ones last
+ * written by bme280_set_sensor_settings. The data is ready after
+ * bme280_cal_meas_delay(settings) milliseconds.
+ *
+ * @param[in] settings : Oversampling settings of the conversion.
+ * @param[in] dev : Structure instance of bme280_dev.
+ *
+ * @return Result of API execution status
+ *
+ * @retval   0 -> Success.
+ * @retval < 0 -> Fail.
+ *
+ */
+int8_t bme280_start_forced_r(const struct bme280_settings *settings, const struct bme280_dev *dev);
+
 /**
  * \ingroup bme280
  * \defgroup bme280ApiSensorDelay Sensor Delay
@@ -0,0 +1,22 @@
+#ifndef CHART_H
+#define CHART_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <ncurses.h>
+
+// Sweep chart of TI/TE/TR and the hysteresis band. Each column is a min/max
+// bucket of CHART_SECONDS_PER_COL seconds; columns are written in place
+// (oscilloscope style) so a new sample redraws only its own column.
+
+#define CHART_SECONDS_PER_COL 30
+#define CHART_MIN_ROWS 3
+
+int chart_init(WINDOW *w, int top, int bottom);
+bool chart_enabled(void);
+void chart_add(int64_t ts_ms, float intern_temp, float extern_temp, float reference_temp, float histeresis_temp);
+void chart_render(WINDOW *w);
+
+int64_t chart_span_ms(void);
+
+#endif
@@ -0,0 +1,80 @@
+#ifndef CONFIG_H
+#define CONFIG_H
+
+#include <stdbool.h>
+
+#include <control.h>
+#include <filter.h>
+#include <zone.h>
+
+// Configuration file: one "chave = valor" per line, '#' starts a comment.
+//
+//   headless = 1
+//   referencia = 35.0
+//   histerese = 1.0
+//   entrada = teclado | potenciometro
+//   log_completo = 0
+//   historico_horas = 24
+//   controle = histerese | pid | smith
+//   smith_lambda_s = 60          (Smith predictor: closed-loop time constant
+//   smith_feedforward = 1         and TE feedforward; model from modelo_planta)
+//   sombra = histerese | pid     (up to CONTROL_MAX_SHADOWS lines)
+//   sombra_kp = 0.3              (gains of the last sombra)
+//   sombra_ki = 0.003
+//   sombra_kd = 2.0
+//   kp = 0.2
+//   ki = 0.002
+//   kd = 2.0
+//   pid_periodo_ms = 1000
+//   pwm_periodo_ms = 50000
+//   pwm_min_ligado_ms = 5000     (shorter pulses and gaps are carried over)
+//   pwm_min_desligado_ms = 5000
+//   autotune = 0
+//   autotune_ciclos = 4
+//   autotune_regra = tl | zn
+//   tempo_min_ligado_ms = 0
+//   tempo_min_desligado_ms = 0
+//   simulacao = 0
+//   modelo_planta = planta.conf
+//   potenciometro = 40
+//   filtro_ti_outlier = 2.0      (also filtro_tr_*; see filter.h)
+//   filtro_ti_mediana = 5
+//   filtro_ti_ema = 0.3
+//   filtro_ti_kalman = 1
+//   filtro_ti_kalman_q = 0.001
+//   filtro_ti_kalman_r = 0.01
+//   zona = b                     (extra chamber, up to ZONE_MAX; the zona_*
+//   zona_i2c = /dev/i2c-1         lines below set the last one, see zone.h)
+//   zona_bme280 = 0x77
+//   zona_pinos = 5,6             (heater, fan; BCM)
+//   zona_referencia = tr | 40.0
+//   zona_histerese = 1.0
+//   zona_controle = histerese | pid | smith
+//   zona_periodo_ms = 1000
+//   zona_pwm_periodo_ms = 10000
+
+struct config {
+    bool headless;
+    bool has_reference;
+    float reference_temp;
+    bool has_histeresis;
+    float histeresis_temp;
+    bool has_input_mode;
+    int input_mode;
+    bool has_log_mode;
+    int log_mode;
+    int history_hours; // 0 = default
+    struct control_config control;
+    bool simulation;
+    char plant_model[256]; // empty = default model
+    float potentiometer; // simulated TR
+    struct filter_config filter_ti;
+    struct filter_config filter_tr; // potentiometer
+    struct zone_config zones[ZONE_MAX];
+    int zone_count;
+};
+
+void config_defaults(struct config *cfg);
+int config_load(const char *path, struct config *cfg);
+
+#endif
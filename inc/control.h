@@ -0,0 +1,120 @@
+#ifndef CONTROL_H
+#define CONTROL_H
+
+#include <stdbool.h>
+
+#include <hal.h>
+#include <pid.h>
+#include <pwm.h>
+#include <autotune.h>
+#include <actuator.h>
+#include <metrics.h>
+#include <controller.h>
+
+// Heater (resistor) and fan outputs, active low
+#define CONTROL_HEATER_PIN HAL_HEATER_PIN
+#define CONTROL_FAN_PIN HAL_FAN_PIN
+
+// The loop runs on every published sample or setpoint change; without
+// either (sensors stopped) it still steps after this long
+#define CONTROL_IDLE_MS 1000
+
+// Mode column of the metrics.csv steps run by the relay experiment
+#define CONTROL_METRICS_AUTOTUNE CONTROLLER_TYPES
+
+// Controllers evaluated side by side with the active one
+#define CONTROL_MAX_SHADOWS 2
+
+struct control_config {
+    int mode;
+    float kp;
+    float ki;
+    float kd;
+    float tf;
+    int pid_period_ms;
+    int pwm_period_ms;
+    int pwm_min_on_ms; // shortest pulse and gap the PWM writes
+    int pwm_min_off_ms;
+    bool autotune; // run the relay experiment at startup
+    int autotune_cycles;
+    int autotune_rule;
+    const char *gains_path; // where tuned gains are saved
+    int min_on_ms;  // actuator dwell times
+    int min_off_ms;
+    struct plant_model model; // chamber model (Smith predictor)
+    float smith_lambda_s;
+    bool smith_feedforward;
+    int shadows;
+    struct controller_config shadow[CONTROL_MAX_SHADOWS];
+    bool raw_compare; // also run the active law on the raw input (filters on)
+};
+
+struct control_input {
+    bool running;
+    float reference_temp;
+    float intern_temp;
+    float histeresis_temp;
+    float extern_temp;
+    int64_t sensed_ns; // CLOCK_MONOTONIC read time of a new TI, 0 if none
+    // Before the input filters (same as above when they are off)
+    float reference_raw;
+    float intern_raw;
+};
+
+struct control_shadow_status {
+    int type;
+    struct controller_config config;
+    float output;     // demand, -1 (fan) .. 1 (heater)
+    float divergence; // mean |shadow - actual| output since control_init
+    struct metrics_report metrics_total;
+};
+
+struct control_status {
+    int mode;
+    int state;
+    float output; // PID output, -1 (fan) .. 1 (heater)
+    struct pwm_stats pwm;
+    struct actuator_stats actuator;
+    int autotune_status;
+    int autotune_rule;
+    int autotune_cycle; // measured cycles so far
+    int autotune_cycles;
+    bool gains_saved;
+    struct autotune_result autotune;
+    // Sense-to-actuate latency: TI read to the outputs being updated
+    uint64_t reactions;
+    int64_t latency_last_us;
+    int64_t latency_max_us;
+    int64_t latency_avg_us;
+    // Active law: TI it acts on and the time its updates take
+    float predicted;
+    struct controller_timing timing;
+    // Control quality (measured TI): current step and since control_init
+    struct metrics_report metrics_step;
+    struct metrics_report metrics_total;
+    int shadows;
+    struct control_shadow_status shadow[CONTROL_MAX_SHADOWS];
+    // Output edges of the active law on the filtered input and, run
+    // alongside, on the raw one (PWM laws: two per modulated period);
+    // only counted with raw_compare
+    uint64_t switches_filtered;
+    uint64_t switches_unfiltered;
+};
+
+void control_defaults(struct control_config *cfg);
+// Configuration of a controller of the given type from the control gains
+void control_controller_config(const struct control_config *cfg, int type, struct controller_config *out);
+void control_init(const struct control_config *cfg);
+
+int control_step(const struct control_input *in);
+void control_request_mode(int mode);
+void control_request_autotune(void);
+// The first shadow becomes the active controller, keeping its state, and
+// the active one goes on as its shadow
+void control_request_swap(void);
+void control_get_status(struct control_status *status);
+// Current heater and fan levels, 0..1 (PWM duty or on/off)
+void control_get_outputs(float *heater, float *fan);
+void control_shutdown(void);
+
+#endif
@@ -0,0 +1,123 @@
+#ifndef CONTROLLER_H
+#define CONTROLLER_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include <pid.h>
+#include <plant.h>
+
+// A control law behind a common interface. control.c feeds every
+// controller the same input: the active one drives the outputs, shadows
+// only compute what they would have done. The law is picked by type
+// (CONTROL_HYSTERESIS, CONTROL_PID, CONTROL_SMITH in state.h).
+//
+// Smith predictor: a PI controller closes the loop on
+//
+//   TI + Ym(t) - Ym(t - theta)
+//
+// where Ym is the FOPDT model (plant.h) driven by the outputs and TE, so
+// the dead time theta is taken out of the loop. The PI gains follow from
+// the model (IMC: kp = tau / (Kh * lambda), ki = kp / tau), and an optional
+// static feedforward adds the output that holds TR at the current TE.
+
+#define CONTROLLER_TYPES 3
+
+// Longest dead time the Smith predictor holds, in controller periods
+#define SMITH_MAX_DELAY_STEPS 512
+#define SMITH_DEFAULT_LAMBDA_S 60.0f // closed-loop time constant, s
+
+// PID output magnitude below which the state is shown as stand by
+#define CONTROLLER_PID_DEADBAND 0.02f
+
+struct controller_input {
+    int64_t now_ms;
+    float reference;
+    float temp;
+    float band; // half the hysteresis, oC
+    float ambient; // TE, measured disturbance
+};
+
+struct controller_output {
+    float heater; // demand, 0..1; on/off laws give 0 or 1
+    float fan;
+    int state;    // ST_*
+    float predicted; // TI the law acts on (Smith: without the dead time)
+};
+
+struct pid_controller_config {
+    float kp;
+    float ki;
+    float kd;
+    float tf;
+    int period_ms;
+};
+
+struct smith_controller_config {
+    struct plant_model model;
+    float lambda_s;
+    bool feedforward; // from TE
+    int period_ms;
+};
+
+// Each law reads its own member
+struct controller_config {
+    int type;
+    struct pid_controller_config pid;
+    struct smith_controller_config smith;
+};
+
+// Time spent in the update of each law (CLOCK_MONOTONIC), per computed output
+struct controller_timing {
+    uint64_t iterations;
+    int64_t last_ns;
+    int64_t max_ns;
+    int64_t sum_ns;
+};
+
+struct controller;
+
+struct controller_ops {
+    const char *name; // configuration name
+    bool pwm;         // the demand is a duty cycle (PWM thread), else on/off
+    void (*reset)(struct controller *c);
+    // false while the law holds its previous output (between PID periods)
+    bool (*update)(struct controller *c, const struct controller_input *in, struct controller_output *out);
+};
+
+struct controller {
+    const struct controller_ops *ops;
+    struct controller_config config;
+    struct controller_output out; // last output
+    struct controller_timing timing;
+    union {
+        struct {
+            bool heater;
+            bool fan;
+        } hysteresis;
+        struct {
+            struct pid pid;
+            int64_t last_ms;
+        } pid;
+        struct {
+            struct pid pid;
+            int64_t last_ms;
+            float u;     // last output, -1 (fan) .. 1 (heater)
+            float model; // delay-free model temperature
+            float history[SMITH_MAX_DELAY_STEPS]; // model temperature, one per period
+            int delay;   // dead time in periods
+            int pos;
+        } smith;
+    };
+};
+
+// -1 for an unknown type
+int controller_init(struct controller *c, const struct controller_config *cfg);
+void controller_reset(struct controller *c);
+bool controller_update(struct controller *c, const struct controller_input *in);
+
+// Type of a configuration name ("histerese", "pid", "smith"), -1 if unknown
+int controller_parse(const char *name);
+const char *controller_name(int type);
+
+#endif
@@ -0,0 +1,56 @@
+#ifndef CSVLOG_H
+#define CSVLOG_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Read side of data.csv: the log is memory-mapped and parsed in place,
+// without stdio, with a sparse time index stored next to it (<log>.idx).
+
+#define CSVLOG_INDEX_MAGIC 0x31584449474F4C43ULL // "CLOGIDX1"
+#define CSVLOG_INDEX_STRIDE 65536 // bytes of log between index entries
+
+struct csvlog_row {
+    int64_t ts_ms; // local asctime converted to epoch
+    float reference_temp;
+    float intern_temp;
+    float extern_temp;
+};
+
+// One row of events.csv ("estado, resistor, ventoinha, data")
+struct csvlog_event {
+    int64_t ts_ms;
+    int state;
+    bool heater; // the file stores levels: 0 = ligado
+    bool fan;
+};
+
+struct csvlog_index_entry {
+    int64_t ts_ms;
+    uint64_t offset;
+};
+
+struct csvlog {
+    int fd;
+    const char *data;
+    size_t size;
+
+    int index_fd;
+    void *index_map;
+    const struct csvlog_index_entry *index;
+    size_t index_entries;
+    size_t index_map_size;
+};
+
+int csvlog_open(struct csvlog *log, const char *path);
+void csvlog_close(struct csvlog *log);
+
+int csvlog_index(struct csvlog *log, const char *index_path);
+size_t csvlog_seek(const struct csvlog *log, int64_t ts_ms);
+
+const char *csvlog_next(const char *p, const char *end, struct csvlog_row *row, bool *ok);
+const char *csvlog_next_event(const char *p, const char *end, struct csvlog_event *ev, bool *ok);
+int64_t csvlog_parse_time(const char *p, const char *end);
+
+#endif
@@ -0,0 +1,73 @@
+#ifndef FILTER_H
+#define FILTER_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include <plant.h>
+
+// Input filter of one channel (TI or the potentiometer TR). Stages run in
+// order, each one off by default:
+//
+//   outlier  samples further than `outlier` oC from the last output are
+//            dropped; FILTER_OUTLIER_MAX_RUN in a row are taken as a real
+//            step and restart the pipeline
+//   median   median of the last `median` samples
+//   ema      y += ema * (x - y)
+//   kalman   1-D Kalman filter. With a thermal model the prediction is the
+//            first-order response to TE and the outputs; the dead time is
+//            ignored and left to the process noise
+//
+// All state lives in struct filter, no allocation.
+
+#define FILTER_MEDIAN_MAX 9
+#define FILTER_OUTLIER_MAX_RUN 5
+#define FILTER_DEFAULT_KALMAN_Q 0.001f // oC2/s
+#define FILTER_DEFAULT_KALMAN_R 0.01f  // oC2
+
+struct filter_config {
+    float outlier; // oC, 0 = off
+    int median;    // window, 1 = off
+    float ema;     // weight of the new value, 1 = off
+    bool kalman;
+    float kalman_q; // process noise
+    float kalman_r; // measurement noise
+};
+
+// Known inputs of the Kalman prediction
+struct filter_process {
+    const struct plant_model *model; // NULL: the value is a random walk
+    float ambient; // TE
+    float heater;  // 0..1
+    float fan;
+};
+
+struct filter_stats {
+    uint64_t samples;
+    uint64_t rejected;
+    float raw;
+    float out;
+};
+
+struct filter {
+    struct filter_config cfg;
+    bool primed;
+    int rejected_run;
+    float window[FILTER_MEDIAN_MAX];
+    int count;
+    int pos;
+    float ema;
+    float x; // Kalman estimate
+    float p; // and its variance
+    struct filter_stats stats;
+};
+
+void filter_defaults(struct filter_config *cfg);
+bool filter_enabled(const struct filter_config *cfg);
+void filter_init(struct filter *f, const struct filter_config *cfg);
+// Starts over from the next sample, keeping the counters
+void filter_reset(struct filter *f);
+// dt_s since the previous sample; process may be NULL
+float filter_update(struct filter *f, float raw, float dt_s, const struct filter_process *process);
+
+#endif
@@ -0,0 +1,53 @@
+#ifndef GORILLA_H
+#define GORILLA_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Compressed time-series blocks (Gorilla, Pelkonen et al. 2015).
+// Timestamps are stored as delta-of-delta in milliseconds and every channel
+// as the XOR of the float with the previous value of the same channel.
+//
+// Block layout (little endian):
+//   magic u32 | version u8 | channels u8 | reserved u16 | count u32 |
+//   payload bytes u32 | first timestamp i64 | payload bits...
+
+#define GORILLA_MAGIC 0x31524F47U // "GOR1"
+#define GORILLA_VERSION 1
+
+#define GORILLA_MAX_CHANNELS 4
+#define GORILLA_BLOCK_SAMPLES 4096
+#define GORILLA_BLOCK_BYTES 16384
+#define GORILLA_HEADER_BYTES 24
+
+struct gorilla_encoder {
+    uint8_t buf[GORILLA_BLOCK_BYTES];
+    uint64_t acc; // pending bits, right aligned
+    uint32_t acc_bits;
+    uint32_t len; // bytes flushed to buf, header included
+    uint32_t count;
+    int channels;
+    int64_t t0;
+    int64_t last_ts;
+    int64_t last_delta;
+    uint32_t last_value[GORILLA_MAX_CHANNELS];
+    uint8_t lead[GORILLA_MAX_CHANNELS];
+    uint8_t trail[GORILLA_MAX_CHANNELS];
+};
+
+struct gorilla_block_info {
+    int channels;
+    uint32_t count;
+    size_t size; // header + payload
+    int64_t t0;
+};
+
+void gorilla_encoder_init(struct gorilla_encoder *enc, int channels);
+bool gorilla_encode(struct gorilla_encoder *enc, int64_t ts_ms, const float *values);
+size_t gorilla_finish(struct gorilla_encoder *enc, const uint8_t **block);
+
+int gorilla_block_info(const uint8_t *block, size_t len, struct gorilla_block_info *info);
+int gorilla_decode(const uint8_t *block, size_t len, int64_t *ts, float *values, uint32_t max);
+
+#endif
@@ -0,0 +1,74 @@
+#ifndef HAL_H
+#define HAL_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Hardware access used by the controller: GPIO (heater and fan), the I2C
+// LCD, the UART to the Arduino (TI and potentiometer TR) and the I2C bus
+// of the BME280 (TE). Two backends:
+//
+//   real  bcm2835, wiringPi, /dev/serial0 and /dev/i2c-1 (built with HAL_REAL)
+//   sim   the plant model of plant.c; runs on any Linux machine
+//
+// hal points to the active backend; hal_select switches it before any
+// call is made.
+
+// Heater (resistor) and fan outputs, active low
+#define HAL_HEATER_PIN 23 // BCM 23, P1-16
+#define HAL_FAN_PIN 24    // BCM 24, P1-18
+
+#define HAL_LCD_COLS 16
+
+// Bus device handed to the BME280 driver as intf_ptr
+struct hal_i2c_dev {
+    int fd;
+    uint8_t addr;
+};
+
+struct hal_gpio {
+    int (*init)(void);
+    void (*set_output)(uint8_t pin);
+    // Pins in mask take the levels in value, in one register write
+    void (*write_mask)(uint32_t value, uint32_t mask);
+    void (*close)(void);
+};
+
+struct hal_lcd {
+    int (*init)(void);
+    void (*write_line)(int line, const char *text); // line 0 or 1
+};
+
+struct hal_uart {
+    int (*read_ti)(float *ti);
+    int (*read_tr)(float *tr);
+};
+
+// Signatures of the BME280 driver callbacks (bme280_defs.h)
+struct hal_i2c {
+    int (*open)(struct hal_i2c_dev *dev, const char *bus, uint8_t addr);
+    void (*close)(struct hal_i2c_dev *dev); // fd = -1 afterwards
+    int8_t (*read)(uint8_t reg, uint8_t *data, uint32_t len, void *intf_ptr);
+    int8_t (*write)(uint8_t reg, const uint8_t *data, uint32_t len, void *intf_ptr);
+    void (*delay_us)(uint32_t period, void *intf_ptr);
+};
+
+struct hal {
+    const char *name;
+    const struct hal_gpio *gpio;
+    const struct hal_lcd *lcd;
+    const struct hal_uart *uart;
+    const struct hal_i2c *i2c;
+};
+
+extern const struct hal *hal;
+
+#ifdef HAL_REAL
+extern const struct hal hal_real;
+#endif
+extern const struct hal hal_sim;
+
+// "real" or "sim"; -1 if the backend was not built
+int hal_select(const char *name);
+
+#endif
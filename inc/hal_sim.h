@@ -0,0 +1,29 @@
+#ifndef HAL_SIM_H
+#define HAL_SIM_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include <plant.h>
+
+// Simulation backend of hal.h
+
+#define HAL_SIM_DEFAULT_POTENTIOMETER 40.0f
+#define HAL_SIM_MAX_CHAMBERS 9 // the main one and up to ZONE_MAX zones
+
+// Model NULL keeps the defaults of plant.c; call before the first HAL access
+void hal_sim_configure(const struct plant_model *m, float potentiometer, uint64_t seed);
+// Extra chamber (zone) with the same model: its BME280 at addr on bus
+// measures the chamber, heated and cooled through the given pins
+int hal_sim_add_chamber(const char *bus, uint8_t addr, uint8_t heater_pin, uint8_t fan_pin);
+// TR returned by the UART from the next read on
+void hal_sim_set_potentiometer(float tr);
+// Called after every GPIO write, outside the HAL lock (NULL: none); the
+// latency benchmark timestamps the actuator edges here
+void hal_sim_set_write_hook(void (*hook)(uint32_t value, uint32_t mask));
+
+// True chamber and ambient temperatures (no measurement noise)
+bool hal_sim_temperatures(float *chamber, float *ambient);
+void hal_sim_lcd_line(int line, char *out);
+
+#endif
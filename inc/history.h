@@ -0,0 +1,50 @@
+#ifndef HISTORY_H
+#define HISTORY_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Fixed-size memory-mapped ring holding the most recent samples.
+// Each slot is committed atomically: the slot is invalidated (seq = 0), the
+// payload and its CRC are written, and only then the new sequence number.
+// On open, slots with a bad CRC (torn writes) are ignored. A ring written
+// with another capacity is resized keeping its newest records.
+
+#define HISTORY_MAGIC 0x31545348454653ULL // "FSEHST1"
+#define HISTORY_VERSION 1
+
+#define HISTORY_DEFAULT_HOURS 24
+#define HISTORY_SAMPLES_PER_HOUR 7200 // one acquisition every 500ms
+
+#define HISTORY_READY_REFERENCE 0x01
+#define HISTORY_READY_HISTERESIS 0x02
+
+struct history_record {
+    uint64_t seq; // 0 = empty slot
+    int64_t ts_ms; // CLOCK_REALTIME, milliseconds
+    float reference_temp;
+    float intern_temp;
+    float extern_temp;
+    float histeresis_temp;
+    uint8_t state;
+    uint8_t input_mode;
+    uint8_t ready;
+    uint8_t reserved;
+    uint32_t crc;
+};
+
+typedef void (*history_cb)(const struct history_record *rec, void *ctx);
+
+int history_open(const char *path, uint32_t capacity);
+void history_close(void);
+
+int history_append(struct history_record *rec);
+void history_sync(void);
+
+bool history_last(struct history_record *rec);
+uint32_t history_count(void);
+uint32_t history_foreach(int64_t since_ms, history_cb cb, void *ctx);
+
+int64_t history_now_ms(void);
+
+#endif
@@ -0,0 +1,33 @@
+#ifndef I2CBUS_H
+#define I2CBUS_H
+
+#include <pthread.h>
+#include <stdint.h>
+
+// Turns on a shared I2C bus. The kernel serializes single transfers, but a
+// BME280 forced read is several of them; holders take the bus in arrival
+// order (ticket lock), so no zone starves the others. One bus per path,
+// looked up by i2c_bus_get.
+
+#define I2C_BUS_MAX 4
+#define I2C_BUS_PATH_MAX 64
+
+struct i2c_bus {
+    char path[I2C_BUS_PATH_MAX];
+    pthread_mutex_t lock;
+    pthread_cond_t turn;
+    uint64_t next;    // next ticket
+    uint64_t serving;
+    // Time spent waiting for the bus
+    uint64_t acquisitions;
+    int64_t wait_max_ns;
+    int64_t wait_sum_ns;
+};
+
+// NULL when I2C_BUS_MAX paths are in use
+struct i2c_bus *i2c_bus_get(const char *path);
+// Returns the time waited, ns
+int64_t i2c_bus_acquire(struct i2c_bus *bus);
+void i2c_bus_release(struct i2c_bus *bus);
+
+#endif
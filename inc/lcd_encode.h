@@ -0,0 +1,17 @@
+#ifndef LCD_ENCODE_H
+#define LCD_ENCODE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <i2clcd.h>
+
+// HD44780 behind a PCF8574 in 4-bit mode: every byte goes out as two
+// nibbles, each written plain, with ENABLE set and with ENABLE cleared.
+#define LCD_WRITES_PER_BYTE 6
+
+void lcd_encode_byte(int bits, int mode, uint8_t out[LCD_WRITES_PER_BYTE]);
+// Cursor command plus the characters of text; returns the number of bus writes
+size_t lcd_encode_line(int line, const char *text, uint8_t *out);
+
+#endif
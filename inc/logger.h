@@ -0,0 +1,85 @@
+#ifndef LOGGER_H
+#define LOGGER_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <time.h>
+
+#include <metrics.h>
+
+// Logging modes
+#define LOG_MODE_PERIODIC 0 // one row every LOG_PERIODIC_TICKS alarm ticks
+#define LOG_MODE_FULL_RATE 1 // one row per acquisition
+
+#define LOG_PERIODIC_TICKS 4
+
+// Bounded queue between producers and the writer thread. When it is full
+// new records are dropped (never blocking the producer) and counted.
+#define LOG_QUEUE_SIZE 1024
+#define LOG_BATCH_SIZE 64
+#define LOG_FLUSH_MS 1000
+
+#define LOG_REC_SAMPLE 0
+#define LOG_REC_EVENT 1
+#define LOG_REC_METRICS 2 // one finished setpoint step (metrics.csv)
+
+// Extra data/events file pairs (zones) written by the same thread;
+// stream 0 is data.csv and events.csv
+#define LOG_MAX_STREAMS 9 // the main pair and one per zone (ZONE_MAX)
+
+struct log_record {
+    int type;
+    int stream;
+    struct timespec ts;
+    union {
+        // LOG_REC_SAMPLE
+        struct {
+            float reference_temp;
+            float intern_temp;
+            float extern_temp;
+        };
+        // LOG_REC_EVENT
+        struct {
+            int state;
+            int resistor;
+            int fan;
+        };
+        // LOG_REC_METRICS
+        struct {
+            int mode;
+            int shadow; // 0 = active controller
+            struct metrics_report metrics;
+        };
+    };
+};
+
+struct log_stats {
+    uint64_t samples_written;
+    uint64_t events_written;
+    uint64_t metrics_written;
+    uint64_t samples_dropped;
+    uint64_t events_dropped;
+    uint64_t batches;
+};
+
+// compressed_path and metrics_path are optional (NULL)
+int logger_start(const char *data_path, const char *events_path, const char *compressed_path, const char *metrics_path);
+void logger_stop(void);
+
+bool logger_push_sample(float reference_temp, float intern_temp, float extern_temp);
+bool logger_push_event(int state, int resistor, int fan);
+bool logger_push_metrics(int mode, int shadow, const struct metrics_report *report);
+
+// Opens another data/events pair, after logger_start; returns its stream
+// number, -1 if the files can not be opened or all streams are taken
+int logger_add_stream(const char *data_path, const char *events_path);
+bool logger_push_stream_sample(int stream, float reference_temp, float intern_temp, float extern_temp);
+bool logger_push_stream_event(int stream, int state, int resistor, int fan);
+
+void logger_get_stats(struct log_stats *stats);
+
+// Formats one CSV row (newline included) into buf; returns the bytes written
+size_t logger_format_record(char *buf, size_t len, const struct log_record *rec);
+
+#endif
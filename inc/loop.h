@@ -0,0 +1,70 @@
+#ifndef LOOP_H
+#define LOOP_H
+
+#include <stdbool.h>
+#include <signal.h>
+#include <semaphore.h>
+
+#include <bme280_defs.h>
+#include <filter.h>
+#include <plant.h>
+#include <sample.h>
+
+// Acquisition and control loops of the main chamber. The program runs them
+// as threads; the latency benchmark runs the same threads on the simulated
+// HAL and the simulator calls one pass of each on the virtual clock.
+//
+// watchSensors waits on hold_sensors (the 500 ms alarm in main.c) and, while
+// running, reads TE from the BME280 and TR and TI from the UART, filters
+// them, publishes the sample and feeds the logs, history and tiers.
+// handleGPIO runs the control law on every sample or setpoint change.
+
+#define LOOP_I2C_PATH "/dev/i2c-1"
+
+// Setpoint and latest readings, shared with the UI, LCD and log threads
+extern bool running;
+extern int input_mode;
+extern int state;
+extern int log_mode;
+extern float extern_temp;
+extern float intern_temp;
+extern float reference_temp;
+extern bool reference_temp_ready;
+extern float histeresis_temp;
+extern bool histeresis_temp_ready;
+// Before the input filters; the values above are filtered
+extern float intern_raw;
+extern float reference_raw;
+extern struct filter ti_filter;
+extern struct filter tr_filter;
+extern struct plant_model thermal_model; // TI Kalman prediction
+
+extern struct bme280_dev dev;
+extern sem_t hold_sensors;
+
+// SIGUSR1 / SIGUSR2, handled by the control thread
+extern volatile sig_atomic_t toggle_requested;
+extern volatile sig_atomic_t swap_requested;
+// Both threads return once this is set and they are woken
+extern volatile sig_atomic_t stopping;
+
+// Called by watchSensors when the BME280 read fails; it must not return
+extern void (*loop_sensor_failed)(int8_t rslt);
+
+// TE sensor on LOOP_I2C_PATH through the HAL: 0, -1 bus not opened, -2 no
+// answer, -3 driver init failed (*rslt holds its code)
+int loop_sensor_open(int8_t *rslt);
+
+// One acquisition (nothing while not running); BME280_OK or its error
+int8_t loop_acquire(void);
+// One control step for a sample_wait wake-up; returns the state
+int loop_control(int wake, const struct sample *s);
+
+void *watchSensors(void *args);
+void *handleGPIO(void *args);
+
+// Hysteresis -> PID -> Smith -> hysteresis
+void toggleControl(void);
+void saveHistory(void);
+
+#endif
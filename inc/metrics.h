@@ -0,0 +1,89 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Control quality, updated incrementally from the sample stream and the
+// actuator outputs. Errors are integrated over each interval with the
+// value at its end. A setpoint step (or an explicit split) closes the
+// current period and opens a new one; totals run since metrics_init.
+//
+// A step counts as settled once the temperature has stayed within the
+// band around the reference for METRICS_SETTLE_HOLD_MS.
+
+#define METRICS_SETTLE_HOLD_MS (600 * 1000)
+#define METRICS_MIN_BAND 0.1f // oC, band used when the hysteresis is smaller
+// Reference changes up to this are noise (potentiometer) and stay in the
+// current step; the error always uses the current reference
+#define METRICS_REFERENCE_EPS 0.25f
+
+struct metrics_input {
+    int64_t t_ms;
+    float reference;
+    float temp;
+    float band;   // half width of the tolerance band, oC
+    float heater; // average output level since the previous input, 0..1
+    float fan;
+    uint32_t heater_transitions; // output changes since the previous input
+    uint32_t fan_transitions;
+};
+
+struct metrics_totals {
+    double duration_s;
+    double iae;       // oC.s
+    double ise;       // oC2.s
+    double itae;      // oC.s2, time from the start of each step
+    double in_band_s;
+    double heater_s;  // output on time (duty weighted)
+    double fan_s;
+    uint64_t heater_transitions;
+    uint64_t fan_transitions;
+};
+
+struct metrics_step {
+    int64_t start_ms;
+    int64_t end_ms;      // last update
+    float from;          // temperature when the step began
+    float reference;
+    float overshoot;     // oC beyond the reference, in the step direction
+    int64_t last_out_ms; // last time outside the band, -1 = never
+    struct metrics_totals acc;
+};
+
+struct metrics {
+    bool started;
+    bool split;
+    float last_temp;
+    struct metrics_step step;
+    struct metrics_totals total;
+};
+
+// What a closed (or current) step is reported as
+struct metrics_report {
+    float reference;
+    float from;
+    float duration_s;
+    float overshoot;
+    float settling_s;    // -1 while not settled
+    float iae;
+    float ise;
+    float in_band;       // fraction of the time
+    float switches_per_hour;
+    float heater_duty;   // fraction of the time
+    float fan_duty;
+};
+
+void metrics_init(struct metrics *m);
+// Returns true when the update closed a step, copied to *closed
+bool metrics_update(struct metrics *m, const struct metrics_input *in, struct metrics_step *closed);
+// The next update starts a new step even with the same reference
+void metrics_split(struct metrics *m);
+// Closes the current step (control stopped); false if none was open
+bool metrics_stop(struct metrics *m, struct metrics_step *closed);
+
+float metrics_settling_s(const struct metrics_step *s);
+void metrics_report(const struct metrics_step *s, struct metrics_report *out);
+void metrics_report_totals(const struct metrics_totals *t, struct metrics_report *out);
+
+#endif
@@ -0,0 +1,34 @@
+#ifndef PID_H
+#define PID_H
+
+#include <stdbool.h>
+
+// Parallel PID: u = kp*e + ki*integral(e) + kd*de/dt, with the derivative
+// taken on the measurement and low-pass filtered (time constant tf), and
+// the integral clamped when the output saturates (anti-windup).
+
+#define PID_DEFAULT_KP 0.20f
+#define PID_DEFAULT_KI 0.002f
+#define PID_DEFAULT_KD 2.0f
+#define PID_DEFAULT_TF 5.0f
+#define PID_DEFAULT_PERIOD_MS 1000
+
+struct pid {
+    float kp;
+    float ki; // 1/s
+    float kd; // s
+    float tf; // derivative filter time constant, s
+    float out_min;
+    float out_max;
+
+    float integral;
+    float derivative;
+    float prev_measurement;
+    bool primed;
+};
+
+void pid_init(struct pid *pid, float kp, float ki, float kd, float tf, float out_min, float out_max);
+void pid_reset(struct pid *pid);
+float pid_update(struct pid *pid, float setpoint, float measurement, float dt);
+
+#endif
@@ -0,0 +1,58 @@
+#ifndef PLANT_H
+#define PLANT_H
+
+#include <stdint.h>
+
+// First-order-plus-dead-time thermal model of the chamber:
+//
+//   tau * dT/dt = -(T - Ta(t)) + Kh * h(t - theta) - Kf * f(t - theta)
+//
+// h and f are the heater and fan inputs (0..1), Ta a daily sinusoid around
+// the ambient temperature. Model files use the configuration format:
+//
+//   tau_s = 600
+//   atraso_s = 20
+//   ganho_resistor = 40
+//   ganho_ventoinha = 15
+//   ambiente = 25
+//   ambiente_amplitude = 2
+//   ruido = 0.05
+//   temperatura_inicial = 25
+
+#define PLANT_DAY_S 86400.0
+
+struct plant_model {
+    float tau_s;
+    float dead_s;
+    float gain_heater; // oC above ambient with the heater always on
+    float gain_fan;    // oC below ambient with the fan always on
+    float ambient;
+    float ambient_amplitude;
+    float noise;       // TI measurement noise, standard deviation
+    float initial;
+};
+
+struct plant {
+    struct plant_model m;
+    float step_s;
+    double t_s;
+    double temp;
+    // Inputs delayed by the dead time
+    float *heater_hist;
+    float *fan_hist;
+    int hist_len;
+    int hist_pos;
+    uint64_t rng;
+};
+
+void plant_model_defaults(struct plant_model *m);
+int plant_model_load(const char *path, struct plant_model *m);
+int plant_model_save(const char *path, const struct plant_model *m, const char *comment);
+
+int plant_init(struct plant *p, const struct plant_model *m, float step_s, uint64_t seed);
+void plant_free(struct plant *p);
+void plant_step(struct plant *p, float heater, float fan);
+float plant_ambient(const struct plant *p);
+float plant_measure(struct plant *p);
+
+#endif
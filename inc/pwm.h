@@ -0,0 +1,46 @@
+#ifndef PWM_H
+#define PWM_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Software PWM for the heater and fan outputs, written through the
+// actuator layer. Pulses and gaps shorter than the PWM dwell times are
+// merged into the next periods, keeping the mean duty. One thread
+// schedules the edges of both outputs with absolute CLOCK_MONOTONIC
+// deadlines, so timing errors do not accumulate; the lateness of every
+// edge is measured. On the virtual clock (vclock.h) there is no thread:
+// pwm_advance moves the clock and writes the edges due on the way.
+//
+// The heater and fan sit on BCM 23/24 (P1-16/P1-18), which have no hardware
+// PWM channel, so the bcm2835 PWM peripheral can not drive them.
+
+// The chamber time constant is ~600 s: with a 50 s window the simulated
+// steady-state error stays near 0.2 oC at about 2 switches per minute
+#define PWM_DEFAULT_PERIOD_MS 50000
+#define PWM_DEFAULT_MIN_ON_MS 5000
+#define PWM_DEFAULT_MIN_OFF_MS 5000
+#define PWM_STEPS 100 // duty resolution
+#define PWM_RT_PRIORITY 50
+
+struct pwm_stats {
+    float heater_duty;
+    float fan_duty;
+    uint64_t periods;
+    int64_t last_jitter_us;
+    int64_t max_jitter_us;
+};
+
+// Dwell times below 0 are 0
+int pwm_start(int period_ms, int min_on_ms, int min_off_ms);
+void pwm_stop(void);
+bool pwm_running(void);
+
+void pwm_set(float heater_duty, float fan_duty);
+void pwm_get_stats(struct pwm_stats *stats);
+
+// Virtual clock only: advances it by ns, stopping at every PWM edge. Also
+// just advances the clock while the PWM is stopped
+void pwm_advance(int64_t ns);
+
+#endif
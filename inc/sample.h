@@ -0,0 +1,44 @@
+#ifndef SAMPLE_H
+#define SAMPLE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Latest acquisition, published by the data plane. Readers take a copy;
+// the UI is woken through an eventfd and the control loop through a
+// condition variable, which setpoint changes signal as well.
+
+struct sample {
+    uint64_t seq; // 0 = nothing published yet
+    int64_t ts_ms; // CLOCK_REALTIME
+    int64_t sensed_ns; // CLOCK_MONOTONIC, when TI was read
+    float reference_temp;
+    float intern_temp;
+    float extern_temp;
+    // Before the input filters
+    float reference_raw;
+    float intern_raw;
+};
+
+// What a waiter has already seen
+struct sample_cursor {
+    uint64_t seq;
+    uint64_t setpoint_gen;
+};
+
+#define SAMPLE_WAKE_NEW 1
+#define SAMPLE_WAKE_SETPOINT 2
+
+int sample_init(bool with_eventfd);
+int sample_eventfd(void);
+void sample_drain_eventfd(void);
+int64_t sample_monotonic_ns(void);
+
+void sample_publish(struct sample *s);
+bool sample_latest(struct sample *s);
+
+void sample_setpoint_changed(void);
+// Returns SAMPLE_WAKE_* flags, 0 on timeout
+int sample_wait(struct sample_cursor *cur, struct sample *s, int timeout_ms);
+
+#endif
@@ -0,0 +1,18 @@
+#ifndef STATE_H
+#define STATE_H
+
+// Reference temperature sources
+#define KEYBOARD_INPUT 0
+#define POTENTIOMETER_INPUT 1
+
+// Control states
+#define ST_STAND_BY 0
+#define ST_WARMING_UP 1
+#define ST_COOLING_DOWN 2
+
+// Control laws
+#define CONTROL_HYSTERESIS 0
+#define CONTROL_PID 1
+#define CONTROL_SMITH 2
+
+#endif
@@ -0,0 +1,75 @@
+#ifndef TIERS_H
+#define TIERS_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Round-robin store of rolling aggregates at several resolutions.
+// Every tier is a fixed-size ring of buckets that is updated in place as
+// samples arrive; when a ring is full the oldest bucket is overwritten.
+
+#define TIERS_MAGIC 0x3152454954455346ULL // "FSETIER1"
+#define TIERS_VERSION 1
+
+#define TIER_RAW 0
+#define TIER_1S 1
+#define TIER_1MIN 2
+#define TIER_1H 3
+#define TIER_COUNT 4
+
+// Resolution (ms, 0 = one bucket per sample) and retention (buckets)
+#define TIER_RAW_RESOLUTION 0
+#define TIER_RAW_CAPACITY 7200 // 1h at 2 samples/s
+#define TIER_1S_RESOLUTION 1000
+#define TIER_1S_CAPACITY 21600 // 6h
+#define TIER_1MIN_RESOLUTION 60000
+#define TIER_1MIN_CAPACITY 20160 // 14 days
+#define TIER_1H_RESOLUTION 3600000
+#define TIER_1H_CAPACITY 8784 // 366 days
+
+#define TIER_CH_TI 0
+#define TIER_CH_TE 1
+#define TIER_CH_TR 2
+#define TIER_CHANNELS 3
+
+struct tier_channel {
+    float min;
+    float max;
+    float last;
+    float reserved;
+    double sum;
+};
+
+struct tier_bucket {
+    int64_t start_ms;
+    uint32_t count;
+    uint32_t reserved;
+    struct tier_channel ch[TIER_CHANNELS];
+};
+
+struct tier_result {
+    int tier;
+    int64_t first_ms;
+    int64_t last_ms;
+    uint64_t count;
+    float min;
+    float max;
+    float last;
+    double mean;
+};
+
+int tiers_open(const char *path);
+// For readers (tlquery): the file must exist with this layout; tiers_add
+// must not be called
+int tiers_open_readonly(const char *path);
+void tiers_close(void);
+
+void tiers_add(int64_t ts_ms, const float values[TIER_CHANNELS]);
+
+// Finest tier still holding from_ms; queries read only that tier, so the
+// range is covered at bucket granularity (whole buckets overlapping it)
+int tiers_select(int64_t from_ms);
+int tiers_query(int64_t from_ms, int64_t to_ms, int channel, struct tier_result *res);
+int64_t tiers_resolution_ms(int tier);
+
+#endif
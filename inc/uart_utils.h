@@ -1,3 +1,24 @@
+#ifndef UART_UTILS_H
+#define UART_UTILS_H
+
+#include <stdint.h>
+#include <sys/types.h>
+
+// Arduino protocol: command byte followed by the 4 last digits of the
+// student id; the answer is a little-endian float
+#define UART_CMD_TI 0xA1
+#define UART_CMD_TR 0xA2
+#define UART_REQUEST_SIZE 5
+
 int openUart();
+// One request per call: the port is opened, written, read after 200 ms and
+// closed again. 0 on success; -1 open, -2 write or -3 read failed; -4 when
+// the answer is not a whole float in -55..150 oC (short read, NaN or a
+// value no sensor of the kit gives). *TI / *TR are only written on success
 int getTI(float *TI);
-int getTR(float *TR);
\ No newline at end of file
+int getTR(float *TR);
+
+void uart_encode_request(uint8_t cmd, uint8_t out[UART_REQUEST_SIZE]);
+int uart_decode_temperature(const uint8_t *buf, ssize_t len, float *out);
+
+#endif
@@ -0,0 +1,61 @@
+#ifndef UI_H
+#define UI_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <ncurses.h>
+
+#include <logger.h>
+#include <control.h>
+#include <filter.h>
+#include <zone.h>
+
+// Snapshot of everything shown in the sensors window
+struct ui_model {
+    bool running;
+    int state;
+    int input_mode;
+    bool reference_temp_ready;
+    bool histeresis_temp_ready;
+    float reference_temp;
+    float histeresis_temp;
+    float intern_temp;
+    float extern_temp;
+    // Input filters; raw values are shown next to the filtered ones
+    bool filter_ti;
+    bool filter_tr;
+    float reference_raw;
+    float intern_raw;
+    struct filter_stats ti_filter;
+    struct filter_stats tr_filter;
+    int log_mode;
+    struct log_stats log;
+    struct control_status control;
+    int zones;
+    struct zone_status zone[ZONE_MAX];
+};
+
+// Non-blocking line editor for numeric input
+#define UI_INPUT_MAX 16
+
+#define UI_INPUT_EDITING 0
+#define UI_INPUT_DONE 1
+#define UI_INPUT_CANCELLED 2
+
+struct ui_input {
+    bool active;
+    bool dirty;
+    int target; // command that opened the editor
+    const char *prompt;
+    char buf[UI_INPUT_MAX + 1];
+    int len;
+};
+
+void ui_init_sensors(WINDOW *sensorsWindow);
+void ui_render_sensors(WINDOW *sensorsWindow, const struct ui_model *model);
+
+void ui_input_begin(struct ui_input *in, int target, const char *prompt);
+int ui_input_key(struct ui_input *in, int ch);
+void ui_render_input(WINDOW *inputWindow, struct ui_input *in);
+
+#endif
@@ -0,0 +1,18 @@
+#ifndef VCLOCK_H
+#define VCLOCK_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Monotonic time for the control code. Normally CLOCK_MONOTONIC; the plant
+// simulator switches it to a virtual clock that only moves when advanced,
+// so the controller runs faster than real time.
+
+int64_t vclock_now_ns(void);
+int64_t vclock_now_ms(void);
+
+void vclock_enable_virtual(int64_t start_ns);
+void vclock_advance(int64_t ns);
+bool vclock_is_virtual(void);
+
+#endif
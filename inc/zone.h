@@ -0,0 +1,84 @@
+#ifndef ZONE_H
+#define ZONE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include <control.h>
+#include <metrics.h>
+
+// Extra chambers controlled by the same process. A zone has its own
+// sensor (a BME280 inside the chamber, by bus and address), reference
+// (fixed, or the TR of the main chamber), control law (controller.h, with
+// the gains and model of the main configuration), heater/fan pin pair and
+// log files (<nome>_data.csv and <nome>_events.csv, in the data.csv and
+// events.csv formats). TE is the one measured by the main BME280.
+//
+// Each zone runs in its own thread: one sensor read and control update per
+// period_ms, and the outputs every ZONE_TICK_MS (software PWM for the pwm
+// laws). Zones sharing a bus take turns on it (i2cbus.h) and release it
+// during the conversion. Log rows go through the logger queue, one stream
+// per zone, so a zone thread never waits on the disk. The main chamber
+// (UART, LCD, UI, history) is not a zone and keeps its own loop.
+
+#define ZONE_MAX 8
+#define ZONE_NAME_MAX 16
+#define ZONE_DEFAULT_BUS "/dev/i2c-1"
+#define ZONE_DEFAULT_PERIOD_MS 1000
+#define ZONE_DEFAULT_PWM_PERIOD_MS 10000
+#define ZONE_TICK_MS 100
+// Consecutive failed reads after which the outputs are turned off
+#define ZONE_MAX_READ_ERRORS 5
+
+// zones_start errors
+#define ZONE_E_PINS 1   // pins of the main chamber or of another zone
+#define ZONE_E_SENSOR 2 // address taken, bus not found or BME280 init failed
+#define ZONE_E_LOG 3
+#define ZONE_E_THREAD 4
+
+struct zone_config {
+    char name[ZONE_NAME_MAX];
+    char bus[64];
+    uint8_t addr;
+    uint8_t heater_pin;
+    uint8_t fan_pin;
+    bool follow_reference; // TR of the main chamber
+    float reference;
+    float histeresis;
+    int controller; // CONTROL_*
+    int period_ms;
+    int pwm_period_ms;
+};
+
+struct zone_status {
+    char name[ZONE_NAME_MAX];
+    bool valid; // a read succeeded
+    float intern_temp;
+    float reference_temp;
+    float heater; // demand, 0..1
+    float fan;
+    int state;
+    int controller;
+    uint64_t reads;
+    uint64_t read_errors;
+    int64_t bus_wait_max_us;
+    int64_t update_max_us; // read, control and log of one period
+    struct metrics_report metrics_total;
+};
+
+// Opens the sensors and logs and starts one thread per zone. On failure
+// nothing is left running; returns the ZONE_E_* code and *failed gets the
+// index of the zone
+int zones_start(const struct zone_config *zones, int count, const struct control_config *control, int *failed);
+// Outputs off, threads joined, sensors closed; the logs are closed by
+// logger_stop
+void zones_stop(void);
+
+// Shared inputs, from the main sensors loop
+void zones_set_ambient(float extern_temp);
+void zones_set_reference(float reference_temp);
+
+int zones_count(void);
+void zones_get_status(int index, struct zone_status *status);
+
+#endif
@@ -0,0 +1,134 @@
+#include <pthread.h>
+
+#include <actuator.h>
+#include <hal.h>
+#include <vclock.h>
+#include <state.h>
+#include <logger.h>
+
+static pthread_mutex_t actuator_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static uint8_t pins[ACTUATOR_OUTPUTS];
+static int64_t min_on_ms, min_off_ms;
+static int state = ST_STAND_BY;
+
+static bool on[ACTUATOR_OUTPUTS];
+static int64_t changed_ms[ACTUATOR_OUTPUTS]; // -1 = never changed
+static int64_t start_ms;
+static struct actuator_stats stats;
+
+// Both outputs in one write_mask call. On the Pi that is GPSET and then
+// GPCLR: with active low pins the outputs going off switch first and the
+// ones going on a moment later, so the brief intermediate state has both
+// off, never both on
+static void writeOutputs(void){
+    uint32_t mask = (1u << pins[ACTUATOR_HEATER]) | (1u << pins[ACTUATOR_FAN]);
+    uint32_t value = 0;
+    for(int i = 0; i < ACTUATOR_OUTPUTS; i++){
+        if(!on[i]){
+            value |= 1u << pins[i]; // active low
+        }
+    }
+    hal->gpio->write_mask(value, mask);
+    stats.writes++;
+}
+
+static void logEvent(void){
+    // Levels as in events.csv: 0 = ligado, 1 = desligado
+    logger_push_event(state, on[ACTUATOR_HEATER] ? 0 : 1, on[ACTUATOR_FAN] ? 0 : 1);
+}
+
+int actuator_init(uint8_t heater_pin, uint8_t fan_pin, int min_on, int min_off){
+    pthread_mutex_lock(&actuator_lock);
+    pins[ACTUATOR_HEATER] = heater_pin;
+    pins[ACTUATOR_FAN] = fan_pin;
+    min_on_ms = min_on > 0 ? min_on : 0;
+    min_off_ms = min_off > 0 ? min_off : 0;
+    hal->gpio->set_output(heater_pin);
+    hal->gpio->set_output(fan_pin);
+
+    start_ms = vclock_now_ms();
+    for(int i = 0; i < ACTUATOR_OUTPUTS; i++){
+        on[i] = false;
+        changed_ms[i] = -1;
+    }
+    writeOutputs();
+    pthread_mutex_unlock(&actuator_lock);
+    return 0;
+}
+
+void actuator_set_state(int new_state){
+    pthread_mutex_lock(&actuator_lock);
+    state = new_state;
+    pthread_mutex_unlock(&actuator_lock);
+}
+
+void actuator_set(bool heater_on, bool fan_on){
+    bool want[ACTUATOR_OUTPUTS] = { heater_on, fan_on };
+    pthread_mutex_lock(&actuator_lock);
+    stats.requests++;
+    int64_t now = vclock_now_ms();
+    bool changed = false;
+    // Turn-offs first, so a held heater keeps the fan off and vice versa
+    for(int pass = 0; pass < 2; pass++){
+        for(int i = 0; i < ACTUATOR_OUTPUTS; i++){
+            if(want[i] == on[i] || want[i] != (pass == 1)){
+                continue;
+            }
+            int other = 1 - i;
+            int64_t dwell = on[i] ? min_on_ms : min_off_ms;
+            if((changed_ms[i] >= 0 && now - changed_ms[i] < dwell) || (want[i] && on[other] && !want[other])){
+                stats.out[i].deferred++;
+                continue;
+            }
+            if(on[i]){
+                stats.out[i].on_ms += now - changed_ms[i];
+            }
+            on[i] = want[i];
+            changed_ms[i] = now;
+            stats.out[i].transitions++;
+            changed = true;
+        }
+    }
+    if(changed){
+        writeOutputs();
+        logEvent();
+    }
+    pthread_mutex_unlock(&actuator_lock);
+}
+
+void actuator_off(void){
+    pthread_mutex_lock(&actuator_lock);
+    int64_t now = vclock_now_ms();
+    bool changed = false;
+    for(int i = 0; i < ACTUATOR_OUTPUTS; i++){
+        if(on[i]){
+            stats.out[i].on_ms += now - changed_ms[i];
+            on[i] = false;
+            changed_ms[i] = now;
+            stats.out[i].transitions++;
+            changed = true;
+        }
+    }
+    // Written unconditionally, shutdown does not trust the cache
+    writeOutputs();
+    if(changed){
+        logEvent();
+    }
+    pthread_mutex_unlock(&actuator_lock);
+}
+
+void actuator_get_stats(struct actuator_stats *out){
+    pthread_mutex_lock(&actuator_lock);
+    int64_t now = vclock_now_ms();
+    int64_t elapsed = now - start_ms;
+    *out = stats;
+    for(int i = 0; i < ACTUATOR_OUTPUTS; i++){
+        out->out[i].on = on[i];
+        if(on[i]){
+            out->out[i].on_ms += now - changed_ms[i];
+        }
+        out->out[i].duty = elapsed > 0 ? (float) out->out[i].on_ms / elapsed : 0;
+    }
+    pthread_mutex_unlock(&actuator_lock);
+}
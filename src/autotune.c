@@ -0,0 +1,130 @@
+#include <stdio.h>
+#include <math.h>
+
+#include <autotune.h>
+
+void autotune_start(struct autotune *at, float setpoint, float eps, int cycles, int rule){
+    at->status = AUTOTUNE_RUNNING;
+    at->rule = rule;
+    at->cycles = cycles > 0 ? cycles : AUTOTUNE_DEFAULT_CYCLES;
+    at->setpoint = setpoint;
+    at->eps = eps > AUTOTUNE_MIN_HYSTERESIS ? eps : AUTOTUNE_MIN_HYSTERESIS;
+    at->relay = 0;
+    at->last_switch_ms = -1;
+    at->last_rise_ms = -1;
+    at->completed = 0;
+    at->sum_period_s = 0;
+    at->sum_max = 0;
+    at->sum_min = 0;
+}
+
+const char *autotune_rule_name(int rule){
+    return rule == AUTOTUNE_RULE_ZN ? "ZN" : "TL";
+}
+
+void autotune_gains(int rule, float ku, float pu, struct autotune_result *res){
+    float kp, ti, td, periods;
+    if(rule == AUTOTUNE_RULE_ZN){
+        kp = 0.6f * ku;
+        ti = pu / 2;
+        td = pu / 8;
+        periods = AUTOTUNE_SETTLING_PERIODS_ZN;
+    }else{
+        kp = ku / 2.2f;
+        ti = 2.2f * pu;
+        td = pu / 6.3f;
+        periods = AUTOTUNE_SETTLING_PERIODS_TL;
+    }
+    res->ku = ku;
+    res->period_s = pu;
+    res->kp = kp;
+    res->ki = kp / ti;
+    res->kd = kp * td;
+    res->settling_s = periods * pu;
+}
+
+static void finish(struct autotune *at){
+    float pu = at->sum_period_s / at->cycles;
+    float a = (at->sum_max - at->sum_min) / (2.0 * at->cycles);
+    at->relay = 0;
+    if(a <= at->eps || pu <= 0){
+        // No limit cycle beyond the relay band
+        at->status = AUTOTUNE_FAILED;
+        return;
+    }
+    float ku = 4 * AUTOTUNE_RELAY_AMPLITUDE / (M_PI * sqrtf(a * a - at->eps * at->eps));
+    at->result.amplitude = a;
+    autotune_gains(at->rule, ku, pu, &at->result);
+    at->status = AUTOTUNE_DONE;
+}
+
+// One sample of the experiment; returns the relay output to apply
+float autotune_step(struct autotune *at, int64_t now_ms, float measurement){
+    if(at->status != AUTOTUNE_RUNNING){
+        return 0;
+    }
+
+    if(at->last_switch_ms < 0){
+        at->relay = measurement < at->setpoint ? AUTOTUNE_RELAY_AMPLITUDE : -AUTOTUNE_RELAY_AMPLITUDE;
+        at->last_switch_ms = now_ms;
+        at->peak_max = at->peak_min = measurement;
+        return at->relay;
+    }
+
+    if(measurement > at->peak_max){
+        at->peak_max = measurement;
+    }
+    if(measurement < at->peak_min){
+        at->peak_min = measurement;
+    }
+
+    if(now_ms - at->last_switch_ms > AUTOTUNE_MAX_HALF_CYCLE_MS){
+        // The relay can not move the temperature across the band
+        at->relay = 0;
+        at->status = AUTOTUNE_FAILED;
+        return 0;
+    }
+
+    if(at->relay > 0 && measurement > at->setpoint + at->eps){
+        at->relay = -AUTOTUNE_RELAY_AMPLITUDE;
+        at->last_switch_ms = now_ms;
+        // The peak comes after the switch, while the plant coasts
+        at->peak_max = measurement;
+    }else if(at->relay < 0 && measurement < at->setpoint - at->eps){
+        at->relay = AUTOTUNE_RELAY_AMPLITUDE;
+        at->last_switch_ms = now_ms;
+        if(at->last_rise_ms >= 0){
+            // A full cycle (rise to rise) ended; the first one is a transient
+            if(at->completed > 0){
+                at->sum_period_s += (now_ms - at->last_rise_ms) / 1000.0;
+                at->sum_max += at->peak_max;
+                at->sum_min += at->peak_min;
+            }
+            at->completed++;
+            if(at->completed > at->cycles){
+                finish(at);
+                return at->relay;
+            }
+        }
+        at->last_rise_ms = now_ms;
+        at->peak_min = measurement;
+    }
+    return at->relay;
+}
+
+// Gains in the configuration file format, loaded at startup
+int autotune_save(const char *path, const struct autotune *at){
+    FILE *arq = fopen(path, "w");
+    if(!arq){
+        return -1;
+    }
+    const struct autotune_result *r = &at->result;
+    fprintf(arq, "# Auto-sintonia por relé (%s): amplitude %.3f oC, período %.1f s, Ku %.4f\n",
+        autotune_rule_name(at->rule), r->amplitude, r->period_s, r->ku);
+    fprintf(arq, "# Tempo de acomodação esperado: %.0f s\n", r->settling_s);
+    fprintf(arq, "kp = %.6f\n", r->kp);
+    fprintf(arq, "ki = %.6f\n", r->ki);
+    fprintf(arq, "kd = %.6f\n", r->kd);
+    int res = fclose(arq);
+    return res ? -1 : 0;
+}
@@ -92,6 +92,39 @@ static int8_t write_power_mode(uint8_t sensor_mode, struct bme280_dev *dev);
  */
 static int8_t null_ptr_check(const struct bme280_dev *dev);
 
+/*!
+ * @brief This internal API reads the given registers like bme280_get_regs,
+ * without storing the interface result in the device structure.
+ *
+ * @param[in] reg_addr  : Register address from where the data to be read
+ * @param[out] reg_data : Pointer to data buffer to store the read data.
+ * @param[in] len       : No of bytes of data to be read.
+ * @param[in] dev       : Structure instance of bme280_dev.
+ *
+ * @return Result of API execution status.
+ *
+ * @retval   0 -> Success.
+ * @retval < 0 -> Fail.
+ *
+ */
+static int8_t get_regs_r(uint8_t reg_addr, uint8_t *reg_data, uint16_t len, const struct bme280_dev *dev);
+
+/*!
+ * @brief This internal API writes one register like bme280_set_regs,
+ * without storing the interface result in the device structure.
+ *
+ * @param[in] reg_addr : Register address.
+ * @param[in] reg_data : Value to be written.
+ * @param[in] dev      : Structure instance of bme280_dev.
+ *
+ * @return Result of API execution status.
+ *
+ * @retval   0 -> Success.
+ * @retval < 0 -> Fail.
+ *
+ */
+static int8_t set_regs_r(uint8_t reg_addr, uint8_t reg_data, const struct bme280_dev *dev);
+
 /*!
  * @brief This internal API interleaves the register address between the
  * register data buffer for burst write operation.
@@ -154,7 +187,8 @@ static void parse_humidity_calib_data(const uint8_t *reg_data, struct bme280_dev
  *
  */
 static double compensate_pressure(const struct bme280_uncomp_data *uncomp_data,
-                                  const struct bme280_calib_data *calib_data);
+                                  const struct bme280_calib_data *calib_data,
+                                  int32_t t_fine);
 
 /*!
  * @brief This internal API is used to compensate the raw humidity data and
@@ -167,7 +201,8 @@ static double compensate_pressure(const struct bme280_uncomp_data *uncomp_data,
  *
  */
 static double compensate_humidity(const struct bme280_uncomp_data *uncomp_data,
-                                  const struct bme280_calib_data *calib_data);
+                                  const struct bme280_calib_data *calib_data,
+                                  int32_t t_fine);
 
 /*!
  * @brief This internal API is used to compensate the raw temperature data and
@@ -175,12 +210,15 @@ static double compensate_humidity(const struct bme280_uncomp_data *uncomp_data,
  *
  * @param[in] uncomp_data : Contains the uncompensated temperature data.
  * @param[in] calib_data  : Pointer to calibration data structure.
+ * @param[out] t_fine     : Fine temperature used by the pressure and humidity
+ * compensation.
  *
  * @return Compensated temperature data in double.
  *
  */
 static double compensate_temperature(const struct bme280_uncomp_data *uncomp_data,
-                                     struct bme280_calib_data *calib_data);
+                                     const struct bme280_calib_data *calib_data,
+                                     int32_t *t_fine);
 
 #else
 
@@ -190,12 +228,15 @@ static double compensate_temperature(const struct bme280_uncomp_data *uncomp_dat
  *
  * @param[in] uncomp_data : Contains the uncompensated temperature data.
  * @param[in] calib_data  : Pointer to calibration data structure.
+ * @param[out] t_fine     : Fine temperature used by the pressure and humidity
+ * compensation.
  *
  * @return Compensated temperature data in integer.
  *
  */
 static int32_t compensate_temperature(const struct bme280_uncomp_data *uncomp_data,
-                                      struct bme280_calib_data *calib_data);
+                                      const struct bme280_calib_data *calib_data,
+                                      int32_t *t_fine);
 
 /*!
  * @brief This internal API is used to compensate the raw pressure data and
@@ -208,7 +249,8 @@ static int32_t compensate_temperature(const struct bme280_uncomp_data *uncomp_da
  *
  */
 static uint32_t compensate_pressure(const struct bme280_uncomp_data *uncomp_data,
-                                    const struct bme280_calib_data *calib_data);
+                                    const struct bme280_calib_data *calib_data,
+                                    int32_t t_fine);
 
 /*!
  * @brief This internal API is used to compensate the raw humidity data and
@@ -221,7 +263,8 @@ static uint32_t compensate_pressure(const struct bme280_uncomp_data *uncomp_data
  *
  */
 static uint32_t compensate_humidity(const struct bme280_uncomp_data *uncomp_data,
-                                    const struct bme280_calib_data *calib_data);
+                                    const struct bme280_calib_data *calib_data,
+                                    int32_t t_fine);
 
 #endif
 
@@ -774,6 +817,68 @@ int8_t bme280_get_sensor_data(uint8_t sensor_comp, struct bme280_data *comp_data
     return rslt;
 }
 
+/*!
+ * @brief This API reads and compensates the sensor data without writing to
+ * the device structure.
+ */
+int8_t bme280_get_sensor_data_r(uint8_t sensor_comp, struct bme280_data *comp_data, const struct bme280_dev *dev)
+{
+    int8_t rslt;
+    uint8_t reg_data[BME280_P_T_H_DATA_LEN] = { 0 };
+    struct bme280_uncomp_data uncomp_data = { 0 };
+
+    /* Check for null pointer in the device structure*/
+    rslt = null_ptr_check(dev);
+
+    if ((rslt == BME280_OK) && (comp_data != NULL))
+    {
+        rslt = get_regs_r(BME280_DATA_ADDR, reg_data, BME280_P_T_H_DATA_LEN, dev);
+
+        if (rslt == BME280_OK)
+        {
+            bme280_parse_sensor_data(reg_data, &uncomp_data);
+            rslt = bme280_compensate_data_r(sensor_comp, &uncomp_data, comp_data, &dev->calib_data);
+        }
+    }
+    else
+    {
+        rslt = BME280_E_NULL_PTR;
+    }
+
+    return rslt;
+}
+
+/*!
+ * @brief This API starts a forced mode conversion with the caller's
+ * oversampling settings, without writing to the device structure.
+ */
+int8_t bme280_start_forced_r(const struct bme280_settings *settings, const struct bme280_dev *dev)
+{
+    int8_t rslt;
+    uint8_t reg_addr = BME280_CTRL_MEAS_ADDR;
+    uint8_t reg_data = 0;
+
+    /* Check for null pointer in the device structure*/
+    rslt = null_ptr_check(dev);
+
+    if ((rslt == BME280_OK) && (settings != NULL))
+    {
+        /* ctrl_meas holds the temperature and pressure oversampling and the
+         * mode: one write, no read-modify-write
+         */
+        fill_osr_temp_settings(&reg_data, settings);
+        fill_osr_press_settings(&reg_data, settings);
+        reg_data = BME280_SET_BITS_POS_0(reg_data, BME280_SENSOR_MODE, BME280_FORCED_MODE);
+        rslt = set_regs_r(reg_addr, reg_data, dev);
+    }
+    else
+    {
+        rslt = BME280_E_NULL_PTR;
+    }
+
+    return rslt;
+}
+
 /*!
  *  @brief This API is used to parse the pressure, temperature and
  *  humidity data and store it in the bme280_uncomp_data structure instance.
@@ -812,9 +917,24 @@ int8_t bme280_compensate_data(uint8_t sensor_comp,
                               const struct bme280_uncomp_data *uncomp_data,
                               struct bme280_data *comp_data,
                               struct bme280_calib_data *calib_data)
+{
+    return bme280_compensate_data_r(sensor_comp, uncomp_data, comp_data, calib_data);
+}
+
+/*!
+ * @brief This API compensates the pressure and/or temperature and/or humidity
+ * data without writing to the calibration data.
+ */
+int8_t bme280_compensate_data_r(uint8_t sensor_comp,
+                                const struct bme280_uncomp_data *uncomp_data,
+                                struct bme280_data *comp_data,
+                                const struct bme280_calib_data *calib_data)
 {
     int8_t rslt = BME280_OK;
 
+    /* Fine temperature, shared by the pressure and humidity compensation */
+    int32_t t_fine = 0;
+
     if ((uncomp_data != NULL) && (comp_data != NULL) && (calib_data != NULL))
     {
         /* Initialize to zero */
@@ -826,19 +946,19 @@ int8_t bme280_compensate_data(uint8_t sensor_comp,
         if (sensor_comp & (BME280_PRESS | BME280_TEMP | BME280_HUM))
         {
             /* Compensate the temperature data */
-            comp_data->temperature = compensate_temperature(uncomp_data, calib_data);
+            comp_data->temperature = compensate_temperature(uncomp_data, calib_data, &t_fine);
         }
 
         if (sensor_comp & BME280_PRESS)
         {
             /* Compensate the pressure data */
-            comp_data->pressure = compensate_pressure(uncomp_data, calib_data);
+            comp_data->pressure = compensate_pressure(uncomp_data, calib_data, t_fine);
         }
 
         if (sensor_comp & BME280_HUM)
         {
             /* Compensate the humidity data */
-            comp_data->humidity = compensate_humidity(uncomp_data, calib_data);
+            comp_data->humidity = compensate_humidity(uncomp_data, calib_data, t_fine);
         }
     }
     else
@@ -1143,7 +1263,9 @@ static int8_t reload_device_settings(const struct bme280_settings *settings, str
  * @brief This internal API is used to compensate the raw temperature data and
  * return the compensated temperature data in double data type.
  */
-static double compensate_temperature(const struct bme280_uncomp_data *uncomp_data, struct bme280_calib_data *calib_data)
+static double compensate_temperature(const struct bme280_uncomp_data *uncomp_data,
+                                     const struct bme280_calib_data *calib_data,
+                                     int32_t *t_fine)
 {
     double var1;
     double var2;
@@ -1155,7 +1277,7 @@ static double compensate_temperature(const struct bme280_uncomp_data *uncomp_dat
     var1 = var1 * ((double)calib_data->dig_t2);
     var2 = (((double)uncomp_data->temperature) / 131072.0 - ((double)calib_data->dig_t1) / 8192.0);
     var2 = (var2 * var2) * ((double)calib_data->dig_t3);
-    calib_data->t_fine = (int32_t)(var1 + var2);
+    *t_fine = (int32_t)(var1 + var2);
     temperature = (var1 + var2) / 5120.0;
 
     if (temperature < temperature_min)
@@ -1175,7 +1297,8 @@ static double compensate_temperature(const struct bme280_uncomp_data *uncomp_dat
  * return the compensated pressure data in double data type.
  */
 static double compensate_pressure(const struct bme280_uncomp_data *uncomp_data,
-                                  const struct bme280_calib_data *calib_data)
+                                  const struct bme280_calib_data *calib_data,
+                                  int32_t t_fine)
 {
     double var1;
     double var2;
@@ -1184,7 +1307,7 @@ static double compensate_pressure(const struct bme280_uncomp_data *uncomp_data,
     double pressure_min = 30000.0;
     double pressure_max = 110000.0;
 
-    var1 = ((double)calib_data->t_fine / 2.0) - 64000.0;
+    var1 = ((double)t_fine / 2.0) - 64000.0;
     var2 = var1 * var1 * ((double)calib_data->dig_p6) / 32768.0;
     var2 = var2 + var1 * ((double)calib_data->dig_p5) * 2.0;
     var2 = (var2 / 4.0) + (((double)calib_data->dig_p4) * 65536.0);
@@ -1223,7 +1346,8 @@ static double compensate_pressure(const struct bme280_uncomp_data *uncomp_data,
  * return the compensated humidity data in double data type.
  */
 static double compensate_humidity(const struct bme280_uncomp_data *uncomp_data,
-                                  const struct bme280_calib_data *calib_data)
+                                  const struct bme280_calib_data *calib_data,
+                                  int32_t t_fine)
 {
     double humidity;
     double humidity_min = 0.0;
@@ -1235,7 +1359,7 @@ static double compensate_humidity(const struct bme280_uncomp_data *uncomp_data,
     double var5;
     double var6;
 
-    var1 = ((double)calib_data->t_fine) - 76800.0;
+    var1 = ((double)t_fine) - 76800.0;
     var2 = (((double)calib_data->dig_h4) * 64.0 + (((double)calib_data->dig_h5) / 16384.0) * var1);
     var3 = uncomp_data->humidity - var2;
     var4 = ((double)calib_data->dig_h2) / 65536.0;
@@ -1263,7 +1387,8 @@ static double compensate_humidity(const struct bme280_uncomp_data *uncomp_data,
  * return the compensated temperature data in integer data type.
  */
 static int32_t compensate_temperature(const struct bme280_uncomp_data *uncomp_data,
-                                      struct bme280_calib_data *calib_data)
+                                      const struct bme280_calib_data *calib_data,
+                                      int32_t *t_fine)
 {
     int32_t var1;
     int32_t var2;
@@ -1275,8 +1400,8 @@ static int32_t compensate_temperature(const struct bme280_uncomp_data *uncomp_da
     var1 = (var1 * ((int32_t)calib_data->dig_t2)) / 2048;
     var2 = (int32_t)((uncomp_data->temperature / 16) - ((int32_t)calib_data->dig_t1));
     var2 = (((var2 * var2) / 4096) * ((int32_t)calib_data->dig_t3)) / 16384;
-    calib_data->t_fine = var1 + var2;
-    temperature = (calib_data->t_fine * 5 + 128) / 256;
+    *t_fine = var1 + var2;
+    temperature = (*t_fine * 5 + 128) / 256;
 
     if (temperature < temperature_min)
     {
@@ -1297,7 +1422,8 @@ static int32_t compensate_temperature(const struct bme280_uncomp_data *uncomp_da
  * accuracy.
  */
 static uint32_t compensate_pressure(const struct bme280_uncomp_data *uncomp_data,
-                                    const struct bme280_calib_data *calib_data)
+                                    const struct bme280_calib_data *calib_data,
+                                    int32_t t_fine)
 {
     int64_t var1;
     int64_t var2;
@@ -1307,7 +1433,7 @@ static uint32_t compensate_pressure(const struct bme280_uncomp_data *uncomp_data
     uint32_t pressure_min = 3000000;
     uint32_t pressure_max = 11000000;
 
-    var1 = ((int64_t)calib_data->t_fine) - 128000;
+    var1 = ((int64_t)t_fine) - 128000;
     var2 = var1 * var1 * (int64_t)calib_data->dig_p6;
     var2 = var2 + ((var1 * (int64_t)calib_data->dig_p5) * 131072);
     var2 = var2 + (((int64_t)calib_data->dig_p4) * 34359738368);
@@ -1348,7 +1474,8 @@ static uint32_t compensate_pressure(const struct bme280_uncomp_data *uncomp_data
  * return the compensated pressure data in integer data type.
  */
 static uint32_t compensate_pressure(const struct bme280_uncomp_data *uncomp_data,
-                                    const struct bme280_calib_data *calib_data)
+                                    const struct bme280_calib_data *calib_data,
+                                    int32_t t_fine)
 {
     int32_t var1;
     int32_t var2;
@@ -1359,7 +1486,7 @@ static uint32_t compensate_pressure(const struct bme280_uncomp_data *uncomp_data
     uint32_t pressure_min = 30000;
     uint32_t pressure_max = 110000;
 
-    var1 = (((int32_t)calib_data->t_fine) / 2) - (int32_t)64000;
+    var1 = (((int32_t)t_fine) / 2) - (int32_t)64000;
     var2 = (((var1 / 4) * (var1 / 4)) / 2048) * ((int32_t)calib_data->dig_p6);
     var2 = var2 + ((var1 * ((int32_t)calib_data->dig_p5)) * 2);
     var2 = (var2 / 4) + (((int32_t)calib_data->dig_p4) * 65536);
@@ -1410,7 +1537,8 @@ static uint32_t compensate_pressure(const struct bme280_uncomp_data *uncomp_data
  * return the compensated humidity data in integer data type.
  */
 static uint32_t compensate_humidity(const struct bme280_uncomp_data *uncomp_data,
-                                    const struct bme280_calib_data *calib_data)
+                                    const struct bme280_calib_data *calib_data,
+                                    int32_t t_fine)
 {
     int32_t var1;
     int32_t var2;
@@ -1420,7 +1548,7 @@ static uint32_t compensate_humidity(const struct bme280_uncomp_data *uncomp_data
     uint32_t humidity;
     uint32_t humidity_max = 102400;
 
-    var1 = calib_data->t_fine - ((int32_t)76800);
+    var1 = t_fine - ((int32_t)76800);
     var2 = (int32_t)(uncomp_data->humidity * 16384);
     var3 = (int32_t)(((int32_t)calib_data->dig_h4) * 1048576);
     var4 = ((int32_t)calib_data->dig_h5) * var1;
@@ -1586,4 +1714,47 @@ static int8_t null_ptr_check(const struct bme280_dev *dev)
     }
 
     return rslt;
-}
\ No newline at end of file
+}
+/*!
+ * @brief This internal API reads the given registers without storing the
+ * interface result in the device structure.
+ */
+static int8_t get_regs_r(uint8_t reg_addr, uint8_t *reg_data, uint16_t len, const struct bme280_dev *dev)
+{
+    int8_t rslt = BME280_OK;
+
+    /* If interface selected is SPI */
+    if (dev->intf != BME280_I2C_INTF)
+    {
+        reg_addr = reg_addr | 0x80;
+    }
+
+    if (dev->read(reg_addr, reg_data, len, dev->intf_ptr) != BME280_INTF_RET_SUCCESS)
+    {
+        rslt = BME280_E_COMM_FAIL;
+    }
+
+    return rslt;
+}
+
+/*!
+ * @brief This internal API writes one register without storing the
+ * interface result in the device structure.
+ */
+static int8_t set_regs_r(uint8_t reg_addr, uint8_t reg_data, const struct bme280_dev *dev)
+{
+    int8_t rslt = BME280_OK;
+
+    /* If interface selected is SPI */
+    if (dev->intf != BME280_I2C_INTF)
+    {
+        reg_addr = reg_addr & 0x7F;
+    }
+
+    if (dev->write(reg_addr, &reg_data, 1, dev->intf_ptr) != BME280_INTF_RET_SUCCESS)
+    {
+        rslt = BME280_E_COMM_FAIL;
+    }
+
+    return rslt;
+}
@@ -0,0 +1,183 @@
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include <chart.h>
+
+#define GLYPH_TI '#'
+#define GLYPH_TE '+'
+#define GLYPH_TR '-'
+#define GLYPH_BAND '.'
+#define GLYPH_CURSOR '|'
+
+struct chart_column {
+    int64_t bucket; // -1 = empty
+    float ti_min, ti_max;
+    float te_min, te_max;
+    float tr;
+    float histeresis;
+};
+
+static struct chart_column *columns = NULL;
+static int ncols = 0;
+static int first_col = 1; // window column of chart column 0
+static int top_row = 0; // legend row; the plot starts below it
+static int rows = 0;
+
+static int64_t current = -1; // bucket being filled
+static float lo = 0, hi = 0; // vertical scale
+static bool full_redraw = true;
+static bool scale_dirty = true;
+static int dirty_col = -1; // column to redraw
+
+int chart_init(WINDOW *w, int top, int bottom){
+    int width = getmaxx(w);
+    free(columns);
+    columns = NULL;
+    rows = bottom - top; // one row for the legend
+    ncols = width - 2;
+    first_col = 1;
+    top_row = top;
+    if(rows < CHART_MIN_ROWS || ncols < 2){
+        rows = 0;
+        return -1;
+    }
+    columns = malloc(ncols * sizeof(struct chart_column));
+    if(!columns){
+        rows = 0;
+        return -1;
+    }
+    for(int i = 0; i < ncols; i++){
+        columns[i].bucket = -1;
+    }
+    current = -1;
+    full_redraw = true;
+    scale_dirty = true;
+    return 0;
+}
+
+bool chart_enabled(void){
+    return rows > 0;
+}
+
+int64_t chart_span_ms(void){
+    return (int64_t) ncols * CHART_SECONDS_PER_COL * 1000;
+}
+
+static void fitScale(const struct chart_column *c){
+    float low = fminf(fminf(c->ti_min, c->te_min), c->tr - c->histeresis / 2);
+    float high = fmaxf(fmaxf(c->ti_max, c->te_max), c->tr + c->histeresis / 2);
+    if(lo == hi){
+        lo = floorf(low) - 1;
+        hi = ceilf(high) + 1;
+        scale_dirty = full_redraw = true;
+    }else if(low < lo || high > hi){
+        // Grow with a margin so the next rescale is far away
+        float margin = (hi - lo) / 4;
+        if(low < lo){
+            lo = floorf(low - margin);
+        }
+        if(high > hi){
+            hi = ceilf(high + margin);
+        }
+        scale_dirty = full_redraw = true;
+    }
+}
+
+void chart_add(int64_t ts_ms, float intern_temp, float extern_temp, float reference_temp, float histeresis_temp){
+    if(!chart_enabled()){
+        return;
+    }
+    int64_t bucket = ts_ms / (CHART_SECONDS_PER_COL * 1000);
+    if(bucket < current){
+        return;
+    }
+    struct chart_column *c = &columns[bucket % ncols];
+    if(bucket != current){
+        // Columns skipped by a gap are blanked
+        for(int64_t b = current + 1; current >= 0 && b < bucket && b <= current + ncols; b++){
+            columns[b % ncols].bucket = -1;
+        }
+        if(current >= 0 && bucket - current > 1){
+            full_redraw = true;
+        }
+        current = bucket;
+        c->bucket = bucket;
+        c->ti_min = c->ti_max = intern_temp;
+        c->te_min = c->te_max = extern_temp;
+    }else{
+        c->ti_min = fminf(c->ti_min, intern_temp);
+        c->ti_max = fmaxf(c->ti_max, intern_temp);
+        c->te_min = fminf(c->te_min, extern_temp);
+        c->te_max = fmaxf(c->te_max, extern_temp);
+    }
+    c->tr = reference_temp;
+    c->histeresis = histeresis_temp;
+    fitScale(c);
+    dirty_col = (int) (bucket % ncols);
+}
+
+static int rowOf(float v){
+    float pos = (v - lo) / (hi - lo) * (rows - 1);
+    int r = (int) lroundf(pos);
+    if(r < 0){
+        r = 0;
+    }else if(r > rows - 1){
+        r = rows - 1;
+    }
+    return top_row + rows - r; // plot rows follow the legend row
+}
+
+static void drawColumn(WINDOW *w, int i){
+    int x = first_col + i;
+    const struct chart_column *c = &columns[i];
+    for(int y = top_row + 1; y <= top_row + rows; y++){
+        mvwaddch(w, y, x, ' ');
+    }
+    if(c->bucket < 0 || c->bucket <= current - ncols){
+        return;
+    }
+    if(c->histeresis > 0){
+        mvwaddch(w, rowOf(c->tr - c->histeresis / 2), x, GLYPH_BAND);
+        mvwaddch(w, rowOf(c->tr + c->histeresis / 2), x, GLYPH_BAND);
+    }
+    mvwaddch(w, rowOf(c->tr), x, GLYPH_TR);
+    for(int y = rowOf(c->te_max); y <= rowOf(c->te_min); y++){
+        mvwaddch(w, y, x, GLYPH_TE);
+    }
+    for(int y = rowOf(c->ti_max); y <= rowOf(c->ti_min); y++){
+        mvwaddch(w, y, x, GLYPH_TI);
+    }
+}
+
+static void drawCursor(WINDOW *w, int i){
+    int x = first_col + i;
+    for(int y = top_row + 1; y <= top_row + rows; y++){
+        mvwaddch(w, y, x, GLYPH_CURSOR);
+    }
+}
+
+void chart_render(WINDOW *w){
+    if(!chart_enabled() || current < 0){
+        return;
+    }
+    if(scale_dirty){
+        wmove(w, top_row, first_col);
+        for(int i = 0; i < ncols; i++){
+            waddch(w, ' ');
+        }
+        mvwprintw(w, top_row, first_col, "TI %c  TE %c  TR %c  faixa %c   %d s/coluna   %.0f a %.0f oC",
+            GLYPH_TI, GLYPH_TE, GLYPH_TR, GLYPH_BAND, CHART_SECONDS_PER_COL, lo, hi);
+        scale_dirty = false;
+    }
+    if(full_redraw){
+        for(int i = 0; i < ncols; i++){
+            drawColumn(w, i);
+        }
+        full_redraw = false;
+    }else if(dirty_col >= 0){
+        drawColumn(w, dirty_col);
+    }
+    dirty_col = -1;
+    drawCursor(w, (int) ((current + 1) % ncols));
+}
@@ -0,0 +1,262 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+
+#include <config.h>
+#include <state.h>
+#include <logger.h>
+#include <hal_sim.h>
+#include <bme280_defs.h>
+
+void config_defaults(struct config *cfg){
+    memset(cfg, 0, sizeof(*cfg));
+    cfg->input_mode = KEYBOARD_INPUT;
+    cfg->log_mode = LOG_MODE_PERIODIC;
+    control_defaults(&cfg->control);
+    cfg->potentiometer = HAL_SIM_DEFAULT_POTENTIOMETER;
+    filter_defaults(&cfg->filter_ti);
+    filter_defaults(&cfg->filter_tr);
+}
+
+static char *trim(char *s){
+    while(isspace((unsigned char) *s)){
+        s++;
+    }
+    char *end = s + strlen(s);
+    while(end > s && isspace((unsigned char) end[-1])){
+        *--end = '\0';
+    }
+    return s;
+}
+
+static bool parseFloat(const char *value, float *out){
+    char *end;
+    *out = strtof(value, &end);
+    return end != value && *end == '\0';
+}
+
+static bool parseInt(const char *value, int *out){
+    char *end;
+    long v = strtol(value, &end, 10);
+    *out = (int) v;
+    return end != value && *end == '\0';
+}
+
+// Stage settings after the "filtro_ti_" / "filtro_tr_" prefix
+static bool parseFilter(const char *name, const char *value, struct filter_config *f){
+    int flag;
+    if(!strcmp(name, "outlier")){
+        return parseFloat(value, &f->outlier) && f->outlier >= 0;
+    }else if(!strcmp(name, "mediana")){
+        return parseInt(value, &f->median) && f->median >= 1 && f->median <= FILTER_MEDIAN_MAX;
+    }else if(!strcmp(name, "ema")){
+        return parseFloat(value, &f->ema) && f->ema > 0 && f->ema <= 1;
+    }else if(!strcmp(name, "kalman")){
+        bool ok = parseInt(value, &flag);
+        f->kalman = flag;
+        return ok;
+    }else if(!strcmp(name, "kalman_q")){
+        return parseFloat(value, &f->kalman_q) && f->kalman_q > 0;
+    }else if(!strcmp(name, "kalman_r")){
+        return parseFloat(value, &f->kalman_r) && f->kalman_r > 0;
+    }
+    return false;
+}
+
+// Zone settings after the "zona_" prefix
+static bool parseZone(const char *name, const char *value, struct zone_config *z){
+    char *end;
+    if(!strcmp(name, "i2c")){
+        if(!*value || strlen(value) >= sizeof(z->bus)){
+            return false;
+        }
+        strcpy(z->bus, value);
+        return true;
+    }else if(!strcmp(name, "bme280")){
+        long addr = strtol(value, &end, 0); // 0x77
+        z->addr = (uint8_t) addr;
+        return end != value && *end == '\0' && addr >= 0x03 && addr <= 0x77;
+    }else if(!strcmp(name, "pinos")){
+        long heater = strtol(value, &end, 10);
+        if(end == value || *end != ','){
+            return false;
+        }
+        const char *fan_start = end + 1;
+        long fan = strtol(fan_start, &end, 10);
+        z->heater_pin = (uint8_t) heater;
+        z->fan_pin = (uint8_t) fan;
+        return end != fan_start && *end == '\0' && heater >= 0 && heater < 32 && fan >= 0 && fan < 32;
+    }else if(!strcmp(name, "referencia")){
+        z->follow_reference = !strcmp(value, "tr");
+        return z->follow_reference || parseFloat(value, &z->reference);
+    }else if(!strcmp(name, "histerese")){
+        return parseFloat(value, &z->histeresis) && z->histeresis >= 0;
+    }else if(!strcmp(name, "controle")){
+        z->controller = controller_parse(value);
+        return z->controller >= 0;
+    }else if(!strcmp(name, "periodo_ms")){
+        return parseInt(value, &z->period_ms) && z->period_ms >= ZONE_TICK_MS;
+    }else if(!strcmp(name, "pwm_periodo_ms")){
+        return parseInt(value, &z->pwm_period_ms) && z->pwm_period_ms >= ZONE_TICK_MS;
+    }
+    return false;
+}
+
+static void zoneDefaults(struct zone_config *z, const char *name){
+    memset(z, 0, sizeof(*z));
+    strcpy(z->name, name);
+    strcpy(z->bus, ZONE_DEFAULT_BUS);
+    z->addr = BME280_I2C_ADDR_SEC;
+    z->follow_reference = true;
+    z->histeresis = 1;
+    z->controller = CONTROL_HYSTERESIS;
+    z->period_ms = ZONE_DEFAULT_PERIOD_MS;
+    z->pwm_period_ms = ZONE_DEFAULT_PWM_PERIOD_MS;
+}
+
+static struct controller_config *lastShadow(struct config *cfg){
+    return &cfg->control.shadow[cfg->control.shadows - 1];
+}
+
+// Returns 0, -1 if the file can not be opened or the number of the first bad line
+int config_load(const char *path, struct config *cfg){
+    FILE *arq = fopen(path, "r");
+    if(!arq){
+        return -1;
+    }
+
+    char line[256];
+    int line_number = 0;
+    while(fgets(line, sizeof(line), arq)){
+        line_number++;
+        char *comment = strchr(line, '#');
+        if(comment){
+            *comment = '\0';
+        }
+        char *key = trim(line);
+        if(!*key){
+            continue;
+        }
+        char *eq = strchr(key, '=');
+        if(!eq){
+            fclose(arq);
+            return line_number;
+        }
+        *eq = '\0';
+        char *value = trim(eq + 1);
+        key = trim(key);
+
+        bool ok;
+        int flag;
+        if(!strcmp(key, "headless")){
+            ok = parseInt(value, &flag);
+            cfg->headless = flag;
+        }else if(!strcmp(key, "referencia")){
+            ok = cfg->has_reference = parseFloat(value, &cfg->reference_temp);
+        }else if(!strcmp(key, "histerese")){
+            ok = cfg->has_histeresis = parseFloat(value, &cfg->histeresis_temp);
+        }else if(!strcmp(key, "entrada")){
+            ok = cfg->has_input_mode = true;
+            if(!strcmp(value, "teclado")){
+                cfg->input_mode = KEYBOARD_INPUT;
+            }else if(!strcmp(value, "potenciometro")){
+                cfg->input_mode = POTENTIOMETER_INPUT;
+            }else{
+                ok = false;
+            }
+        }else if(!strcmp(key, "log_completo")){
+            ok = cfg->has_log_mode = parseInt(value, &flag);
+            cfg->log_mode = flag ? LOG_MODE_FULL_RATE : LOG_MODE_PERIODIC;
+        }else if(!strcmp(key, "historico_horas")){
+            ok = parseInt(value, &cfg->history_hours) && cfg->history_hours > 0;
+        }else if(!strcmp(key, "controle")){
+            int type = controller_parse(value);
+            ok = type >= 0;
+            if(ok){
+                cfg->control.mode = type;
+            }
+        }else if(!strcmp(key, "sombra")){
+            // Starts from the gains read so far; sombra_* lines below adjust it
+            int type = controller_parse(value);
+            ok = type >= 0 && cfg->control.shadows < CONTROL_MAX_SHADOWS;
+            if(ok){
+                control_controller_config(&cfg->control, type, &cfg->control.shadow[cfg->control.shadows++]);
+            }
+        }else if(!strcmp(key, "sombra_kp")){
+            ok = cfg->control.shadows > 0 && parseFloat(value, &lastShadow(cfg)->pid.kp);
+        }else if(!strcmp(key, "sombra_ki")){
+            ok = cfg->control.shadows > 0 && parseFloat(value, &lastShadow(cfg)->pid.ki);
+        }else if(!strcmp(key, "sombra_kd")){
+            ok = cfg->control.shadows > 0 && parseFloat(value, &lastShadow(cfg)->pid.kd);
+        }else if(!strcmp(key, "kp")){
+            ok = parseFloat(value, &cfg->control.kp);
+        }else if(!strcmp(key, "ki")){
+            ok = parseFloat(value, &cfg->control.ki);
+        }else if(!strcmp(key, "kd")){
+            ok = parseFloat(value, &cfg->control.kd);
+        }else if(!strcmp(key, "smith_lambda_s")){
+            ok = parseFloat(value, &cfg->control.smith_lambda_s) && cfg->control.smith_lambda_s > 0;
+        }else if(!strcmp(key, "smith_feedforward")){
+            ok = parseInt(value, &flag);
+            cfg->control.smith_feedforward = flag;
+        }else if(!strcmp(key, "pid_periodo_ms")){
+            ok = parseInt(value, &cfg->control.pid_period_ms) && cfg->control.pid_period_ms > 0;
+        }else if(!strcmp(key, "pwm_periodo_ms")){
+            ok = parseInt(value, &cfg->control.pwm_period_ms) && cfg->control.pwm_period_ms >= PWM_STEPS / 10;
+        }else if(!strcmp(key, "pwm_min_ligado_ms")){
+            ok = parseInt(value, &cfg->control.pwm_min_on_ms) && cfg->control.pwm_min_on_ms >= 0;
+        }else if(!strcmp(key, "pwm_min_desligado_ms")){
+            ok = parseInt(value, &cfg->control.pwm_min_off_ms) && cfg->control.pwm_min_off_ms >= 0;
+        }else if(!strcmp(key, "autotune")){
+            ok = parseInt(value, &flag);
+            cfg->control.autotune = flag;
+        }else if(!strcmp(key, "autotune_ciclos")){
+            ok = parseInt(value, &cfg->control.autotune_cycles) && cfg->control.autotune_cycles > 0;
+        }else if(!strcmp(key, "autotune_regra")){
+            ok = true;
+            if(!strcmp(value, "zn")){
+                cfg->control.autotune_rule = AUTOTUNE_RULE_ZN;
+            }else if(!strcmp(value, "tl")){
+                cfg->control.autotune_rule = AUTOTUNE_RULE_TL;
+            }else{
+                ok = false;
+            }
+        }else if(!strcmp(key, "tempo_min_ligado_ms")){
+            ok = parseInt(value, &cfg->control.min_on_ms) && cfg->control.min_on_ms >= 0;
+        }else if(!strcmp(key, "tempo_min_desligado_ms")){
+            ok = parseInt(value, &cfg->control.min_off_ms) && cfg->control.min_off_ms >= 0;
+        }else if(!strcmp(key, "simulacao")){
+            ok = parseInt(value, &flag);
+            cfg->simulation = flag;
+        }else if(!strcmp(key, "modelo_planta")){
+            ok = *value && strlen(value) < sizeof(cfg->plant_model);
+            if(ok){
+                strcpy(cfg->plant_model, value);
+            }
+        }else if(!strcmp(key, "potenciometro")){
+            ok = parseFloat(value, &cfg->potentiometer);
+        }else if(!strcmp(key, "zona")){
+            // Names the log files: no path separators
+            ok = *value && strlen(value) < ZONE_NAME_MAX && !strchr(value, '/') && cfg->zone_count < ZONE_MAX;
+            if(ok){
+                zoneDefaults(&cfg->zones[cfg->zone_count++], value);
+            }
+        }else if(!strncmp(key, "zona_", 5)){
+            ok = cfg->zone_count > 0 && parseZone(key + 5, value, &cfg->zones[cfg->zone_count - 1]);
+        }else if(!strncmp(key, "filtro_ti_", 10)){
+            ok = parseFilter(key + 10, value, &cfg->filter_ti);
+        }else if(!strncmp(key, "filtro_tr_", 10)){
+            ok = parseFilter(key + 10, value, &cfg->filter_tr);
+        }else{
+            ok = false;
+        }
+
+        if(!ok){
+            fclose(arq);
+            return line_number;
+        }
+    }
+    fclose(arq);
+    return 0;
+}
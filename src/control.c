@@ -0,0 +1,493 @@
+#include <math.h>
+#include <pthread.h>
+#include <string.h>
+
+#include <control.h>
+#include <actuator.h>
+#include <sample.h>
+#include <vclock.h>
+#include <state.h>
+#include <logger.h>
+
+static struct control_config config;
+static struct controller active;
+static struct autotune tune;
+
+static int requested_mode = CONTROL_HYSTERESIS;
+static int state = ST_STAND_BY;
+static float output = 0;
+
+// Output edges a law's demand stands for, in the units of the actuator
+// counts: an on/off law toggles a pin when its demand changes, a PWM law
+// writes a rising and a falling edge every period while the duty is
+// strictly between 0 and 1
+struct edge_count {
+    struct controller_output last; // demand of the interval being counted
+    double pwm[2];                 // fraction of an edge carried over
+};
+
+// Shadows see the same input as the active controller; their outputs are
+// only measured (metrics, divergence from what the actuators did)
+struct shadow {
+    struct controller ctl;
+    struct controller_output held; // demand over the interval being measured
+    struct edge_count edges;
+    struct metrics metrics;
+    int metrics_type; // type that ran the open step
+    double divergence; // integral of |shadow - actual| demand, s
+    double duration_s;
+};
+static struct shadow shadows[CONTROL_MAX_SHADOWS];
+static int shadow_count = 0;
+static bool pending_swap = false;
+
+// The active law fed with the raw input: what the input filters save
+static struct controller unfiltered;
+static struct edge_count filtered_edges, unfiltered_edges;
+static int64_t edges_last_ms = -1;
+static uint64_t switches_filtered = 0, switches_unfiltered = 0;
+
+static bool pending_autotune = false;
+static int tune_prev_mode = CONTROL_HYSTERESIS;
+static bool gains_saved = false;
+
+static uint64_t reactions = 0;
+static int64_t latency_last_us = 0, latency_max_us = 0, latency_sum_us = 0;
+
+// Quality of the running steps; each closed step goes to metrics.csv
+static struct metrics metrics;
+static struct actuator_stats metrics_actuator;
+static int64_t metrics_last_ms = -1;
+static int metrics_mode = CONTROL_HYSTERESIS;
+
+static pthread_mutex_t control_lock = PTHREAD_MUTEX_INITIALIZER;
+
+void control_defaults(struct control_config *cfg){
+    cfg->mode = CONTROL_HYSTERESIS;
+    cfg->kp = PID_DEFAULT_KP;
+    cfg->ki = PID_DEFAULT_KI;
+    cfg->kd = PID_DEFAULT_KD;
+    cfg->tf = PID_DEFAULT_TF;
+    cfg->pid_period_ms = PID_DEFAULT_PERIOD_MS;
+    cfg->pwm_period_ms = PWM_DEFAULT_PERIOD_MS;
+    cfg->pwm_min_on_ms = PWM_DEFAULT_MIN_ON_MS;
+    cfg->pwm_min_off_ms = PWM_DEFAULT_MIN_OFF_MS;
+    cfg->autotune = false;
+    cfg->autotune_cycles = AUTOTUNE_DEFAULT_CYCLES;
+    cfg->autotune_rule = AUTOTUNE_RULE_TL;
+    cfg->gains_path = NULL;
+    cfg->min_on_ms = ACTUATOR_DEFAULT_MIN_ON_MS;
+    cfg->min_off_ms = ACTUATOR_DEFAULT_MIN_OFF_MS;
+    plant_model_defaults(&cfg->model);
+    cfg->smith_lambda_s = SMITH_DEFAULT_LAMBDA_S;
+    cfg->smith_feedforward = true;
+    cfg->shadows = 0;
+    cfg->raw_compare = false;
+}
+
+void control_controller_config(const struct control_config *cfg, int type, struct controller_config *out){
+    out->type = type;
+    out->pid.kp = cfg->kp;
+    out->pid.ki = cfg->ki;
+    out->pid.kd = cfg->kd;
+    out->pid.tf = cfg->tf;
+    out->pid.period_ms = cfg->pid_period_ms;
+    out->smith.model = cfg->model;
+    out->smith.lambda_s = cfg->smith_lambda_s;
+    out->smith.feedforward = cfg->smith_feedforward;
+    out->smith.period_ms = cfg->pid_period_ms;
+}
+
+void control_init(const struct control_config *cfg){
+    struct controller_config cc;
+    config = *cfg;
+    actuator_init(CONTROL_HEATER_PIN, CONTROL_FAN_PIN, cfg->min_on_ms, cfg->min_off_ms);
+    control_controller_config(cfg, CONTROL_HYSTERESIS, &cc);
+    controller_init(&active, &cc);
+    unfiltered = active;
+    requested_mode = cfg->mode;
+    tune.status = AUTOTUNE_IDLE;
+    pending_autotune = cfg->autotune;
+    metrics_init(&metrics);
+    metrics_last_ms = -1;
+
+    shadow_count = 0;
+    for(int i = 0; i < cfg->shadows && i < CONTROL_MAX_SHADOWS; i++){
+        struct shadow *s = &shadows[shadow_count];
+        memset(s, 0, sizeof(*s));
+        // One chamber model for every law (loaded after the shadows were read)
+        cc = cfg->shadow[i];
+        cc.smith.model = cfg->model;
+        if(!controller_init(&s->ctl, &cc)){
+            metrics_init(&s->metrics);
+            s->metrics_type = s->ctl.config.type;
+            shadow_count++;
+        }
+    }
+}
+
+void control_request_mode(int new_mode){
+    pthread_mutex_lock(&control_lock);
+    requested_mode = new_mode;
+    pthread_mutex_unlock(&control_lock);
+}
+
+void control_request_swap(void){
+    pthread_mutex_lock(&control_lock);
+    pending_swap = shadow_count > 0;
+    pthread_mutex_unlock(&control_lock);
+}
+
+void control_request_autotune(void){
+    pthread_mutex_lock(&control_lock);
+    if(tune.status != AUTOTUNE_RUNNING){
+        pending_autotune = true;
+    }
+    pthread_mutex_unlock(&control_lock);
+}
+
+// Hands the outputs to next, keeping its state (a shadow takes over
+// bumplessly); false if the PWM thread could not be started
+static bool activate(const struct controller *next){
+    if(next->ops->pwm && !active.ops->pwm){
+        if(pwm_start(config.pwm_period_ms, config.pwm_min_on_ms, config.pwm_min_off_ms)){
+            return false;
+        }
+    }else if(!next->ops->pwm && active.ops->pwm){
+        // PWM leaves both outputs off
+        pwm_stop();
+    }
+    active = *next;
+    unfiltered = active;
+    output = active.ops->pwm ? active.out.heater - active.out.fan : 0;
+    if(active.ops->pwm){
+        pwm_set(active.out.heater, active.out.fan);
+    }
+    return true;
+}
+
+// Mode switches happen on the control thread, between two steps
+static void applyMode(int new_mode){
+    struct controller next;
+    struct controller_config cc;
+    if(new_mode == active.config.type){
+        return;
+    }
+    control_controller_config(&config, new_mode, &cc);
+    if(controller_init(&next, &cc) || !activate(&next)){
+        // Keep the current controller
+        requested_mode = active.config.type;
+    }
+}
+
+// The active controller and the first shadow trade places
+static void swapShadow(void){
+    pending_swap = false;
+    struct controller prev = active;
+    if(!activate(&shadows[0].ctl)){
+        return;
+    }
+    shadows[0].ctl = prev;
+    requested_mode = active.config.type;
+    metrics_split(&metrics);
+    metrics_split(&shadows[0].metrics);
+}
+
+static void stepActive(const struct control_input *in, const struct controller_input *ci){
+    if(!active.ops->pwm){
+        controller_update(&active, ci);
+        state = active.out.state;
+        actuator_set_state(state);
+        actuator_set(active.out.heater > 0, active.out.fan > 0);
+        return;
+    }
+
+    if(!in->running){
+        pwm_set(0, 0);
+        output = 0;
+        state = ST_STAND_BY;
+        return;
+    }
+    if(controller_update(&active, ci)){
+        pwm_set(active.out.heater, active.out.fan);
+        output = active.out.heater - active.out.fan;
+        state = active.out.state;
+        // Recorded with the transitions the PWM thread makes
+        actuator_set_state(state);
+    }
+}
+
+static bool modulated(float duty){
+    int steps = (int) (duty * PWM_STEPS + 0.5f);
+    return steps > 0 && steps < PWM_STEPS;
+}
+
+// Heater and fan edges of the demand held over the last dt_ms and of the
+// change to out
+static void countEdges(struct edge_count *e, bool pwm, const struct controller_output *out, float dt_ms,
+    uint32_t n[2]){
+    const float last[2] = { e->last.heater, e->last.fan }, next[2] = { out->heater, out->fan };
+    int period_ms = config.pwm_period_ms > 0 ? config.pwm_period_ms : PWM_DEFAULT_PERIOD_MS;
+    for(int i = 0; i < 2; i++){
+        n[i] = 0;
+        if(pwm && modulated(last[i])){
+            e->pwm[i] += 2.0 * dt_ms / period_ms;
+            n[i] = (uint32_t) e->pwm[i];
+            e->pwm[i] -= n[i];
+        }else if(!pwm || !modulated(next[i])){
+            n[i] = (last[i] > 0) != (next[i] > 0);
+        }
+    }
+    e->last = *out;
+}
+
+// Only with an input filter on; otherwise both runs would be the same
+static void stepUnfiltered(const struct control_input *in, const struct controller_input *ci){
+    if(!config.raw_compare || !in->running){
+        edges_last_ms = -1;
+        return;
+    }
+    struct controller_input raw = *ci;
+    raw.reference = in->reference_raw;
+    raw.temp = in->intern_raw;
+    controller_update(&unfiltered, &raw);
+    float dt = edges_last_ms >= 0 && ci->now_ms > edges_last_ms ? (float) (ci->now_ms - edges_last_ms) : 0;
+    edges_last_ms = ci->now_ms;
+    uint32_t n[2];
+    countEdges(&filtered_edges, active.ops->pwm, &active.out, dt, n);
+    switches_filtered += n[0] + n[1];
+    countEdges(&unfiltered_edges, unfiltered.ops->pwm, &unfiltered.out, dt, n);
+    switches_unfiltered += n[0] + n[1];
+}
+
+static void stepShadows(const struct control_input *in, const struct controller_input *ci){
+    for(int i = 0; i < shadow_count; i++){
+        struct shadow *s = &shadows[i];
+        s->held = s->ctl.out;
+        if(in->running){
+            controller_update(&s->ctl, ci);
+        }
+    }
+}
+
+// Relay experiment on the hysteresis outputs; the loop runs in hysteresis mode meanwhile
+static void startAutotune(const struct control_input *in){
+    pending_autotune = false;
+    autotune_start(&tune, in->reference_temp, in->histeresis_temp / 2,
+        config.autotune_cycles, config.autotune_rule);
+    tune_prev_mode = requested_mode;
+    requested_mode = CONTROL_HYSTERESIS;
+    gains_saved = false;
+}
+
+static void stepAutotune(const struct control_input *in){
+    float relay = in->running ? autotune_step(&tune, vclock_now_ms(), in->intern_temp) : 0;
+    if(!in->running){
+        tune.status = AUTOTUNE_FAILED;
+    }
+
+    if(relay != 0){
+        state = relay > 0 ? ST_WARMING_UP : ST_COOLING_DOWN;
+        // The hysteresis controller carries on from the relay outputs
+        active.hysteresis.heater = relay > 0;
+        active.hysteresis.fan = relay < 0;
+        active.out.state = state;
+        actuator_set_state(state);
+        actuator_set(relay > 0, relay < 0);
+    }
+
+    if(tune.status == AUTOTUNE_DONE){
+        // Used by the next PID controller made active
+        config.kp = tune.result.kp;
+        config.ki = tune.result.ki;
+        config.kd = tune.result.kd;
+        gains_saved = config.gains_path && !autotune_save(config.gains_path, &tune);
+    }
+    if(tune.status != AUTOTUNE_RUNNING){
+        requested_mode = tune_prev_mode;
+    }
+}
+
+static void logStep(const struct metrics_step *s, int step_mode, int shadow){
+    struct metrics_report r;
+    metrics_report(s, &r);
+    logger_push_metrics(step_mode, shadow, &r);
+}
+
+static void stopMetrics(void){
+    struct metrics_step closed;
+    if(metrics_stop(&metrics, &closed)){
+        logStep(&closed, metrics_mode, 0);
+    }
+    for(int i = 0; i < shadow_count; i++){
+        if(metrics_stop(&shadows[i].metrics, &closed)){
+            logStep(&closed, shadows[i].metrics_type, i + 1);
+        }
+    }
+}
+
+// Error terms are those of the real loop; outputs are the shadow's demand
+static void updateShadowMetrics(struct shadow *s, int index, const struct metrics_input *actual, float dt_ms){
+    struct metrics_step closed;
+    struct metrics_input mi = *actual;
+    const struct controller_output *h = &s->held;
+    mi.heater = h->heater;
+    mi.fan = h->fan;
+    if(dt_ms > 0){
+        // Counted as the pins would switch, so the laws compare in one unit
+        uint32_t n[2];
+        countEdges(&s->edges, s->ctl.ops->pwm, h, dt_ms, n);
+        mi.heater_transitions = n[0];
+        mi.fan_transitions = n[1];
+        s->divergence += fabsf((h->heater - h->fan) - (actual->heater - actual->fan)) * dt_ms / 1000.0;
+        s->duration_s += dt_ms / 1000.0;
+    }
+    // The first output is compared with itself, not with the idle state
+    if(dt_ms <= 0){
+        s->edges.last = s->ctl.out;
+    }
+    if(metrics_update(&s->metrics, &mi, &closed)){
+        logStep(&closed, s->metrics_type, index + 1);
+    }
+    s->metrics_type = s->ctl.config.type;
+}
+
+static void updateMetrics(const struct control_input *in){
+    struct metrics_step closed;
+    if(!in->running){
+        stopMetrics();
+        metrics_last_ms = -1;
+        return;
+    }
+
+    int64_t now = vclock_now_ms();
+    struct actuator_stats a;
+    actuator_get_stats(&a);
+    int step_mode = tune.status == AUTOTUNE_RUNNING ? CONTROL_METRICS_AUTOTUNE : active.config.type;
+    if(step_mode != metrics_mode){
+        metrics_split(&metrics);
+    }
+
+    struct metrics_input mi = { now, in->reference_temp, in->intern_temp, in->histeresis_temp / 2, 0, 0, 0, 0 };
+    float dt = 0;
+    if(metrics_last_ms >= 0 && now > metrics_last_ms){
+        dt = (float) (now - metrics_last_ms);
+        mi.heater = (a.out[ACTUATOR_HEATER].on_ms - metrics_actuator.out[ACTUATOR_HEATER].on_ms) / dt;
+        mi.fan = (a.out[ACTUATOR_FAN].on_ms - metrics_actuator.out[ACTUATOR_FAN].on_ms) / dt;
+        mi.heater_transitions = a.out[ACTUATOR_HEATER].transitions - metrics_actuator.out[ACTUATOR_HEATER].transitions;
+        mi.fan_transitions = a.out[ACTUATOR_FAN].transitions - metrics_actuator.out[ACTUATOR_FAN].transitions;
+    }
+    metrics_actuator = a;
+    metrics_last_ms = now;
+
+    // A closed step belongs to the mode that ran it
+    if(metrics_update(&metrics, &mi, &closed)){
+        logStep(&closed, metrics_mode, 0);
+    }
+    metrics_mode = step_mode;
+    for(int i = 0; i < shadow_count; i++){
+        updateShadowMetrics(&shadows[i], i, &mi, dt);
+    }
+}
+
+int control_step(const struct control_input *in){
+    pthread_mutex_lock(&control_lock);
+    if(pending_autotune && in->running){
+        startAutotune(in);
+    }
+    if(pending_swap && tune.status != AUTOTUNE_RUNNING){
+        swapShadow();
+    }
+    applyMode(requested_mode);
+
+    struct controller_input ci;
+    ci.now_ms = vclock_now_ms();
+    ci.reference = in->reference_temp;
+    ci.temp = in->intern_temp;
+    ci.band = in->histeresis_temp / 2;
+    ci.ambient = in->extern_temp;
+    if(tune.status == AUTOTUNE_RUNNING){
+        stepAutotune(in);
+        // Both start again from the relay outputs
+        unfiltered = active;
+    }else{
+        stepActive(in, &ci);
+        stepUnfiltered(in, &ci);
+    }
+    stepShadows(in, &ci);
+    if(in->sensed_ns){
+        // In PID mode the outputs follow at the next PWM edge
+        int64_t latency = (sample_monotonic_ns() - in->sensed_ns) / 1000;
+        latency_last_us = latency;
+        if(latency > latency_max_us){
+            latency_max_us = latency;
+        }
+        latency_sum_us += latency;
+        reactions++;
+    }
+    updateMetrics(in);
+    int res = state;
+    pthread_mutex_unlock(&control_lock);
+    return res;
+}
+
+void control_get_status(struct control_status *status){
+    pthread_mutex_lock(&control_lock);
+    status->mode = active.config.type;
+    status->state = state;
+    status->output = output;
+    status->predicted = active.out.predicted;
+    status->timing = active.timing;
+    status->autotune_status = tune.status;
+    status->autotune_rule = tune.rule;
+    status->autotune_cycle = tune.completed > 0 ? tune.completed - 1 : 0;
+    status->autotune_cycles = tune.cycles;
+    status->gains_saved = gains_saved;
+    status->autotune = tune.result;
+    status->reactions = reactions;
+    status->latency_last_us = latency_last_us;
+    status->latency_max_us = latency_max_us;
+    status->latency_avg_us = reactions ? latency_sum_us / (int64_t) reactions : 0;
+    metrics_report(&metrics.step, &status->metrics_step);
+    metrics_report_totals(&metrics.total, &status->metrics_total);
+    status->switches_filtered = switches_filtered;
+    status->switches_unfiltered = switches_unfiltered;
+    status->shadows = shadow_count;
+    for(int i = 0; i < shadow_count; i++){
+        const struct shadow *s = &shadows[i];
+        struct control_shadow_status *out = &status->shadow[i];
+        out->type = s->ctl.config.type;
+        out->config = s->ctl.config;
+        out->output = s->ctl.out.heater - s->ctl.out.fan;
+        out->divergence = s->duration_s > 0 ? (float) (s->divergence / s->duration_s) : 0;
+        metrics_report_totals(&s->metrics.total, &out->metrics_total);
+    }
+    pthread_mutex_unlock(&control_lock);
+    pwm_get_stats(&status->pwm);
+    actuator_get_stats(&status->actuator);
+}
+
+void control_get_outputs(float *heater, float *fan){
+    pthread_mutex_lock(&control_lock);
+    if(active.ops->pwm){
+        struct pwm_stats pwm;
+        pwm_get_stats(&pwm);
+        *heater = pwm.heater_duty;
+        *fan = pwm.fan_duty;
+    }else{
+        struct actuator_stats a;
+        actuator_get_stats(&a);
+        *heater = a.out[ACTUATOR_HEATER].on;
+        *fan = a.out[ACTUATOR_FAN].on;
+    }
+    pthread_mutex_unlock(&control_lock);
+}
+
+void control_shutdown(void){
+    pthread_mutex_lock(&control_lock);
+    stopMetrics();
+    pthread_mutex_unlock(&control_lock);
+    pwm_stop();
+    actuator_off();
+    controller_reset(&active);
+}
@@ -0,0 +1,215 @@
+#include <math.h>
+#include <string.h>
+#include <time.h>
+
+#include <controller.h>
+#include <state.h>
+
+static void resetHysteresis(struct controller *c){
+    c->hysteresis.heater = false;
+    c->hysteresis.fan = false;
+}
+
+static bool updateHysteresis(struct controller *c, const struct controller_input *in, struct controller_output *out){
+    if(in->temp < in->reference - in->band){
+        out->state = ST_WARMING_UP;
+        // liga resistor, desliga ventilador
+        c->hysteresis.heater = true;
+        c->hysteresis.fan = false;
+    }else if(in->temp > in->reference + in->band){
+        out->state = ST_COOLING_DOWN;
+        // desliga resistor, liga ventilador
+        c->hysteresis.heater = false;
+        c->hysteresis.fan = true;
+    }else if(in->temp < in->reference){
+        out->state = ST_STAND_BY;
+        // desliga ventilador
+        c->hysteresis.fan = false;
+    }else if(in->temp > in->reference){
+        // desliga resistor
+        out->state = ST_STAND_BY;
+        c->hysteresis.heater = false;
+    }
+    out->heater = c->hysteresis.heater;
+    out->fan = c->hysteresis.fan;
+    out->predicted = in->temp;
+    return true;
+}
+
+// Signed output split into the heater and fan duties
+static void setDemand(struct controller_output *out, float u){
+    out->heater = u > 0 ? u : 0;
+    out->fan = u < 0 ? -u : 0;
+    if(u > CONTROLLER_PID_DEADBAND){
+        out->state = ST_WARMING_UP;
+    }else if(u < -CONTROLLER_PID_DEADBAND){
+        out->state = ST_COOLING_DOWN;
+    }else{
+        out->state = ST_STAND_BY;
+    }
+}
+
+static void resetPID(struct controller *c){
+    const struct pid_controller_config *p = &c->config.pid;
+    pid_init(&c->pid.pid, p->kp, p->ki, p->kd, p->tf, -1.0f, 1.0f);
+    c->pid.last_ms = -1;
+}
+
+static bool updatePID(struct controller *c, const struct controller_input *in, struct controller_output *out){
+    int period_ms = c->config.pid.period_ms;
+    if(c->pid.last_ms >= 0 && in->now_ms - c->pid.last_ms < period_ms){
+        return false;
+    }
+    float dt = c->pid.last_ms < 0 ? period_ms / 1000.0f : (in->now_ms - c->pid.last_ms) / 1000.0f;
+    c->pid.last_ms = in->now_ms;
+
+    float u = pid_update(&c->pid.pid, in->reference, in->temp, dt);
+    setDemand(out, u);
+    out->predicted = in->temp;
+    return true;
+}
+
+static int smithPeriodMs(const struct controller *c){
+    return c->config.smith.period_ms > 0 ? c->config.smith.period_ms : PID_DEFAULT_PERIOD_MS;
+}
+
+static void resetSmith(struct controller *c){
+    const struct smith_controller_config *s = &c->config.smith;
+    const struct plant_model *m = &s->model;
+    float lambda = s->lambda_s > 0 ? s->lambda_s : SMITH_DEFAULT_LAMBDA_S;
+    float kp = m->gain_heater > 0 ? m->tau_s / (m->gain_heater * lambda) : 0;
+    float ki = m->tau_s > 0 ? kp / m->tau_s : 0;
+    pid_init(&c->smith.pid, kp, ki, 0, PID_DEFAULT_TF, -1.0f, 1.0f);
+    c->smith.last_ms = -1;
+    c->smith.u = 0;
+    c->smith.pos = 0;
+    long delay = lroundf(m->dead_s * 1000 / smithPeriodMs(c));
+    c->smith.delay = delay < 0 ? 0 : (delay >= SMITH_MAX_DELAY_STEPS ? SMITH_MAX_DELAY_STEPS - 1 : (int) delay);
+}
+
+// Output that holds the reference at the current TE, from the model gains
+static float feedforward(const struct plant_model *m, float reference, float ambient){
+    float u = 0;
+    if(reference > ambient && m->gain_heater > 0){
+        u = (reference - ambient) / m->gain_heater;
+    }else if(reference < ambient && m->gain_fan > 0){
+        u = -(ambient - reference) / m->gain_fan;
+    }
+    return u > 1 ? 1 : (u < -1 ? -1 : u);
+}
+
+static bool updateSmith(struct controller *c, const struct controller_input *in, struct controller_output *out){
+    const struct smith_controller_config *s = &c->config.smith;
+    const struct plant_model *m = &s->model;
+    int period_ms = smithPeriodMs(c);
+    if(c->smith.last_ms >= 0 && in->now_ms - c->smith.last_ms < period_ms){
+        return false;
+    }
+    float dt = c->smith.last_ms < 0 ? period_ms / 1000.0f : (in->now_ms - c->smith.last_ms) / 1000.0f;
+    int n = c->smith.delay + 1;
+    if(c->smith.last_ms < 0){
+        // The model starts at rest on the measurement
+        c->smith.model = in->temp;
+        for(int i = 0; i < n; i++){
+            c->smith.history[i] = in->temp;
+        }
+    }else if(m->tau_s > 0){
+        // Delay-free model over the last period, with the output it applied
+        float u = c->smith.u;
+        float target = in->ambient + m->gain_heater * (u > 0 ? u : 0) - m->gain_fan * (u < 0 ? -u : 0);
+        c->smith.model = target + (c->smith.model - target) * expf(-dt / m->tau_s);
+    }
+    c->smith.last_ms = in->now_ms;
+
+    // Ring of delay + 1 periods: after the write, pos holds the oldest one
+    c->smith.history[c->smith.pos] = c->smith.model;
+    c->smith.pos = (c->smith.pos + 1) % n;
+    float delayed = c->smith.history[c->smith.pos];
+    float predicted = in->temp + c->smith.model - delayed;
+
+    float ff = s->feedforward ? feedforward(m, in->reference, in->ambient) : 0;
+    // The integral saturates with the sum
+    c->smith.pid.out_min = -1 - ff;
+    c->smith.pid.out_max = 1 - ff;
+    float u = ff + pid_update(&c->smith.pid, in->reference, predicted, dt);
+    u = u > 1 ? 1 : (u < -1 ? -1 : u);
+    c->smith.u = u;
+
+    setDemand(out, u);
+    out->predicted = predicted;
+    return true;
+}
+
+static const struct controller_ops hysteresis_ops = {
+    .name = "histerese",
+    .pwm = false,
+    .reset = resetHysteresis,
+    .update = updateHysteresis,
+};
+
+static const struct controller_ops pid_ops = {
+    .name = "pid",
+    .pwm = true,
+    .reset = resetPID,
+    .update = updatePID,
+};
+
+static const struct controller_ops smith_ops = {
+    .name = "smith",
+    .pwm = true,
+    .reset = resetSmith,
+    .update = updateSmith,
+};
+
+static const struct controller_ops *const controllers[CONTROLLER_TYPES] = {
+    [CONTROL_HYSTERESIS] = &hysteresis_ops,
+    [CONTROL_PID] = &pid_ops,
+    [CONTROL_SMITH] = &smith_ops,
+};
+
+int controller_init(struct controller *c, const struct controller_config *cfg){
+    if(cfg->type < 0 || cfg->type >= CONTROLLER_TYPES){
+        return -1;
+    }
+    memset(c, 0, sizeof(*c));
+    c->ops = controllers[cfg->type];
+    c->config = *cfg;
+    controller_reset(c);
+    return 0;
+}
+
+void controller_reset(struct controller *c){
+    c->ops->reset(c);
+    memset(&c->out, 0, sizeof(c->out));
+    c->out.state = ST_STAND_BY;
+}
+
+bool controller_update(struct controller *c, const struct controller_input *in){
+    struct timespec t0, t1;
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    bool computed = c->ops->update(c, in, &c->out);
+    if(computed){
+        clock_gettime(CLOCK_MONOTONIC, &t1);
+        int64_t ns = (t1.tv_sec - t0.tv_sec) * 1000000000LL + (t1.tv_nsec - t0.tv_nsec);
+        c->timing.iterations++;
+        c->timing.last_ns = ns;
+        c->timing.sum_ns += ns;
+        if(ns > c->timing.max_ns){
+            c->timing.max_ns = ns;
+        }
+    }
+    return computed;
+}
+
+int controller_parse(const char *name){
+    for(int i = 0; i < CONTROLLER_TYPES; i++){
+        if(!strcmp(name, controllers[i]->name)){
+            return i;
+        }
+    }
+    return -1;
+}
+
+const char *controller_name(int type){
+    return type >= 0 && type < CONTROLLER_TYPES ? controllers[type]->name : "?";
+}
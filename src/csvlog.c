@@ -0,0 +1,326 @@
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <time.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include <csvlog.h>
+
+struct index_header {
+    uint64_t magic;
+    uint64_t indexed_size; // log bytes already covered, always at a line start
+    int64_t first_ts_ms; // identifies the log the index was built for
+    uint32_t stride;
+    uint32_t count;
+};
+
+static const char *skipSpaces(const char *p, const char *end){
+    while(p < end && (*p == ' ' || *p == '\t')){
+        p++;
+    }
+    return p;
+}
+
+static bool parseInt(const char **pp, const char *end, int *out){
+    const char *p = skipSpaces(*pp, end);
+    int v = 0, digits = 0;
+    while(p < end && *p >= '0' && *p <= '9'){
+        v = v * 10 + (*p - '0');
+        p++;
+        digits++;
+    }
+    *pp = p;
+    *out = v;
+    return digits > 0;
+}
+
+// Fixed point numbers as written by "%0.2lf"
+static bool parseFloat(const char **pp, const char *end, float *out){
+    const char *p = skipSpaces(*pp, end);
+    bool negative = false;
+    if(p < end && (*p == '-' || *p == '+')){
+        negative = *p == '-';
+        p++;
+    }
+    double v = 0, scale = 1;
+    int digits = 0;
+    while(p < end && *p >= '0' && *p <= '9'){
+        v = v * 10 + (*p - '0');
+        p++;
+        digits++;
+    }
+    if(p < end && *p == '.'){
+        p++;
+        while(p < end && *p >= '0' && *p <= '9'){
+            v = v * 10 + (*p - '0');
+            scale *= 10;
+            p++;
+            digits++;
+        }
+    }
+    *pp = p;
+    *out = (float) ((negative ? -v : v) / scale);
+    return digits > 0;
+}
+
+// Days since 1970-01-01 of a civil date (H. Hinnant)
+static int64_t daysFromCivil(int64_t y, unsigned m, unsigned d){
+    y -= m <= 2;
+    int64_t era = (y >= 0 ? y : y - 399) / 400;
+    unsigned yoe = (unsigned) (y - era * 400);
+    unsigned doy = (153 * (m + (m > 2 ? -3 : 9)) + 2) / 5 + d - 1;
+    unsigned doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+    return era * 146097 + (int64_t) doe - 719468;
+}
+
+// UTC offset of local time, cached per hour so mktime runs once an hour of log
+static int64_t localOffset(int year, int mon, int day, int hour, int64_t civil_hour){
+    static int64_t cached_hour = INT64_MIN;
+    static int64_t cached_offset = 0;
+    if(civil_hour != cached_hour){
+        struct tm tm = {0};
+        tm.tm_year = year - 1900;
+        tm.tm_mon = mon - 1;
+        tm.tm_mday = day;
+        tm.tm_hour = hour;
+        tm.tm_isdst = -1;
+        cached_offset = (int64_t) mktime(&tm) - civil_hour * 3600;
+        cached_hour = civil_hour;
+    }
+    return cached_offset;
+}
+
+static int monthNumber(const char *p){
+    static const char MONTHS[] = "JanFebMarAprMayJunJulAugSepOctNovDec";
+    for(int m = 0; m < 12; m++){
+        if(p[0] == MONTHS[m * 3] && p[1] == MONTHS[m * 3 + 1] && p[2] == MONTHS[m * 3 + 2]){
+            return m + 1;
+        }
+    }
+    return 0;
+}
+
+// "Www Mmm dd hh:mm:ss yyyy" (asctime)
+int64_t csvlog_parse_time(const char *p, const char *end){
+    p = skipSpaces(p, end);
+    if(end - p < 24){
+        return -1;
+    }
+    int mon = monthNumber(p + 4);
+    if(!mon){
+        return -1;
+    }
+    p += 7;
+    int day, hh, mm, ss, year;
+    if(!parseInt(&p, end, &day) || p >= end || *p++ != ' '
+        || !parseInt(&p, end, &hh) || p >= end || *p++ != ':'
+        || !parseInt(&p, end, &mm) || p >= end || *p++ != ':'
+        || !parseInt(&p, end, &ss) || !parseInt(&p, end, &year)){
+        return -1;
+    }
+    int64_t civil_hour = daysFromCivil(year, mon, day) * 24 + hh;
+    int64_t epoch = civil_hour * 3600 + mm * 60 + ss + localOffset(year, mon, day, hh, civil_hour);
+    return epoch * 1000;
+}
+
+const char *csvlog_next(const char *p, const char *end, struct csvlog_row *row, bool *ok){
+    const char *eol = memchr(p, '\n', end - p);
+    const char *next = eol ? eol + 1 : end;
+    if(!eol){
+        eol = end;
+    }
+
+    const char *q = p;
+    *ok = parseFloat(&q, eol, &row->reference_temp) && q < eol && *q++ == ','
+        && parseFloat(&q, eol, &row->intern_temp) && q < eol && *q++ == ','
+        && parseFloat(&q, eol, &row->extern_temp) && q < eol && *q++ == ',';
+    if(*ok){
+        row->ts_ms = csvlog_parse_time(q, eol);
+        *ok = row->ts_ms >= 0;
+    }
+    return next;
+}
+
+const char *csvlog_next_event(const char *p, const char *end, struct csvlog_event *ev, bool *ok){
+    const char *eol = memchr(p, '\n', end - p);
+    const char *next = eol ? eol + 1 : end;
+    if(!eol){
+        eol = end;
+    }
+
+    const char *q = p;
+    int heater, fan;
+    *ok = parseInt(&q, eol, &ev->state) && q < eol && *q++ == ','
+        && parseInt(&q, eol, &heater) && q < eol && *q++ == ','
+        && parseInt(&q, eol, &fan) && q < eol && *q++ == ',';
+    if(*ok){
+        ev->heater = heater == 0;
+        ev->fan = fan == 0;
+        ev->ts_ms = csvlog_parse_time(q, eol);
+        *ok = ev->ts_ms >= 0;
+    }
+    return next;
+}
+
+int csvlog_open(struct csvlog *log, const char *path){
+    memset(log, 0, sizeof(*log));
+    log->index_fd = -1;
+    log->fd = open(path, O_RDONLY);
+    if(log->fd < 0){
+        return -1;
+    }
+    struct stat st;
+    if(fstat(log->fd, &st) < 0){
+        close(log->fd);
+        return -1;
+    }
+    log->size = (size_t) st.st_size;
+    if(log->size){
+        void *map = mmap(NULL, log->size, PROT_READ, MAP_PRIVATE, log->fd, 0);
+        if(map == MAP_FAILED){
+            close(log->fd);
+            return -1;
+        }
+        madvise(map, log->size, MADV_SEQUENTIAL);
+        log->data = map;
+    }
+    return 0;
+}
+
+void csvlog_close(struct csvlog *log){
+    if(log->index_map){
+        munmap(log->index_map, log->index_map_size);
+    }
+    if(log->index_fd >= 0){
+        close(log->index_fd);
+    }
+    if(log->data){
+        munmap((void *) log->data, log->size);
+    }
+    close(log->fd);
+    memset(log, 0, sizeof(*log));
+    log->fd = log->index_fd = -1;
+}
+
+static int64_t firstTimestamp(const struct csvlog *log){
+    const char *p = log->data, *end = log->data + log->size;
+    while(p < end){
+        struct csvlog_row row;
+        bool ok;
+        p = csvlog_next(p, end, &row, &ok);
+        if(ok){
+            return row.ts_ms;
+        }
+    }
+    return -1;
+}
+
+// Append a batch after the count entries already on disk. The header is
+// only written once every batch landed, so on failure it still describes
+// the previous, complete index
+static bool writeEntries(int fd, const struct csvlog_index_entry *batch, size_t n, uint32_t count){
+    ssize_t len = (ssize_t) (n * sizeof(batch[0]));
+    return pwrite(fd, batch, len, sizeof(struct index_header) + (off_t) count * sizeof(batch[0])) == len;
+}
+
+int csvlog_index(struct csvlog *log, const char *index_path){
+    log->index_fd = open(index_path, O_RDWR | O_CREAT, 0644);
+    if(log->index_fd < 0){
+        return -1;
+    }
+
+    struct index_header h;
+    struct csvlog_index_entry last = { -1, 0 };
+    int64_t first_ts = firstTimestamp(log);
+    ssize_t got = pread(log->index_fd, &h, sizeof(h), 0);
+    bool valid = got == (ssize_t) sizeof(h) && h.magic == CSVLOG_INDEX_MAGIC && h.stride == CSVLOG_INDEX_STRIDE
+        && h.indexed_size <= log->size && h.first_ts_ms == first_ts;
+    if(valid && h.count){
+        valid = pread(log->index_fd, &last, sizeof(last), sizeof(h) + (off_t) (h.count - 1) * sizeof(last)) == (ssize_t) sizeof(last);
+    }
+    if(!valid){
+        // Log was replaced or the index is damaged: rebuild
+        if(ftruncate(log->index_fd, 0) < 0){
+            return -1;
+        }
+        memset(&h, 0, sizeof(h));
+        h.magic = CSVLOG_INDEX_MAGIC;
+        h.stride = CSVLOG_INDEX_STRIDE;
+        h.first_ts_ms = first_ts;
+        last.ts_ms = -1;
+    }
+
+    // Extend over the part of the log appended since the last run
+    size_t pos = h.indexed_size;
+    size_t mark = h.count ? last.offset + CSVLOG_INDEX_STRIDE : 0;
+    const char *end = log->data + log->size;
+    struct csvlog_index_entry batch[256];
+    size_t pending = 0;
+    while(pos < log->size){
+        const char *line = log->data + pos;
+        const char *eol = memchr(line, '\n', end - line);
+        if(!eol){
+            break; // incomplete last line, indexed on the next run
+        }
+        if(pos >= mark){
+            struct csvlog_row row;
+            bool ok;
+            csvlog_next(line, end, &row, &ok);
+            if(ok){
+                batch[pending].ts_ms = row.ts_ms;
+                batch[pending].offset = pos;
+                pending++;
+                mark = pos + CSVLOG_INDEX_STRIDE;
+                if(pending == sizeof(batch) / sizeof(batch[0])){
+                    if(!writeEntries(log->index_fd, batch, pending, h.count)){
+                        return -1;
+                    }
+                    h.count += pending;
+                    pending = 0;
+                }
+            }
+        }
+        pos = (size_t) (eol + 1 - log->data);
+    }
+    if(pending){
+        if(!writeEntries(log->index_fd, batch, pending, h.count)){
+            return -1;
+        }
+        h.count += pending;
+    }
+    h.indexed_size = pos;
+    if(pwrite(log->index_fd, &h, sizeof(h), 0) != (ssize_t) sizeof(h)){
+        return -1;
+    }
+
+    log->index_entries = h.count;
+    log->index_map_size = sizeof(h) + (size_t) h.count * sizeof(struct csvlog_index_entry);
+    void *map = mmap(NULL, log->index_map_size, PROT_READ, MAP_SHARED, log->index_fd, 0);
+    if(map == MAP_FAILED){
+        log->index_entries = 0;
+        return -1;
+    }
+    log->index_map = map;
+    log->index = (const struct csvlog_index_entry *) ((const uint8_t *) map + sizeof(h));
+    return 0;
+}
+
+// Offset of the last indexed row at or before ts_ms
+size_t csvlog_seek(const struct csvlog *log, int64_t ts_ms){
+    if(!log->index_entries || log->index[0].ts_ms > ts_ms){
+        return 0;
+    }
+    size_t lo = 0, hi = log->index_entries;
+    while(hi - lo > 1){
+        size_t mid = lo + (hi - lo) / 2;
+        if(log->index[mid].ts_ms <= ts_ms){
+            lo = mid;
+        }else{
+            hi = mid;
+        }
+    }
+    return (size_t) log->index[lo].offset;
+}
@@ -0,0 +1,116 @@
+#include <math.h>
+#include <string.h>
+
+#include <filter.h>
+
+void filter_defaults(struct filter_config *cfg){
+    cfg->outlier = 0;
+    cfg->median = 1;
+    cfg->ema = 1;
+    cfg->kalman = false;
+    cfg->kalman_q = FILTER_DEFAULT_KALMAN_Q;
+    cfg->kalman_r = FILTER_DEFAULT_KALMAN_R;
+}
+
+bool filter_enabled(const struct filter_config *cfg){
+    return cfg->outlier > 0 || cfg->median > 1 || cfg->ema < 1 || cfg->kalman;
+}
+
+void filter_init(struct filter *f, const struct filter_config *cfg){
+    memset(f, 0, sizeof(*f));
+    f->cfg = *cfg;
+    if(f->cfg.median < 1){
+        f->cfg.median = 1;
+    }else if(f->cfg.median > FILTER_MEDIAN_MAX){
+        f->cfg.median = FILTER_MEDIAN_MAX;
+    }
+}
+
+void filter_reset(struct filter *f){
+    f->primed = false;
+    f->rejected_run = 0;
+    f->count = 0;
+    f->pos = 0;
+}
+
+static void prime(struct filter *f, float raw){
+    f->primed = true;
+    f->rejected_run = 0;
+    f->window[0] = raw;
+    f->count = 1;
+    f->pos = 1 % f->cfg.median;
+    f->ema = raw;
+    f->x = raw;
+    f->p = f->cfg.kalman_r;
+}
+
+static float median(const struct filter *f){
+    float sorted[FILTER_MEDIAN_MAX];
+    int n = f->count;
+    // Insertion sort, n <= FILTER_MEDIAN_MAX
+    for(int i = 0; i < n; i++){
+        float v = f->window[i];
+        int j = i;
+        while(j > 0 && sorted[j - 1] > v){
+            sorted[j] = sorted[j - 1];
+            j--;
+        }
+        sorted[j] = v;
+    }
+    return n % 2 ? sorted[n / 2] : (sorted[n / 2 - 1] + sorted[n / 2]) / 2;
+}
+
+static float kalman(struct filter *f, float z, float dt_s, const struct filter_process *process){
+    if(process && process->model && process->model->tau_s > 0){
+        const struct plant_model *m = process->model;
+        float target = process->ambient + m->gain_heater * process->heater - m->gain_fan * process->fan;
+        float a = expf(-dt_s / m->tau_s);
+        f->x = target + (f->x - target) * a;
+    }
+    f->p += f->cfg.kalman_q * dt_s;
+    float k = f->p / (f->p + f->cfg.kalman_r);
+    f->x += k * (z - f->x);
+    f->p *= 1 - k;
+    return f->x;
+}
+
+float filter_update(struct filter *f, float raw, float dt_s, const struct filter_process *process){
+    f->stats.samples++;
+    f->stats.raw = raw;
+    if(!f->primed){
+        prime(f, raw);
+        f->stats.out = raw;
+        return raw;
+    }
+
+    if(f->cfg.outlier > 0 && fabsf(raw - f->stats.out) > f->cfg.outlier){
+        f->stats.rejected++;
+        if(++f->rejected_run < FILTER_OUTLIER_MAX_RUN){
+            return f->stats.out;
+        }
+        // Persistent: a real step
+        prime(f, raw);
+        f->stats.out = raw;
+        return raw;
+    }
+    f->rejected_run = 0;
+
+    float v = raw;
+    if(f->cfg.median > 1){
+        f->window[f->pos] = raw;
+        f->pos = (f->pos + 1) % f->cfg.median;
+        if(f->count < f->cfg.median){
+            f->count++;
+        }
+        v = median(f);
+    }
+    if(f->cfg.ema < 1){
+        f->ema += f->cfg.ema * (v - f->ema);
+        v = f->ema;
+    }
+    if(f->cfg.kalman){
+        v = kalman(f, v, dt_s > 0 ? dt_s : 0, process);
+    }
+    f->stats.out = v;
+    return v;
+}
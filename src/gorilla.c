@@ -0,0 +1,257 @@
+#include <string.h>
+
+#include <gorilla.h>
+
+// Worst case bits per sample: timestamp + channels * value
+#define TS_MAX_BITS (4 + 32)
+#define VALUE_MAX_BITS (2 + 5 + 5 + 32)
+
+#define NO_WINDOW 0xFF
+
+struct bit_reader {
+    const uint8_t *p;
+    size_t len;
+    size_t pos;
+    uint64_t acc;
+    uint32_t bits;
+};
+
+static inline uint32_t floatBits(float f){
+    uint32_t u;
+    memcpy(&u, &f, sizeof(u));
+    return u;
+}
+
+static inline float bitsFloat(uint32_t u){
+    float f;
+    memcpy(&f, &u, sizeof(f));
+    return f;
+}
+
+static inline void putBits(struct gorilla_encoder *enc, uint32_t value, uint32_t n){
+    enc->acc = (enc->acc << n) | (n == 32 ? value : value & ((1U << n) - 1));
+    enc->acc_bits += n;
+    while(enc->acc_bits >= 8){
+        enc->acc_bits -= 8;
+        enc->buf[enc->len++] = (uint8_t) (enc->acc >> enc->acc_bits);
+    }
+}
+
+static inline uint32_t getBits(struct bit_reader *r, uint32_t n){
+    while(r->bits < n){
+        r->acc = (r->acc << 8) | (r->pos < r->len ? r->p[r->pos] : 0);
+        r->pos++;
+        r->bits += 8;
+    }
+    r->bits -= n;
+    uint64_t v = r->acc >> r->bits;
+    return n == 32 ? (uint32_t) v : (uint32_t) v & ((1U << n) - 1);
+}
+
+static inline int32_t signExtend(uint32_t v, uint32_t n){
+    uint32_t m = 1U << (n - 1);
+    return (int32_t) ((v ^ m) - m);
+}
+
+void gorilla_encoder_init(struct gorilla_encoder *enc, int channels){
+    if(channels > GORILLA_MAX_CHANNELS){
+        channels = GORILLA_MAX_CHANNELS;
+    }
+    enc->acc = 0;
+    enc->acc_bits = 0;
+    enc->len = GORILLA_HEADER_BYTES;
+    enc->count = 0;
+    enc->channels = channels;
+    enc->t0 = 0;
+    enc->last_ts = 0;
+    enc->last_delta = 0;
+    for(int c = 0; c < GORILLA_MAX_CHANNELS; c++){
+        enc->last_value[c] = 0;
+        enc->lead[c] = NO_WINDOW;
+        enc->trail[c] = 0;
+    }
+}
+
+static bool encodeTimestamp(struct gorilla_encoder *enc, int64_t ts_ms){
+    int64_t delta = ts_ms - enc->last_ts;
+    int64_t dod = delta - enc->last_delta;
+
+    if(dod == 0){
+        putBits(enc, 0x0, 1);
+    }else if(dod >= -63 && dod <= 64){
+        putBits(enc, 0x2, 2);
+        putBits(enc, (uint32_t) (dod + 63), 7);
+    }else if(dod >= -255 && dod <= 256){
+        putBits(enc, 0x6, 3);
+        putBits(enc, (uint32_t) (dod + 255), 9);
+    }else if(dod >= -2047 && dod <= 2048){
+        putBits(enc, 0xE, 4);
+        putBits(enc, (uint32_t) (dod + 2047), 12);
+    }else if(dod >= INT32_MIN && dod <= INT32_MAX){
+        putBits(enc, 0xF, 4);
+        putBits(enc, (uint32_t) (int32_t) dod, 32);
+    }else{
+        return false;
+    }
+    enc->last_delta = delta;
+    enc->last_ts = ts_ms;
+    return true;
+}
+
+static void encodeValue(struct gorilla_encoder *enc, int c, uint32_t value){
+    uint32_t x = value ^ enc->last_value[c];
+    enc->last_value[c] = value;
+
+    if(x == 0){
+        putBits(enc, 0x0, 1);
+        return;
+    }
+
+    uint32_t lead = __builtin_clz(x);
+    uint32_t trail = __builtin_ctz(x);
+
+    if(enc->lead[c] != NO_WINDOW && lead >= enc->lead[c] && trail >= enc->trail[c]){
+        // Fits in the previous meaningful window
+        uint32_t sig = 32 - enc->lead[c] - enc->trail[c];
+        putBits(enc, 0x2, 2);
+        putBits(enc, x >> enc->trail[c], sig);
+    }else{
+        uint32_t sig = 32 - lead - trail;
+        putBits(enc, 0x3, 2);
+        putBits(enc, lead, 5);
+        putBits(enc, sig - 1, 5);
+        putBits(enc, x >> trail, sig);
+        enc->lead[c] = (uint8_t) lead;
+        enc->trail[c] = (uint8_t) trail;
+    }
+}
+
+bool gorilla_encode(struct gorilla_encoder *enc, int64_t ts_ms, const float *values){
+    uint32_t worst = TS_MAX_BITS + enc->channels * VALUE_MAX_BITS;
+    if(enc->count >= GORILLA_BLOCK_SAMPLES
+        || enc->len + (enc->acc_bits + worst + 7) / 8 > GORILLA_BLOCK_BYTES){
+        return false;
+    }
+
+    if(enc->count == 0){
+        enc->t0 = ts_ms;
+        enc->last_ts = ts_ms;
+        enc->last_delta = 0;
+        for(int c = 0; c < enc->channels; c++){
+            enc->last_value[c] = floatBits(values[c]);
+            putBits(enc, enc->last_value[c], 32);
+        }
+    }else{
+        if(ts_ms < enc->last_ts || !encodeTimestamp(enc, ts_ms)){
+            return false;
+        }
+        for(int c = 0; c < enc->channels; c++){
+            encodeValue(enc, c, floatBits(values[c]));
+        }
+    }
+    enc->count++;
+    return true;
+}
+
+size_t gorilla_finish(struct gorilla_encoder *enc, const uint8_t **block){
+    // Pad the last partial byte with zeros
+    if(enc->acc_bits){
+        putBits(enc, 0, 8 - enc->acc_bits);
+    }
+
+    uint32_t magic = GORILLA_MAGIC;
+    uint32_t payload = enc->len - GORILLA_HEADER_BYTES;
+    uint8_t *h = enc->buf;
+    memcpy(h, &magic, 4);
+    h[4] = GORILLA_VERSION;
+    h[5] = (uint8_t) enc->channels;
+    h[6] = h[7] = 0;
+    memcpy(h + 8, &enc->count, 4);
+    memcpy(h + 12, &payload, 4);
+    memcpy(h + 16, &enc->t0, 8);
+
+    *block = enc->buf;
+    return enc->len;
+}
+
+int gorilla_block_info(const uint8_t *block, size_t len, struct gorilla_block_info *info){
+    uint32_t magic, payload;
+    if(len < GORILLA_HEADER_BYTES){
+        return -1;
+    }
+    memcpy(&magic, block, 4);
+    if(magic != GORILLA_MAGIC || block[4] != GORILLA_VERSION
+        || block[5] == 0 || block[5] > GORILLA_MAX_CHANNELS){
+        return -1;
+    }
+    memcpy(&payload, block + 12, 4);
+    if(GORILLA_HEADER_BYTES + (size_t) payload > len){
+        return -1;
+    }
+    info->channels = block[5];
+    memcpy(&info->count, block + 8, 4);
+    memcpy(&info->t0, block + 16, 8);
+    info->size = GORILLA_HEADER_BYTES + (size_t) payload;
+    return 0;
+}
+
+int gorilla_decode(const uint8_t *block, size_t len, int64_t *ts, float *values, uint32_t max){
+    struct gorilla_block_info info;
+    if(gorilla_block_info(block, len, &info)){
+        return -1;
+    }
+    if(info.count > max){
+        return -2;
+    }
+
+    struct bit_reader r = { block + GORILLA_HEADER_BYTES, info.size - GORILLA_HEADER_BYTES, 0, 0, 0 };
+    int channels = info.channels;
+    uint32_t last[GORILLA_MAX_CHANNELS];
+    uint32_t lead[GORILLA_MAX_CHANNELS], trail[GORILLA_MAX_CHANNELS];
+    int64_t t = info.t0, delta = 0;
+
+    for(uint32_t i = 0; i < info.count; i++){
+        if(i == 0){
+            for(int c = 0; c < channels; c++){
+                last[c] = getBits(&r, 32);
+                lead[c] = trail[c] = 0;
+            }
+        }else{
+            int64_t dod;
+            if(getBits(&r, 1) == 0){
+                dod = 0;
+            }else if(getBits(&r, 1) == 0){
+                dod = (int64_t) getBits(&r, 7) - 63;
+            }else if(getBits(&r, 1) == 0){
+                dod = (int64_t) getBits(&r, 9) - 255;
+            }else if(getBits(&r, 1) == 0){
+                dod = (int64_t) getBits(&r, 12) - 2047;
+            }else{
+                dod = signExtend(getBits(&r, 32), 32);
+            }
+            delta += dod;
+            t += delta;
+
+            for(int c = 0; c < channels; c++){
+                if(getBits(&r, 1) == 0){
+                    continue;
+                }
+                if(getBits(&r, 1) == 1){
+                    lead[c] = getBits(&r, 5);
+                    uint32_t sig = getBits(&r, 5) + 1;
+                    trail[c] = 32 - lead[c] - sig;
+                }
+                uint32_t sig = 32 - lead[c] - trail[c];
+                last[c] ^= getBits(&r, sig) << trail[c];
+            }
+        }
+        if(r.pos > r.len + 8){
+            return -3;
+        }
+        ts[i] = t;
+        for(int c = 0; c < channels; c++){
+            values[i * channels + c] = bitsFloat(last[c]);
+        }
+    }
+    return (int) info.count;
+}
@@ -0,0 +1,23 @@
+#include <string.h>
+
+#include <hal.h>
+
+#ifdef HAL_REAL
+const struct hal *hal = &hal_real;
+#else
+const struct hal *hal = &hal_sim;
+#endif
+
+int hal_select(const char *name){
+#ifdef HAL_REAL
+    if(!strcmp(name, hal_real.name)){
+        hal = &hal_real;
+        return 0;
+    }
+#endif
+    if(!strcmp(name, hal_sim.name)){
+        hal = &hal_sim;
+        return 0;
+    }
+    return -1;
+}
@@ -0,0 +1,92 @@
+#include <unistd.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <linux/i2c-dev.h>
+#include <bcm2835.h>
+
+#include <hal.h>
+#include <i2clcd.h>
+#include <uart_utils.h>
+#include <bme280_defs.h>
+
+// Raspberry Pi backend: bcm2835 for GPIO, wiringPi for the LCD
+
+static int gpioInit(void){
+    return bcm2835_init() ? 0 : -1;
+}
+
+static void gpioSetOutput(uint8_t pin){
+    bcm2835_gpio_fsel(pin, BCM2835_GPIO_FSEL_OUTP);
+}
+
+static void gpioWriteMask(uint32_t value, uint32_t mask){
+    bcm2835_gpio_write_mask(value, mask);
+}
+
+static void gpioClose(void){
+    bcm2835_close();
+}
+
+static int lcdInit(void){
+    lcd_init();
+    return 0;
+}
+
+static void lcdWriteLine(int line, const char *text){
+    lcdLoc(line ? LINE2 : LINE1);
+    typeln(text);
+}
+
+static int i2cOpen(struct hal_i2c_dev *dev, const char *bus, uint8_t addr){
+    dev->addr = addr;
+    if((dev->fd = open(bus, O_RDWR)) < 0){
+        return -1;
+    }
+    if(ioctl(dev->fd, I2C_SLAVE, addr) < 0){
+        close(dev->fd);
+        dev->fd = -1;
+        return -2;
+    }
+    return 0;
+}
+
+static void i2cClose(struct hal_i2c_dev *dev){
+    if(dev->fd >= 0){
+        close(dev->fd);
+    }
+    dev->fd = -1;
+}
+
+static int8_t i2cRead(uint8_t reg, uint8_t *data, uint32_t len, void *intf_ptr){
+    struct hal_i2c_dev *dev = intf_ptr;
+    if(write(dev->fd, &reg, 1) != 1 || read(dev->fd, data, len) != (ssize_t) len){
+        return BME280_E_COMM_FAIL;
+    }
+    return BME280_OK;
+}
+
+static int8_t i2cWrite(uint8_t reg, const uint8_t *data, uint32_t len, void *intf_ptr){
+    struct hal_i2c_dev *dev = intf_ptr;
+    uint8_t *buf = malloc(len + 1);
+    if(!buf){
+        return BME280_E_COMM_FAIL;
+    }
+    buf[0] = reg;
+    memcpy(buf + 1, data, len);
+    ssize_t res = write(dev->fd, buf, len + 1);
+    free(buf);
+    return res == (ssize_t) len + 1 ? BME280_OK : BME280_E_COMM_FAIL;
+}
+
+static void delayUs(uint32_t period, void *intf_ptr){
+    usleep(period);
+}
+
+static const struct hal_gpio gpio = { gpioInit, gpioSetOutput, gpioWriteMask, gpioClose };
+static const struct hal_lcd lcd = { lcdInit, lcdWriteLine };
+static const struct hal_uart uart = { getTI, getTR };
+static const struct hal_i2c i2c = { i2cOpen, i2cClose, i2cRead, i2cWrite, delayUs };
+
+const struct hal hal_real = { "real", &gpio, &lcd, &uart, &i2c };
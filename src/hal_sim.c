@@ -0,0 +1,362 @@
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#include <hal.h>
+#include <hal_sim.h>
+#include <plant.h>
+#include <vclock.h>
+#include <bme280_defs.h>
+
+// Simulated chamber: the GPIO levels drive the plant, the UART returns its
+// temperature and the I2C bus answers as a BME280 measuring the ambient.
+// Extra chambers (zones) have their own plant, pin pair and a BME280 that
+// measures the chamber. The plants are advanced lazily, up to
+// vclock_now_ns, on every access.
+
+#define SIM_STEP_NS 100000000LL // plant integration step
+
+// BME280 register file
+#define REG_CALIB_TP 0x88
+#define REG_CHIP_ID 0xD0
+#define REG_RESET 0xE0
+#define REG_CALIB_H 0xE1
+#define REG_STATUS 0xF3
+#define REG_CTRL_MEAS 0xF4
+#define REG_DATA 0xF7
+
+// Datasheet example calibration
+static const uint16_t DIG_T1 = 27504;
+static const int16_t DIG_T2 = 26435;
+static const int16_t DIG_T3 = -1000;
+static const uint8_t CALIB_P[18] = {
+    0x7D, 0x8E, 0x43, 0xD6, 0xD0, 0x0B, 0x27, 0x0B, 0x8C, 0x00,
+    0xF9, 0xFF, 0x8C, 0x3C, 0xF8, 0xC6, 0x70, 0x17
+};
+static const uint8_t CALIB_H[7] = { 0x6A, 0x01, 0x00, 0x14, 0x04, 0x00, 0x1E };
+static const uint32_t RAW_PRESSURE = 415148;
+static const uint16_t RAW_HUMIDITY = 30000;
+
+static pthread_mutex_t sim_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static struct plant_model model;
+static bool model_set = false;
+static float potentiometer = HAL_SIM_DEFAULT_POTENTIOMETER;
+static uint64_t seed = 1;
+
+// Chamber 0 is the main one: TI on the UART, its BME280 measures the ambient
+struct chamber {
+    char bus[64];
+    uint8_t addr;
+    uint8_t heater_pin;
+    uint8_t fan_pin;
+    struct plant plant;
+    bool ready;
+    int64_t advanced_ns;
+    int64_t step_start_ns;
+    int64_t on_ns[2];
+    uint8_t regs[256]; // BME280 register file
+};
+
+static struct chamber chambers[HAL_SIM_MAX_CHAMBERS] = {
+    { .addr = BME280_I2C_ADDR_PRIM, .heater_pin = HAL_HEATER_PIN, .fan_pin = HAL_FAN_PIN },
+};
+static int chamber_count = 1;
+static uint32_t levels = 0xFFFFFFFF; // all outputs high (off)
+static void (*write_hook)(uint32_t value, uint32_t mask) = NULL;
+
+static char lcd[2][HAL_LCD_COLS + 1];
+
+void hal_sim_configure(const struct plant_model *m, float tr, uint64_t rng_seed){
+    pthread_mutex_lock(&sim_lock);
+    if(m){
+        model = *m;
+        model_set = true;
+    }
+    potentiometer = tr;
+    seed = rng_seed;
+    pthread_mutex_unlock(&sim_lock);
+}
+
+int hal_sim_add_chamber(const char *bus, uint8_t addr, uint8_t heater_pin, uint8_t fan_pin){
+    int res = -1;
+    pthread_mutex_lock(&sim_lock);
+    if(chamber_count < HAL_SIM_MAX_CHAMBERS && strlen(bus) < sizeof(chambers[0].bus)){
+        struct chamber *c = &chambers[chamber_count++];
+        memset(c, 0, sizeof(*c));
+        strcpy(c->bus, bus);
+        c->addr = addr;
+        c->heater_pin = heater_pin;
+        c->fan_pin = fan_pin;
+        res = 0;
+    }
+    pthread_mutex_unlock(&sim_lock);
+    return res;
+}
+
+void hal_sim_set_potentiometer(float tr){
+    pthread_mutex_lock(&sim_lock);
+    potentiometer = tr;
+    pthread_mutex_unlock(&sim_lock);
+}
+
+void hal_sim_set_write_hook(void (*hook)(uint32_t value, uint32_t mask)){
+    pthread_mutex_lock(&sim_lock);
+    write_hook = hook;
+    pthread_mutex_unlock(&sim_lock);
+}
+
+static bool pinOn(int pin){
+    return !(levels & (1u << pin)); // active low
+}
+
+// Integrates the outputs since the last access, stepping the plant on each
+// SIM_STEP_NS boundary with the fraction of the step each output was on
+static void advanceChamber(struct chamber *c, int index, int64_t now){
+    if(!c->ready){
+        if(!model_set){
+            plant_model_defaults(&model);
+        }
+        if(plant_init(&c->plant, &model, SIM_STEP_NS / 1e9f, seed + index)){
+            return;
+        }
+        c->advanced_ns = c->step_start_ns = now;
+        c->on_ns[0] = c->on_ns[1] = 0;
+        c->ready = true;
+    }
+    while(c->advanced_ns < now){
+        int64_t step_end = c->step_start_ns + SIM_STEP_NS;
+        int64_t upto = now < step_end ? now : step_end;
+        if(pinOn(c->heater_pin)){
+            c->on_ns[0] += upto - c->advanced_ns;
+        }
+        if(pinOn(c->fan_pin)){
+            c->on_ns[1] += upto - c->advanced_ns;
+        }
+        c->advanced_ns = upto;
+        if(upto == step_end){
+            plant_step(&c->plant, (float) c->on_ns[0] / SIM_STEP_NS, (float) c->on_ns[1] / SIM_STEP_NS);
+            c->on_ns[0] = c->on_ns[1] = 0;
+            c->step_start_ns = step_end;
+        }
+    }
+}
+
+// Every chamber: a GPIO write may change any of their pins
+static void advance(void){
+    int64_t now = vclock_now_ns();
+    for(int i = 0; i < chamber_count; i++){
+        advanceChamber(&chambers[i], i, now);
+    }
+}
+
+bool hal_sim_temperatures(float *chamber, float *ambient){
+    pthread_mutex_lock(&sim_lock);
+    advance();
+    struct plant *plant = &chambers[0].plant;
+    bool ready = chambers[0].ready;
+    if(ready){
+        *chamber = plant->temp;
+        *ambient = plant_ambient(plant);
+    }
+    pthread_mutex_unlock(&sim_lock);
+    return ready;
+}
+
+void hal_sim_lcd_line(int line, char *out){
+    pthread_mutex_lock(&sim_lock);
+    strcpy(out, lcd[line ? 1 : 0]);
+    pthread_mutex_unlock(&sim_lock);
+}
+
+// GPIO ---------------------------------------------------------------------
+
+static int gpioInit(void){
+    return 0;
+}
+
+static void gpioSetOutput(uint8_t pin){
+}
+
+static void gpioWriteMask(uint32_t value, uint32_t mask){
+    pthread_mutex_lock(&sim_lock);
+    advance();
+    levels = (levels & ~mask) | (value & mask);
+    void (*hook)(uint32_t, uint32_t) = write_hook;
+    pthread_mutex_unlock(&sim_lock);
+    if(hook){
+        hook(value, mask);
+    }
+}
+
+static void gpioClose(void){
+}
+
+// LCD ----------------------------------------------------------------------
+
+static int lcdInit(void){
+    memset(lcd, 0, sizeof(lcd));
+    return 0;
+}
+
+static void lcdWriteLine(int line, const char *text){
+    pthread_mutex_lock(&sim_lock);
+    strncpy(lcd[line ? 1 : 0], text, HAL_LCD_COLS);
+    pthread_mutex_unlock(&sim_lock);
+}
+
+// UART ---------------------------------------------------------------------
+
+static int readTI(float *ti){
+    pthread_mutex_lock(&sim_lock);
+    advance();
+    int res = chambers[0].ready ? 0 : -1;
+    if(chambers[0].ready){
+        *ti = plant_measure(&chambers[0].plant);
+    }
+    pthread_mutex_unlock(&sim_lock);
+    return res;
+}
+
+static int readTR(float *tr){
+    pthread_mutex_lock(&sim_lock);
+    *tr = potentiometer;
+    pthread_mutex_unlock(&sim_lock);
+    return 0;
+}
+
+// I2C (BME280) -------------------------------------------------------------
+
+static double compensate(uint32_t adc){
+    double var1 = (adc / 16384.0 - DIG_T1 / 1024.0) * DIG_T2;
+    double var2 = adc / 131072.0 - DIG_T1 / 8192.0;
+    var2 = var2 * var2 * DIG_T3;
+    return (var1 + var2) / 5120.0;
+}
+
+// Raw 20-bit reading that the driver compensates back to temp
+static uint32_t rawTemperature(double temp){
+    uint32_t lo = 0, hi = (1u << 20) - 1;
+    while(lo < hi){
+        uint32_t mid = lo + (hi - lo) / 2;
+        if(compensate(mid) < temp){
+            lo = mid + 1;
+        }else{
+            hi = mid;
+        }
+    }
+    return lo;
+}
+
+static void resetRegs(uint8_t *regs){
+    memset(regs, 0, 256);
+    regs[REG_CHIP_ID] = BME280_CHIP_ID;
+    regs[REG_CALIB_TP] = DIG_T1 & 0xFF;
+    regs[REG_CALIB_TP + 1] = DIG_T1 >> 8;
+    regs[REG_CALIB_TP + 2] = (uint16_t) DIG_T2 & 0xFF;
+    regs[REG_CALIB_TP + 3] = (uint16_t) DIG_T2 >> 8;
+    regs[REG_CALIB_TP + 4] = (uint16_t) DIG_T3 & 0xFF;
+    regs[REG_CALIB_TP + 5] = (uint16_t) DIG_T3 >> 8;
+    memcpy(&regs[REG_CALIB_TP + 6], CALIB_P, sizeof(CALIB_P));
+    regs[0xA1] = 0x4B; // dig_h1
+    memcpy(&regs[REG_CALIB_H], CALIB_H, sizeof(CALIB_H));
+}
+
+// Forced conversion: latch the ambient temperature (main chamber) or the
+// measured chamber temperature (zones), back to sleep mode
+static void measure(struct chamber *c){
+    uint8_t *regs = c->regs;
+    advance();
+    double temp = 25;
+    if(c->ready){
+        temp = c == &chambers[0] ? plant_ambient(&c->plant) : plant_measure(&c->plant);
+    }
+    uint32_t t = rawTemperature(temp);
+    regs[REG_DATA] = RAW_PRESSURE >> 12;
+    regs[REG_DATA + 1] = (RAW_PRESSURE >> 4) & 0xFF;
+    regs[REG_DATA + 2] = (RAW_PRESSURE & 0x0F) << 4;
+    regs[REG_DATA + 3] = t >> 12;
+    regs[REG_DATA + 4] = (t >> 4) & 0xFF;
+    regs[REG_DATA + 5] = (t & 0x0F) << 4;
+    regs[REG_DATA + 6] = RAW_HUMIDITY >> 8;
+    regs[REG_DATA + 7] = RAW_HUMIDITY & 0xFF;
+    regs[REG_CTRL_MEAS] &= ~0x03;
+}
+
+static void writeReg(struct chamber *c, uint8_t reg, uint8_t value){
+    if(reg == REG_RESET){
+        if(value == BME280_SOFT_RESET_COMMAND){
+            resetRegs(c->regs);
+        }
+        return;
+    }
+    c->regs[reg] = value;
+    if(reg == REG_CTRL_MEAS && (value & 0x03) == 0x01){
+        measure(c);
+    }
+}
+
+// The device handle keeps the chamber index in place of a file descriptor
+static int i2cOpen(struct hal_i2c_dev *dev, const char *bus, uint8_t addr){
+    dev->fd = -1;
+    dev->addr = addr;
+    pthread_mutex_lock(&sim_lock);
+    for(int i = 1; i < chamber_count; i++){
+        if(chambers[i].addr == addr && !strcmp(chambers[i].bus, bus)){
+            dev->fd = i;
+        }
+    }
+    if(dev->fd < 0 && addr == BME280_I2C_ADDR_PRIM){
+        dev->fd = 0;
+    }
+    if(dev->fd >= 0){
+        resetRegs(chambers[dev->fd].regs);
+    }
+    pthread_mutex_unlock(&sim_lock);
+    return dev->fd >= 0 ? 0 : -2;
+}
+
+// The "fd" is only the chamber index
+static void i2cClose(struct hal_i2c_dev *dev){
+    dev->fd = -1;
+}
+
+static int8_t i2cRead(uint8_t reg, uint8_t *data, uint32_t len, void *intf_ptr){
+    const struct hal_i2c_dev *dev = intf_ptr;
+    pthread_mutex_lock(&sim_lock);
+    const uint8_t *regs = chambers[dev->fd].regs;
+    for(uint32_t i = 0; i < len; i++){
+        data[i] = regs[(uint8_t) (reg + i)];
+    }
+    pthread_mutex_unlock(&sim_lock);
+    return BME280_OK;
+}
+
+// Burst writes from the driver are interleaved: value, (address, value)...
+static int8_t i2cWrite(uint8_t reg, const uint8_t *data, uint32_t len, void *intf_ptr){
+    const struct hal_i2c_dev *dev = intf_ptr;
+    pthread_mutex_lock(&sim_lock);
+    struct chamber *c = &chambers[dev->fd];
+    if(len > 0){
+        writeReg(c, reg, data[0]);
+    }
+    for(uint32_t i = 1; i + 1 < len; i += 2){
+        writeReg(c, data[i], data[i + 1]);
+    }
+    pthread_mutex_unlock(&sim_lock);
+    return BME280_OK;
+}
+
+static void delayUs(uint32_t period, void *intf_ptr){
+    // Conversions complete instantly on the simulated bus
+    if(!vclock_is_virtual() && period > 1000){
+        usleep(1000);
+    }
+}
+
+static const struct hal_gpio gpio = { gpioInit, gpioSetOutput, gpioWriteMask, gpioClose };
+static const struct hal_lcd lcd_ops = { lcdInit, lcdWriteLine };
+static const struct hal_uart uart = { readTI, readTR };
+static const struct hal_i2c i2c = { i2cOpen, i2cClose, i2cRead, i2cWrite, delayUs };
+
+const struct hal hal_sim = { "sim", &gpio, &lcd_ops, &uart, &i2c };
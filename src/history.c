@@ -0,0 +1,364 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stddef.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <time.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include <history.h>
+
+struct history_header {
+    uint64_t magic;
+    uint32_t version;
+    uint32_t record_size;
+    uint32_t capacity;
+    uint32_t head_hint; // slot of the newest record, only a hint
+    uint64_t reserved[5];
+};
+
+static int fd = -1;
+static size_t map_size = 0;
+static struct history_header *header = NULL;
+static struct history_record *slots = NULL;
+
+static uint32_t capacity = 0;
+static uint32_t head = 0; // slot of the newest record
+static uint32_t count = 0;
+static uint64_t next_seq = 1;
+// Newest record stamped before the one ahead of it (the wall clock was set
+// back), 0 if none; found by a scan on the first query after history_open
+static uint64_t backstep_seq = 0;
+static bool backstep_known = false;
+
+// Slots touched since the last history_sync
+static uint32_t dirty_first = 0;
+static uint32_t dirty_count = 0;
+
+static pthread_mutex_t history_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static uint32_t crc_table[256];
+
+static void crcInit(void){
+    for(uint32_t i = 0; i < 256; i++){
+        uint32_t c = i;
+        for(int k = 0; k < 8; k++){
+            c = (c & 1) ? 0xEDB88320U ^ (c >> 1) : c >> 1;
+        }
+        crc_table[i] = c;
+    }
+}
+
+static uint32_t recordCrc(const struct history_record *rec){
+    const uint8_t *p = (const uint8_t *) rec;
+    uint32_t c = 0xFFFFFFFFU;
+    for(size_t i = 0; i < offsetof(struct history_record, crc); i++){
+        c = crc_table[(c ^ p[i]) & 0xFF] ^ (c >> 8);
+    }
+    return c ^ 0xFFFFFFFFU;
+}
+
+static bool isValid(const struct history_record *rec){
+    return rec->seq != 0 && rec->crc == recordCrc(rec);
+}
+
+int64_t history_now_ms(void){
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    return (int64_t) ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+static void formatFile(void){
+    memset(header, 0, sizeof(*header));
+    memset(slots, 0, (size_t) capacity * sizeof(struct history_record));
+    header->version = HISTORY_VERSION;
+    header->record_size = sizeof(struct history_record);
+    header->capacity = capacity;
+    header->head_hint = 0;
+    // Magic last, so a half formatted file is formatted again
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    header->magic = HISTORY_MAGIC;
+    msync(header, map_size, MS_SYNC);
+}
+
+static void findHead(void){
+    // Fast path: trust the hint when the slot after it is older or empty
+    uint32_t h = header->head_hint;
+    if(h < capacity && isValid(&slots[h])){
+        const struct history_record *after = &slots[(h + 1) % capacity];
+        if(!isValid(after) || after->seq < slots[h].seq){
+            head = h;
+            next_seq = slots[h].seq + 1;
+            count = slots[h].seq < capacity ? (uint32_t) slots[h].seq : capacity;
+            return;
+        }
+    }
+
+    // Slow path: full scan for the highest valid sequence number
+    uint64_t best = 0;
+    head = capacity - 1;
+    for(uint32_t i = 0; i < capacity; i++){
+        if(isValid(&slots[i]) && slots[i].seq > best){
+            best = slots[i].seq;
+            head = i;
+        }
+    }
+    next_seq = best + 1;
+    count = best < capacity ? (uint32_t) best : capacity;
+}
+
+static int compareSeq(const void *a, const void *b){
+    uint64_t x = ((const struct history_record *) a)->seq, y = ((const struct history_record *) b)->seq;
+    return x < y ? -1 : x > y;
+}
+
+// Valid records of a ring written with another capacity, oldest first, at
+// most keep of the newest. Returns the number read, 0 if the file is not a
+// ring of this layout (*old_capacity = 0) or the copy failed
+static uint32_t readOldRing(uint32_t keep, struct history_record **out, uint32_t *old_capacity){
+    struct history_header old;
+    *old_capacity = 0;
+    *out = NULL;
+    if(pread(fd, &old, sizeof(old), 0) != (ssize_t) sizeof(old) || old.magic != HISTORY_MAGIC
+        || old.version != HISTORY_VERSION || old.record_size != sizeof(struct history_record) || old.capacity == 0){
+        return 0;
+    }
+    *old_capacity = old.capacity;
+    size_t size = (size_t) old.capacity * sizeof(struct history_record);
+    struct history_record *recs = malloc(size);
+    if(!recs || pread(fd, recs, size, sizeof(old)) != (ssize_t) size){
+        free(recs);
+        return 0;
+    }
+    uint32_t valid = 0;
+    for(uint32_t i = 0; i < old.capacity; i++){
+        if(isValid(&recs[i])){
+            recs[valid++] = recs[i];
+        }
+    }
+    qsort(recs, valid, sizeof(*recs), compareSeq);
+    uint32_t first = valid > keep ? valid - keep : 0;
+    memmove(recs, recs + first, (size_t) (valid - first) * sizeof(*recs));
+    *out = recs;
+    return valid - first;
+}
+
+int history_open(const char *path, uint32_t n){
+    if(n == 0){
+        return -1;
+    }
+    crcInit();
+
+    fd = open(path, O_RDWR | O_CREAT, 0644);
+    if(fd < 0){
+        return -1;
+    }
+
+    capacity = n;
+    map_size = sizeof(struct history_header) + (size_t) capacity * sizeof(struct history_record);
+
+    struct stat st;
+    if(fstat(fd, &st) < 0){
+        close(fd);
+        fd = -1;
+        return -1;
+    }
+    bool fresh = (size_t) st.st_size != map_size;
+    // Another ring size: keep the newest records instead of erasing them
+    struct history_record *migrated = NULL;
+    uint32_t migrated_count = 0, old_capacity = 0;
+    if(fresh && st.st_size > 0){
+        migrated_count = readOldRing(capacity, &migrated, &old_capacity);
+        if(old_capacity){
+            fprintf(stderr, "Histórico %s: capacidade %u -> %u registros, %u mantidos\n",
+                path, old_capacity, capacity, migrated_count);
+        }else{
+            fprintf(stderr, "Histórico %s inválido, recriado\n", path);
+        }
+    }
+    if(fresh && ftruncate(fd, map_size) < 0){
+        free(migrated);
+        close(fd);
+        fd = -1;
+        return -1;
+    }
+
+    void *map = mmap(NULL, map_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if(map == MAP_FAILED){
+        free(migrated);
+        close(fd);
+        fd = -1;
+        return -1;
+    }
+    header = (struct history_header *) map;
+    slots = (struct history_record *) (header + 1);
+
+    if(fresh || header->magic != HISTORY_MAGIC || header->version != HISTORY_VERSION
+        || header->record_size != sizeof(struct history_record) || header->capacity != capacity){
+        if(!fresh){
+            fprintf(stderr, "Histórico %s inválido, recriado\n", path);
+        }
+        formatFile();
+    }
+    // Oldest first from slot 0, renumbered so count follows the sequence
+    for(uint32_t i = 0; i < migrated_count; i++){
+        struct history_record *rec = &slots[i];
+        *rec = migrated[i];
+        rec->seq = i + 1;
+        rec->crc = recordCrc(rec);
+    }
+    if(migrated_count){
+        header->head_hint = migrated_count - 1;
+        msync(header, map_size, MS_SYNC);
+    }
+    free(migrated);
+
+    findHead();
+    backstep_seq = 0;
+    backstep_known = false;
+    return 0;
+}
+
+void history_close(void){
+    if(!header){
+        return;
+    }
+    history_sync();
+    pthread_mutex_lock(&history_lock);
+    munmap(header, map_size);
+    close(fd);
+    header = NULL;
+    slots = NULL;
+    fd = -1;
+    pthread_mutex_unlock(&history_lock);
+}
+
+int history_append(struct history_record *rec){
+    pthread_mutex_lock(&history_lock);
+    if(!slots){
+        pthread_mutex_unlock(&history_lock);
+        return -1;
+    }
+    uint32_t slot = (head + 1) % capacity;
+    struct history_record *dst = &slots[slot];
+
+    rec->seq = next_seq;
+    rec->reserved = 0;
+    rec->crc = recordCrc(rec);
+    if(count && rec->ts_ms < slots[head].ts_ms){
+        backstep_seq = rec->seq;
+    }
+
+    // Invalidate, write payload, then publish the sequence number
+    __atomic_store_n(&dst->seq, 0, __ATOMIC_RELEASE);
+    memcpy((uint8_t *) dst + sizeof(dst->seq), (const uint8_t *) rec + sizeof(rec->seq),
+        sizeof(*rec) - sizeof(rec->seq));
+    __atomic_store_n(&dst->seq, rec->seq, __ATOMIC_RELEASE);
+    header->head_hint = slot;
+
+    head = slot;
+    next_seq++;
+    if(count < capacity){
+        count++;
+    }
+    if(dirty_count == 0){
+        dirty_first = slot;
+    }
+    if(dirty_count < capacity){
+        dirty_count++;
+    }
+    pthread_mutex_unlock(&history_lock);
+    return 0;
+}
+
+static void syncRange(uint32_t first, uint32_t n){
+    long page = sysconf(_SC_PAGESIZE);
+    uintptr_t start = (uintptr_t) &slots[first];
+    uintptr_t end = (uintptr_t) &slots[first + n];
+    start &= ~((uintptr_t) page - 1);
+    msync((void *) start, end - start, MS_SYNC);
+}
+
+void history_sync(void){
+    // msync runs outside the lock so appends are never held up by the disk
+    pthread_mutex_lock(&history_lock);
+    uint32_t first = dirty_first, n = dirty_count;
+    dirty_count = 0;
+    pthread_mutex_unlock(&history_lock);
+
+    if(slots && n){
+        if(first + n <= capacity){
+            syncRange(first, n);
+        }else{
+            syncRange(first, capacity - first);
+            syncRange(0, first + n - capacity);
+        }
+        // Header holds the head hint
+        msync(header, sizeof(*header), MS_ASYNC);
+    }
+}
+
+bool history_last(struct history_record *rec){
+    bool found = false;
+    pthread_mutex_lock(&history_lock);
+    if(slots && count && isValid(&slots[head])){
+        *rec = slots[head];
+        found = true;
+    }
+    pthread_mutex_unlock(&history_lock);
+    return found;
+}
+
+uint32_t history_count(void){
+    pthread_mutex_lock(&history_lock);
+    uint32_t n = count;
+    pthread_mutex_unlock(&history_lock);
+    return n;
+}
+
+static void findBackstep(uint32_t oldest){
+    for(uint32_t i = 1; i < count; i++){
+        const struct history_record *rec = &slots[(oldest + i) % capacity];
+        if(rec->ts_ms < slots[(oldest + i - 1) % capacity].ts_ms){
+            backstep_seq = rec->seq;
+        }
+    }
+    backstep_known = true;
+}
+
+uint32_t history_foreach(int64_t since_ms, history_cb cb, void *ctx){
+    uint32_t visited = 0;
+    pthread_mutex_lock(&history_lock);
+    if(slots){
+        uint32_t oldest = (head + capacity + 1 - count) % capacity;
+        if(!backstep_known){
+            findBackstep(oldest);
+        }
+        // Timestamps grow with the slot order unless the clock went back
+        // within the ring: then every record is checked. Otherwise skip the
+        // older records by bisection
+        uint32_t lo = 0, hi = backstep_seq > slots[head].seq - count + 1 ? 0 : count;
+        while(lo < hi){
+            uint32_t mid = lo + (hi - lo) / 2;
+            if(slots[(oldest + mid) % capacity].ts_ms < since_ms){
+                lo = mid + 1;
+            }else{
+                hi = mid;
+            }
+        }
+        uint32_t slot = (oldest + lo) % capacity;
+        for(uint32_t i = lo; i < count; i++){
+            const struct history_record *rec = &slots[slot];
+            if(isValid(rec) && rec->ts_ms >= since_ms){
+                cb(rec, ctx);
+                visited++;
+            }
+            slot = (slot + 1) % capacity;
+        }
+    }
+    pthread_mutex_unlock(&history_lock);
+    return visited;
+}
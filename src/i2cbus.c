@@ -0,0 +1,57 @@
+#include <string.h>
+#include <time.h>
+
+#include <i2cbus.h>
+
+static pthread_mutex_t buses_lock = PTHREAD_MUTEX_INITIALIZER;
+static struct i2c_bus buses[I2C_BUS_MAX];
+static int bus_count = 0;
+
+static int64_t monotonicNs(void){
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t) ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+struct i2c_bus *i2c_bus_get(const char *path){
+    struct i2c_bus *bus = NULL;
+    pthread_mutex_lock(&buses_lock);
+    for(int i = 0; i < bus_count; i++){
+        if(!strcmp(buses[i].path, path)){
+            bus = &buses[i];
+        }
+    }
+    if(!bus && bus_count < I2C_BUS_MAX && strlen(path) < I2C_BUS_PATH_MAX){
+        bus = &buses[bus_count++];
+        memset(bus, 0, sizeof(*bus));
+        strcpy(bus->path, path);
+        pthread_mutex_init(&bus->lock, NULL);
+        pthread_cond_init(&bus->turn, NULL);
+    }
+    pthread_mutex_unlock(&buses_lock);
+    return bus;
+}
+
+int64_t i2c_bus_acquire(struct i2c_bus *bus){
+    int64_t start = monotonicNs();
+    pthread_mutex_lock(&bus->lock);
+    uint64_t ticket = bus->next++;
+    while(bus->serving != ticket){
+        pthread_cond_wait(&bus->turn, &bus->lock);
+    }
+    int64_t waited = monotonicNs() - start;
+    bus->acquisitions++;
+    bus->wait_sum_ns += waited;
+    if(waited > bus->wait_max_ns){
+        bus->wait_max_ns = waited;
+    }
+    pthread_mutex_unlock(&bus->lock);
+    return waited;
+}
+
+void i2c_bus_release(struct i2c_bus *bus){
+    pthread_mutex_lock(&bus->lock);
+    bus->serving++;
+    pthread_cond_broadcast(&bus->turn);
+    pthread_mutex_unlock(&bus->lock);
+}
@@ -2,6 +2,7 @@
 #include <wiringPi.h>
 
 #include <i2clcd.h>
+#include <lcd_encode.h>
 
 int fd;  // seen by all subroutines
 
@@ -49,19 +50,16 @@ void lcd_byte(int bits, int mode)   {
   //Send byte to data pins
   // bits = the data
   // mode = 1 for data, 0 for command
-  int bits_high;
-  int bits_low;
-  // uses the two half byte writes to LCD
-  bits_high = mode | (bits & 0xF0) | LCD_BACKLIGHT ;
-  bits_low = mode | ((bits << 4) & 0xF0) | LCD_BACKLIGHT ;
-
-  // High bits
-  wiringPiI2CReadReg8(fd, bits_high);
-  lcd_toggle_enable(bits_high);
-
-  // Low bits
-  wiringPiI2CReadReg8(fd, bits_low);
-  lcd_toggle_enable(bits_low);
+  // uses the two half byte writes to LCD (see lcd_encode.c)
+  uint8_t writes[LCD_WRITES_PER_BYTE];
+  lcd_encode_byte(bits, mode, writes);
+
+  // High bits, then low bits: plain write followed by the enable toggle
+  for (int i = 0; i < LCD_WRITES_PER_BYTE; i++)   {
+    if (i % 3) delayMicroseconds(500);
+    wiringPiI2CReadReg8(fd, writes[i]);
+    if (i % 3 == 2) delayMicroseconds(500);
+  }
 }
 
 void lcd_toggle_enable(int bits)   {
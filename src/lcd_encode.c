@@ -0,0 +1,23 @@
+#include <lcd_encode.h>
+
+void lcd_encode_byte(int bits, int mode, uint8_t out[LCD_WRITES_PER_BYTE]){
+    uint8_t high = mode | (bits & 0xF0) | LCD_BACKLIGHT;
+    uint8_t low = mode | ((bits << 4) & 0xF0) | LCD_BACKLIGHT;
+    out[0] = high;
+    out[1] = high | ENABLE;
+    out[2] = high & ~ENABLE;
+    out[3] = low;
+    out[4] = low | ENABLE;
+    out[5] = low & ~ENABLE;
+}
+
+size_t lcd_encode_line(int line, const char *text, uint8_t *out){
+    size_t n = 0;
+    lcd_encode_byte(line, LCD_CMD, out);
+    n += LCD_WRITES_PER_BYTE;
+    while(*text){
+        lcd_encode_byte(*(text++), LCD_CHR, out + n);
+        n += LCD_WRITES_PER_BYTE;
+    }
+    return n;
+}
@@ -0,0 +1,344 @@
+#include <stdio.h>
+#include <pthread.h>
+
+#include <logger.h>
+#include <gorilla.h>
+
+static const char CSV_HEADER[] = "Temperatura referência (oC), Temperatura interna (oC), Temperatura externa (oC), Data e Hora\n";
+static const char EVENTS_HEADER[] = "Estado, Resistor, Ventilador, Data e Hora\n";
+static const char METRICS_HEADER[] = "Modo, Sombra, Referência (oC), Inicial (oC), Duração (s), Sobressinal (oC), Acomodação (s), "
+    "IAE (oC.s), ISE (oC2.s), Dentro da faixa (%), Comutações por hora, Resistor (%), Ventoinha (%), Data e Hora\n";
+
+static struct log_record queue[LOG_QUEUE_SIZE];
+static unsigned int queue_head = 0; // next slot to read
+static unsigned int queue_count = 0;
+
+static struct log_stats stats;
+
+static pthread_mutex_t queue_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t queue_ready = PTHREAD_COND_INITIALIZER;
+
+static pthread_t writer_thread;
+static bool writer_running = false;
+
+struct log_stream {
+    FILE *data;
+    FILE *events;
+};
+// Stream 0 is data.csv/events.csv; the count only grows while running
+static struct log_stream streams[LOG_MAX_STREAMS];
+static int stream_count = 0;
+static FILE *compressed_file = NULL;
+static FILE *metrics_file = NULL;
+
+// Samples are also encoded into compressed blocks (TR, TI, TE)
+static struct gorilla_encoder encoder;
+
+static FILE *openLog(const char *path, const char *header){
+    FILE *arq = fopen(path, "a");
+    if(!arq){
+        return NULL;
+    }
+    // New (empty) file gets the header
+    if(ftell(arq) == 0){
+        fputs(header, arq);
+        fflush(arq);
+    }
+    return arq;
+}
+
+static bool push(const struct log_record *rec){
+    bool accepted = false;
+    pthread_mutex_lock(&queue_lock);
+    if(queue_count < LOG_QUEUE_SIZE){
+        queue[(queue_head + queue_count) % LOG_QUEUE_SIZE] = *rec;
+        queue_count++;
+        accepted = true;
+        if(queue_count >= LOG_BATCH_SIZE){
+            pthread_cond_signal(&queue_ready);
+        }
+    }else if(rec->type != LOG_REC_SAMPLE){
+        stats.events_dropped++;
+    }else{
+        stats.samples_dropped++;
+    }
+    pthread_mutex_unlock(&queue_lock);
+    return accepted;
+}
+
+bool logger_push_stream_sample(int stream, float reference_temp, float intern_temp, float extern_temp){
+    struct log_record rec;
+    rec.type = LOG_REC_SAMPLE;
+    rec.stream = stream;
+    clock_gettime(CLOCK_REALTIME, &rec.ts);
+    rec.reference_temp = reference_temp;
+    rec.intern_temp = intern_temp;
+    rec.extern_temp = extern_temp;
+    return push(&rec);
+}
+
+bool logger_push_stream_event(int stream, int state, int resistor, int fan){
+    struct log_record rec;
+    rec.type = LOG_REC_EVENT;
+    rec.stream = stream;
+    clock_gettime(CLOCK_REALTIME, &rec.ts);
+    rec.state = state;
+    rec.resistor = resistor;
+    rec.fan = fan;
+    return push(&rec);
+}
+
+bool logger_push_sample(float reference_temp, float intern_temp, float extern_temp){
+    return logger_push_stream_sample(0, reference_temp, intern_temp, extern_temp);
+}
+
+bool logger_push_event(int state, int resistor, int fan){
+    return logger_push_stream_event(0, state, resistor, fan);
+}
+
+bool logger_push_metrics(int mode, int shadow, const struct metrics_report *report){
+    struct log_record rec;
+    if(!metrics_file){
+        return false;
+    }
+    rec.type = LOG_REC_METRICS;
+    rec.stream = 0;
+    clock_gettime(CLOCK_REALTIME, &rec.ts);
+    rec.mode = mode;
+    rec.shadow = shadow;
+    rec.metrics = *report;
+    return push(&rec);
+}
+
+static void writeBlock(void){
+    const uint8_t *block;
+    size_t len = gorilla_finish(&encoder, &block);
+    if(encoder.count){
+        fwrite(block, 1, len, compressed_file);
+        fflush(compressed_file);
+    }
+    gorilla_encoder_init(&encoder, 3);
+}
+
+static void encodeSample(const struct log_record *rec){
+    float values[3] = { rec->reference_temp, rec->intern_temp, rec->extern_temp };
+    int64_t ts_ms = (int64_t) rec->ts.tv_sec * 1000 + rec->ts.tv_nsec / 1000000;
+    if(!gorilla_encode(&encoder, ts_ms, values)){
+        writeBlock();
+        gorilla_encode(&encoder, ts_ms, values);
+    }
+}
+
+size_t logger_format_record(char *buf, size_t len, const struct log_record *rec){
+    struct tm timeinfo;
+    char date[32];
+    int n;
+    localtime_r(&rec->ts.tv_sec, &timeinfo);
+    asctime_r(&timeinfo, date);
+
+    if(rec->type == LOG_REC_EVENT){
+        n = snprintf(buf, len, "%d, %d, %d, %s", rec->state, rec->resistor, rec->fan, date);
+    }else if(rec->type == LOG_REC_METRICS){
+        const struct metrics_report *r = &rec->metrics;
+        n = snprintf(buf, len, "%d, %d, %0.2lf, %0.2lf, %0.0lf, %0.2lf, %0.0lf, %0.1lf, %0.1lf, %0.1lf, %0.1lf, %0.1lf, %0.1lf, %s",
+            rec->mode, rec->shadow, r->reference, r->from, r->duration_s, r->overshoot, r->settling_s, r->iae, r->ise,
+            r->in_band * 100, r->switches_per_hour, r->heater_duty * 100, r->fan_duty * 100, date);
+    }else{
+        n = snprintf(buf, len, "%0.2lf, %0.2lf, %0.2lf, %s",
+            rec->reference_temp, rec->intern_temp, rec->extern_temp, date);
+    }
+    if(n < 0){
+        return 0;
+    }
+    return (size_t)n < len ? (size_t)n : (len ? len - 1 : 0);
+}
+
+static void writeBatch(const struct log_record *batch, unsigned int n){
+    // Rows are formatted into one buffer per file and written with a single
+    // fwrite, one pass per stream present in the batch
+    static char data_buf[LOG_BATCH_SIZE * 128];
+    static char events_buf[LOG_BATCH_SIZE * 128];
+    static char metrics_buf[LOG_BATCH_SIZE * 160];
+    size_t metrics_len = 0;
+    unsigned int samples = 0, events = 0, steps = 0;
+    uint32_t pending = 0;
+
+    for(unsigned int i = 0; i < n; i++){
+        pending |= 1u << batch[i].stream;
+    }
+    for(int s = 0; pending; s++){
+        if(!(pending & (1u << s))){
+            continue;
+        }
+        pending &= ~(1u << s);
+        size_t data_len = 0, events_len = 0;
+        for(unsigned int i = 0; i < n; i++){
+            if(batch[i].stream != s){
+                continue;
+            }
+            if(batch[i].type == LOG_REC_EVENT){
+                events_len += logger_format_record(events_buf + events_len, sizeof(events_buf) - events_len, &batch[i]);
+                events++;
+            }else if(batch[i].type == LOG_REC_METRICS){
+                metrics_len += logger_format_record(metrics_buf + metrics_len, sizeof(metrics_buf) - metrics_len, &batch[i]);
+                steps++;
+            }else{
+                data_len += logger_format_record(data_buf + data_len, sizeof(data_buf) - data_len, &batch[i]);
+                samples++;
+                if(compressed_file && s == 0){
+                    encodeSample(&batch[i]);
+                }
+            }
+        }
+        if(data_len){
+            fwrite(data_buf, 1, data_len, streams[s].data);
+            fflush(streams[s].data);
+        }
+        if(events_len){
+            fwrite(events_buf, 1, events_len, streams[s].events);
+            fflush(streams[s].events);
+        }
+    }
+    if(metrics_len){
+        fwrite(metrics_buf, 1, metrics_len, metrics_file);
+        fflush(metrics_file);
+    }
+
+    pthread_mutex_lock(&queue_lock);
+    stats.samples_written += samples;
+    stats.events_written += events;
+    stats.metrics_written += steps;
+    stats.batches++;
+    pthread_mutex_unlock(&queue_lock);
+}
+
+static void *logWriter(void *args){
+    static struct log_record batch[LOG_BATCH_SIZE];
+    bool stopping = false;
+
+    while(!stopping){
+        unsigned int n = 0;
+
+        pthread_mutex_lock(&queue_lock);
+        if(writer_running && queue_count < LOG_BATCH_SIZE){
+            struct timespec deadline;
+            clock_gettime(CLOCK_REALTIME, &deadline);
+            deadline.tv_sec += LOG_FLUSH_MS / 1000;
+            deadline.tv_nsec += (LOG_FLUSH_MS % 1000) * 1000000L;
+            if(deadline.tv_nsec >= 1000000000L){
+                deadline.tv_sec++;
+                deadline.tv_nsec -= 1000000000L;
+            }
+            pthread_cond_timedwait(&queue_ready, &queue_lock, &deadline);
+        }
+        while(n < LOG_BATCH_SIZE && queue_count > 0){
+            batch[n++] = queue[queue_head];
+            queue_head = (queue_head + 1) % LOG_QUEUE_SIZE;
+            queue_count--;
+        }
+        // Drain everything before leaving
+        stopping = !writer_running && queue_count == 0;
+        pthread_mutex_unlock(&queue_lock);
+
+        if(n){
+            writeBatch(batch, n);
+        }
+    }
+    return NULL;
+}
+
+static void closeFiles(void){
+    for(int i = 0; i < stream_count; i++){
+        fclose(streams[i].data);
+        fclose(streams[i].events);
+    }
+    stream_count = 0;
+    if(compressed_file){
+        fclose(compressed_file);
+        compressed_file = NULL;
+    }
+    if(metrics_file){
+        fclose(metrics_file);
+        metrics_file = NULL;
+    }
+}
+
+int logger_add_stream(const char *data_path, const char *events_path){
+    struct log_stream s;
+    s.data = openLog(data_path, CSV_HEADER);
+    if(!s.data){
+        return -1;
+    }
+    s.events = openLog(events_path, EVENTS_HEADER);
+    if(!s.events){
+        fclose(s.data);
+        return -1;
+    }
+    // The writer only looks at streams below the count
+    pthread_mutex_lock(&queue_lock);
+    int index = stream_count < LOG_MAX_STREAMS ? stream_count : -1;
+    if(index >= 0){
+        streams[index] = s;
+        stream_count++;
+    }
+    pthread_mutex_unlock(&queue_lock);
+    if(index < 0){
+        fclose(s.data);
+        fclose(s.events);
+    }
+    return index;
+}
+
+int logger_start(const char *data_path, const char *events_path, const char *compressed_path, const char *metrics_path){
+    stream_count = 0;
+    if(logger_add_stream(data_path, events_path)){
+        return -1;
+    }
+    if(compressed_path){
+        compressed_file = fopen(compressed_path, "ab");
+        if(!compressed_file){
+            closeFiles();
+            return -1;
+        }
+        gorilla_encoder_init(&encoder, 3);
+    }
+    if(metrics_path){
+        metrics_file = openLog(metrics_path, METRICS_HEADER);
+        if(!metrics_file){
+            closeFiles();
+            return -1;
+        }
+    }
+
+    writer_running = true;
+    if(pthread_create(&writer_thread, NULL, logWriter, NULL)){
+        writer_running = false;
+        closeFiles();
+        return -2;
+    }
+    return 0;
+}
+
+void logger_stop(void){
+    pthread_mutex_lock(&queue_lock);
+    if(!writer_running){
+        pthread_mutex_unlock(&queue_lock);
+        return;
+    }
+    writer_running = false;
+    pthread_cond_signal(&queue_ready);
+    pthread_mutex_unlock(&queue_lock);
+
+    pthread_join(writer_thread, NULL);
+    // Partial compressed block
+    if(compressed_file){
+        writeBlock();
+    }
+    closeFiles();
+}
+
+void logger_get_stats(struct log_stats *out){
+    pthread_mutex_lock(&queue_lock);
+    *out = stats;
+    pthread_mutex_unlock(&queue_lock);
+}
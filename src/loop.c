@@ -0,0 +1,231 @@
+#include <bme280.h>
+#include <control.h>
+#include <hal.h>
+#include <history.h>
+#include <i2cbus.h>
+#include <logger.h>
+#include <loop.h>
+#include <state.h>
+#include <tiers.h>
+#include <zone.h>
+
+struct bme280_dev dev;
+
+bool running = false;
+int input_mode = KEYBOARD_INPUT;
+int state = ST_STAND_BY;
+int log_mode = LOG_MODE_PERIODIC;
+
+float extern_temp;
+float intern_temp;
+float reference_temp;
+bool reference_temp_ready = false;
+float histeresis_temp;
+bool histeresis_temp_ready = false;
+float intern_raw;
+float reference_raw;
+struct filter ti_filter;
+struct filter tr_filter;
+struct plant_model thermal_model;
+
+sem_t hold_sensors;
+
+volatile sig_atomic_t toggle_requested = 0;
+volatile sig_atomic_t swap_requested = 0;
+volatile sig_atomic_t stopping = 0;
+
+void (*loop_sensor_failed)(int8_t rslt) = NULL;
+
+static int64_t last_sensed_ns = 0;
+
+int loop_sensor_open(int8_t *rslt){
+    static struct hal_i2c_dev i2c_dev;
+    int res = hal->i2c->open(&i2c_dev, LOOP_I2C_PATH, BME280_I2C_ADDR_PRIM);
+    if(res < 0){
+        return res == -1 ? -1 : -2;
+    }
+    dev.intf = BME280_I2C_INTF;
+    dev.read = hal->i2c->read;
+    dev.write = hal->i2c->write;
+    dev.delay_us = hal->i2c->delay_us;
+    dev.intf_ptr = &i2c_dev;
+    *rslt = bme280_init(&dev);
+    if(*rslt == BME280_OK){
+        // Written once: each read only starts a forced conversion
+        dev.settings.osr_h = BME280_OVERSAMPLING_1X;
+        dev.settings.osr_p = BME280_OVERSAMPLING_16X;
+        dev.settings.osr_t = BME280_OVERSAMPLING_2X;
+        dev.settings.filter = BME280_FILTER_COEFF_16;
+        *rslt = bme280_set_sensor_settings(BME280_OSR_PRESS_SEL | BME280_OSR_TEMP_SEL | BME280_OSR_HUM_SEL | BME280_FILTER_SEL, &dev);
+    }
+    if(*rslt != BME280_OK){
+        hal->i2c->close(&i2c_dev);
+        return -3;
+    }
+    return 0;
+}
+
+// Forced BME280 conversion; zones on the bus use it while the sensor converts
+static int8_t readExternTemp(struct i2c_bus *bus, float *temp){
+    i2c_bus_acquire(bus);
+    int8_t rslt = bme280_start_forced_r(&dev.settings, &dev);
+    i2c_bus_release(bus);
+    if(rslt != BME280_OK){
+        return rslt;
+    }
+    dev.delay_us(1000 * bme280_cal_meas_delay(&dev.settings), dev.intf_ptr);
+
+    struct bme280_data data;
+    i2c_bus_acquire(bus);
+    rslt = bme280_get_sensor_data_r(BME280_TEMP, &data, &dev);
+    i2c_bus_release(bus);
+#ifdef BME280_FLOAT_ENABLE
+    *temp = data.temperature;
+#else
+    *temp = 0.01f * data.temperature;
+#endif
+    return rslt;
+}
+
+int8_t loop_acquire(void){
+    if(!running){
+        return BME280_OK;
+    }
+    // Zones may have sensors on the same bus
+    static struct i2c_bus *bus;
+    if(!bus){
+        bus = i2c_bus_get(LOOP_I2C_PATH);
+    }
+
+    float _temp;
+    // TE first: the BME280 forced-mode conversion is the slow read,
+    // so TI is as fresh as possible when the sample is published
+    int8_t rslt = readExternTemp(bus, &_temp);
+    if(rslt != BME280_OK){
+        return rslt;
+    }
+    extern_temp = _temp;
+    zones_set_ambient(extern_temp);
+    reference_temp_ready = true;
+
+    float dt_s = last_sensed_ns ? (sample_monotonic_ns() - last_sensed_ns) / 1e9f : 0;
+    if(input_mode == POTENTIOMETER_INPUT){
+        int res = hal->uart->read_tr(&_temp);
+        if (!res){
+            reference_raw = _temp;
+            reference_temp = filter_update(&tr_filter, _temp, dt_s, NULL);
+        }
+    }else{
+        // Typed reference: nothing to filter
+        reference_raw = reference_temp;
+        filter_reset(&tr_filter);
+    }
+    int res = hal->uart->read_ti(&_temp);
+    int64_t sensed_ns = sample_monotonic_ns();
+    if (!res){
+        struct filter_process process = { &thermal_model, extern_temp, 0, 0 };
+        control_get_outputs(&process.heater, &process.fan);
+        intern_raw = _temp;
+        intern_temp = filter_update(&ti_filter, _temp, dt_s, &process);
+    }
+    last_sensed_ns = sensed_ns;
+    if(reference_temp_ready){
+        zones_set_reference(reference_temp);
+    }
+
+    // Wakes the control loop and the UI
+    struct sample s;
+    s.ts_ms = history_now_ms();
+    s.sensed_ns = sensed_ns;
+    s.reference_temp = reference_temp;
+    s.intern_temp = intern_temp;
+    s.extern_temp = extern_temp;
+    s.reference_raw = reference_raw;
+    s.intern_raw = intern_raw;
+    sample_publish(&s);
+
+    // Logs keep the sensor readings, before the filters
+    if(log_mode == LOG_MODE_FULL_RATE){
+        logger_push_sample(reference_raw, intern_raw, extern_temp);
+    }
+    saveHistory();
+
+    float values[TIER_CHANNELS];
+    values[TIER_CH_TI] = intern_raw;
+    values[TIER_CH_TE] = extern_temp;
+    values[TIER_CH_TR] = reference_raw;
+    tiers_add(s.ts_ms, values);
+    return BME280_OK;
+}
+
+void *watchSensors(void *args){
+    while(!stopping){
+        sem_wait(&hold_sensors);
+        if(stopping){
+            break;
+        }
+        int8_t rslt = loop_acquire();
+        if(rslt != BME280_OK && loop_sensor_failed){
+            loop_sensor_failed(rslt);
+        }
+    }
+    return NULL;
+}
+
+int loop_control(int wake, const struct sample *s){
+    if(toggle_requested){
+        toggle_requested = 0;
+        toggleControl();
+    }
+    if(swap_requested){
+        swap_requested = 0;
+        control_request_swap();
+    }
+    // Controle (histerese ou PID, ver control.c)
+    struct control_input in;
+    in.running = running;
+    in.reference_temp = reference_temp;
+    in.intern_temp = intern_temp;
+    in.histeresis_temp = histeresis_temp;
+    in.extern_temp = extern_temp;
+    in.reference_raw = input_mode == POTENTIOMETER_INPUT ? reference_raw : reference_temp;
+    in.intern_raw = intern_raw;
+    in.sensed_ns = (wake & SAMPLE_WAKE_NEW) ? s->sensed_ns : 0;
+    state = control_step(&in);
+    return state;
+}
+
+void *handleGPIO(void *args){
+    struct sample_cursor cursor = {0};
+    struct sample s;
+    while(!stopping){
+        // Runs as soon as a sample or a new setpoint is published
+        int wake = sample_wait(&cursor, &s, CONTROL_IDLE_MS);
+        if(stopping){
+            break;
+        }
+        loop_control(wake, &s);
+    }
+    return NULL;
+}
+
+void toggleControl(void){
+    struct control_status status;
+    control_get_status(&status);
+    // Hysteresis -> PID -> Smith -> hysteresis
+    control_request_mode((status.mode + 1) % CONTROLLER_TYPES);
+}
+
+void saveHistory(void){
+    struct history_record rec;
+    rec.ts_ms = history_now_ms();
+    rec.reference_temp = reference_temp;
+    rec.intern_temp = intern_temp;
+    rec.extern_temp = extern_temp;
+    rec.histeresis_temp = histeresis_temp;
+    rec.state = state;
+    rec.input_mode = input_mode;
+    rec.ready = (reference_temp_ready ? HISTORY_READY_REFERENCE : 0)
+        | (histeresis_temp_ready ? HISTORY_READY_HISTERESIS : 0);
+    history_append(&rec);
+}
@@ -1,79 +1,194 @@
 #include <stdio.h>
+#include <stdlib.h>
 #include <ncurses.h>
 #include <string.h>
 #include <unistd.h>
 #include <pthread.h>
-#include <termios.h>
-#include <fcntl.h>
-#include <linux_userspace.c>
 #include <signal.h>
-#include <bcm2835.h>
 #include <semaphore.h>
-
-#include <uart_utils.h>
-#include <i2clcd.h>
+#include <poll.h>
+#include <errno.h>
+#include <sys/eventfd.h>
+
+#include <bme280.h>
+#include <hal.h>
+#include <hal_sim.h>
+#include <logger.h>
+#include <history.h>
+#include <tiers.h>
+#include <state.h>
+#include <ui.h>
+#include <sample.h>
+#include <config.h>
+#include <chart.h>
+#include <control.h>
+#include <filter.h>
+#include <plant.h>
+#include <zone.h>
+#include <loop.h>
 
 #define MIN_ROWS 24
 #define MIN_COLS 90
 
-#define KEYBOARD_INPUT 0
-#define POTENTIOMETER_INPUT 1
-
-#define ST_STAND_BY 0
-#define ST_WARMING_UP 1
-#define ST_COOLING_DOWN 2
 // Commands
 #define CMD_EXIT 48 // 0
 #define CMD_KEYBOARD_INPUT 49 // 1
 #define CMD_POTENTIOMETER_INPUT 50 // 2 
 #define CMD_SET_HISTERESIS 51 // 3
+#define CMD_TOGGLE_CONTROL 52 // 4
+#define CMD_AUTOTUNE 53 // 5
+#define CMD_SWAP_SHADOW 54 // 6
 
-static const char I2C_PATH[] = "/dev/i2c-1";
-static const char CSV_DATA_PATH[] = "./data.csv";
-
-struct bme280_dev dev;
+// UI redraw period without new samples or keys
+#define UI_IDLE_MS 500
 
-bool running = false;
-int input_mode = KEYBOARD_INPUT;
-int state = ST_STAND_BY;
+static const char CSV_DATA_PATH[] = "./data.csv";
+static const char CSV_EVENTS_PATH[] = "./events.csv";
+static const char COMPRESSED_DATA_PATH[] = "./data.gor";
+static const char METRICS_PATH[] = "./metrics.csv";
+static const char HISTORY_PATH[] = "./history.bin";
+static const char TIERS_PATH[] = "./tiers.bin";
+static const char PID_GAINS_PATH[] = "./pid_gains.conf";
+
+// Setpoint, readings and the sensor / control threads live in loop.c
+bool headless = false;
 int time_it = 0;
+int history_hours = HISTORY_DEFAULT_HOURS;
 
-float extern_temp;
-float intern_temp;
-float reference_temp;
-bool reference_temp_ready = false;
-float histeresis_temp;
-bool histeresis_temp_ready = false;
 float potentiometer;
 
-pthread_t keyboard_thread;
+// SIGINT / SIGTERM: the handler only records the signal and wakes main
+// (or the UI thread) through exit_fd; the teardown runs in main
+volatile sig_atomic_t exit_signal = 0;
+int exit_fd = -1;
+
+pthread_t ui_thread;
 pthread_t sensors_thread;
 pthread_t log_thread;
 pthread_t lcd_thread;
 pthread_t control_thread;
 
-sem_t hold_sensors;
 sem_t hold_logger;
 sem_t hold_lcd;
-sem_t hold_control;
 
-void *watchKeyboard(void *args);
-void *watchSensors(void *args);
+void *runUI(void *args);
 void *handleCSV(void *args);
 void *handleLCD(void *args);
-void *handleGPIO(void *args);
 
 void printMenu(WINDOW *menuWindow);
 void printData(WINDOW *sensorsWindow);
-void writeCSV();
+void handleCommand(int op_code, struct ui_input *input);
+void handleInput(const struct ui_input *input);
 
 void handleAlarm(int signal);
+void handleControlSignal(int signal);
+void handleExitSignal(int signal);
 
 int startThreads(WINDOW *inputWindow, WINDOW *sensorsWindow);
+void stopThreads(void);
 
 void safeExit(int signal);
+void sensorFailed(int8_t rslt);
+
+void printUsage(const char *name);
+
+void restoreHistory();
+void seedChart(const struct history_record *rec, void *ctx);
+void applyConfig(const struct config *cfg);
+
+int main(int argc, char *argv[]){
+    // Command line options (override the configuration file)
+    int opt;
+    const char *config_path = NULL;
+    bool cli_full_rate = false, cli_headless = false, cli_pid = false, cli_sim = false;
+    int cli_history_hours = 0;
+    while((opt = getopt(argc, argv, "fn:c:dpsh")) != -1){
+        switch(opt){
+            case 'f':
+                cli_full_rate = true;
+                break;
+            case 'n':
+                cli_history_hours = atoi(optarg);
+                if(cli_history_hours <= 0){
+                    printUsage(argv[0]);
+                    exit(1);
+                }
+                break;
+            case 'c':
+                config_path = optarg;
+                break;
+            case 'd':
+                cli_headless = true;
+                break;
+            case 'p':
+                cli_pid = true;
+                break;
+            case 's':
+                cli_sim = true;
+                break;
+            case 'h':
+                printUsage(argv[0]);
+                exit(0);
+            default:
+                printUsage(argv[0]);
+                exit(1);
+        }
+    }
+
+    struct config cfg;
+    config_defaults(&cfg);
+    // Gains from the last auto-tune; the configuration file overrides them
+    if(config_load(PID_GAINS_PATH, &cfg) > 0){
+        fprintf(stderr, "Ignorando ganhos inválidos em %s\n", PID_GAINS_PATH);
+        config_defaults(&cfg);
+    }
+    if(config_path){
+        int res = config_load(config_path, &cfg);
+        if(res < 0){
+            fprintf(stderr, "Não foi possivel abrir a configuração %s\n", config_path);
+            exit(1);
+        }else if(res > 0){
+            fprintf(stderr, "Configuração inválida em %s:%d\n", config_path, res);
+            exit(1);
+        }
+    }
+    headless = cli_headless || cfg.headless;
+    log_mode = cli_full_rate ? LOG_MODE_FULL_RATE : cfg.log_mode;
+    if(cli_history_hours){
+        history_hours = cli_history_hours;
+    }else if(cfg.history_hours){
+        history_hours = cfg.history_hours;
+    }
+    cfg.control.gains_path = PID_GAINS_PATH;
+
+    // Chamber model: the simulated chamber, the TI Kalman filter and the Smith predictor use it
+    plant_model_defaults(&thermal_model);
+    if(cfg.plant_model[0]){
+        int res = plant_model_load(cfg.plant_model, &thermal_model);
+        if(res){
+            fprintf(stderr, "Modelo da planta inválido: %s (%d)\n", cfg.plant_model, res);
+            exit(1);
+        }
+    }
+    cfg.control.model = thermal_model;
+    filter_init(&ti_filter, &cfg.filter_ti);
+    filter_init(&tr_filter, &cfg.filter_tr);
+    cfg.control.raw_compare = filter_enabled(&cfg.filter_ti) || filter_enabled(&cfg.filter_tr);
+
+    // Hardware backend: the simulated chamber replaces GPIO, LCD, UART and I2C
+    if(cli_sim || cfg.simulation || strcmp(hal->name, "sim") == 0){
+        hal_select("sim");
+        hal_sim_configure(&thermal_model, cfg.potentiometer, (uint64_t) time(NULL));
+        // One simulated chamber behind each zone sensor
+        for(int i = 0; i < cfg.zone_count; i++){
+            const struct zone_config *z = &cfg.zones[i];
+            hal_sim_add_chamber(z->bus, z->addr, z->heater_pin, z->fan_pin);
+        }
+    }
+    if(cli_pid){
+        cfg.control.mode = CONTROL_PID;
+    }
 
-int main(){
     // Initialize Alarm
     signal(SIGALRM, handleAlarm);
     ualarm(500000, 500000);
@@ -82,49 +197,96 @@ int main(){
     sem_init(&hold_sensors, 0, 0);
     sem_init(&hold_logger, 0, 0);
     sem_init(&hold_lcd, 0, 0);
-    sem_init(&hold_control, 0, 0);
 
     // Add signals to safe exit
-    signal(SIGKILL, safeExit);
-    signal(SIGSTOP, safeExit);
-    signal(SIGINT, safeExit);
-    signal(SIGTERM, safeExit);
+    exit_fd = eventfd(0, EFD_CLOEXEC);
+    if(exit_fd < 0){
+        fprintf(stderr, "Falha na criação do eventfd\n");
+        exit(9);
+    }
+    signal(SIGINT, handleExitSignal);
+    signal(SIGTERM, handleExitSignal);
+    // Controller hot-swap without the interface (headless)
+    signal(SIGUSR1, handleControlSignal);
+    signal(SIGUSR2, handleControlSignal);
+
+    // Initialize logger
+    if(logger_start(CSV_DATA_PATH, CSV_EVENTS_PATH, COMPRESSED_DATA_PATH, METRICS_PATH)){
+        fprintf(stderr, "Não foi possivel abrir o arquivo para csv.\n");
+        exit(6);
+    }
+
+    // Initialize history ring and resume the last control state
+    if(history_open(HISTORY_PATH, history_hours * HISTORY_SAMPLES_PER_HOUR)){
+        fprintf(stderr, "Não foi possivel abrir o histórico %s\n", HISTORY_PATH);
+        exit(7);
+    }
+    restoreHistory();
+    applyConfig(&cfg);
+    if(headless && !running){
+        fprintf(stderr, "O modo headless requer referencia (ou entrada = potenciometro) e histerese na configuração\n");
+        exit(10);
+    }
+
+    // Initialize downsampled store
+    if(tiers_open(TIERS_PATH)){
+        fprintf(stderr, "Não foi possivel abrir o armazenamento %s\n", TIERS_PATH);
+        exit(8);
+    }
+
+    // Sample publication (wakes the control loop and the UI)
+    if(sample_init(!headless)){
+        fprintf(stderr, "Falha na criação do eventfd\n");
+        exit(9);
+    }
 
     // Initialize i2clcd
-    lcd_init();
+    hal->lcd->init();
 
     // Initialize BME280
-    struct identifier id;
-    if((id.fd = open(I2C_PATH, O_RDWR)) < 0) {
+    int8_t rslt;
+    int res = loop_sensor_open(&rslt);
+    if(res == -1) {
         endwin();
-        fprintf(stderr, "Falha na abertura do canal I2C %s\n", I2C_PATH);
+        fprintf(stderr, "Falha na abertura do canal I2C %s\n", LOOP_I2C_PATH);
         exit(2);
-    }
-    id.dev_addr = BME280_I2C_ADDR_PRIM;
-    if(ioctl(id.fd, I2C_SLAVE, id.dev_addr) < 0) {
+    }else if(res == -2) {
         endwin();
         fprintf(stderr, "Falha na comunicaçaõ I2C\n");
         exit(3);
-    }
-    dev.intf = BME280_I2C_INTF;
-    dev.read = user_i2c_read;
-    dev.write = user_i2c_write;
-    dev.delay_us = user_delay_us;
-    dev.intf_ptr = &id;
-    int8_t rslt = bme280_init(&dev);
-    if(rslt != BME280_OK) {
+    }else if(res < 0) {
         endwin();
         fprintf(stderr, "Falha na inicialização do dispositivo(codigo %+d).\n", rslt);
         exit(4);
     }
+    loop_sensor_failed = sensorFailed;
 
-    // Initialize bcm2835
-    if(!bcm2835_init()){
+    // Initialize GPIO (bcm2835)
+    if(hal->gpio->init()){
         fprintf(stderr, "Erro na inicialização do bcm2835\n");
         exit(5);
     };
-    bcm2835_gpio_fsel(RPI_V2_GPIO_P1_18, BCM2835_GPIO_FSEL_OUTP);
-    bcm2835_gpio_fsel(RPI_V2_GPIO_P1_16, BCM2835_GPIO_FSEL_OUTP);
+    // Configures the heater and fan pins (actuator layer)
+    control_init(&cfg.control);
+
+    // Extra chambers, each in its own thread
+    int failed;
+    res = zones_start(cfg.zones, cfg.zone_count, &cfg.control, &failed);
+    if(res){
+        static const char *reasons[] = { "", "pinos em uso", "sensor BME280 indisponível", "arquivos de log", "criação da thread" };
+        fprintf(stderr, "Falha na zona %s: %s\n", cfg.zones[failed].name, reasons[res]);
+        control_shutdown();
+        exit(11);
+    }
+
+    if(headless){
+        startThreads(NULL, NULL);
+        // Threads run until SIGINT / SIGTERM
+        uint64_t value;
+        while(read(exit_fd, &value, sizeof(value)) < 0 && errno == EINTR){
+        }
+        safeExit(exit_signal);
+    }
 
     // Initialize ncurses
     initscr();
@@ -153,16 +315,18 @@ int main(){
     WINDOW *inputWindow = newwin(4, COLS, LINES - 4, 0);
 
     printMenu(menuWindow);
+    ui_init_sensors(sensorsWindow);
 
     startThreads(inputWindow, sensorsWindow);
 
-    pthread_join(keyboard_thread, NULL);
+    // The UI thread returns on CMD_EXIT or on a signal (exit_fd)
+    pthread_join(ui_thread, NULL);
 
     delwin(sensorsWindow);
     delwin(menuWindow);
     delwin(inputWindow);
 
-    safeExit(0);
+    safeExit(exit_signal);
     return 0;
 }
 
@@ -170,17 +334,35 @@ void handleAlarm(int signal){
     sem_post(&hold_sensors);
     sem_post(&hold_logger);
     sem_post(&hold_lcd);
-    sem_post(&hold_control);
 }
 
+// Async-signal-safe: a flag and a write
+void handleExitSignal(int signal){
+    int saved_errno = errno;
+    uint64_t one = 1;
+    exit_signal = signal;
+    if(write(exit_fd, &one, sizeof(one)) < 0){
+        // Counter full: a wake-up is already pending
+    }
+    errno = saved_errno;
+}
+
+struct ui_windows {
+    WINDOW *input;
+    WINDOW *sensors;
+};
+
 int startThreads(WINDOW *inputWindow, WINDOW *sensorsWindow){
-    if(pthread_create(&keyboard_thread, NULL, watchKeyboard, (void *) inputWindow)){
+    static struct ui_windows windows;
+    windows.input = inputWindow;
+    windows.sensors = sensorsWindow;
+    if(!headless && pthread_create(&ui_thread, NULL, runUI, (void *) &windows)){
         endwin();
         fprintf(stderr, "ERRO: Falha na criacao de thread(1)\n");
         exit(-1);
     }
 
-    if(pthread_create(&sensors_thread, NULL, watchSensors, (void *) sensorsWindow)){
+    if(pthread_create(&sensors_thread, NULL, watchSensors, NULL)){
         endwin();
         fprintf(stderr, "ERRO: Falha na criacao de thread(2)\n");
         exit(-2);
@@ -198,7 +380,7 @@ int startThreads(WINDOW *inputWindow, WINDOW *sensorsWindow){
         exit(-4);
     }
 
-    if(pthread_create(&lcd_thread, NULL, handleGPIO, NULL)){
+    if(pthread_create(&control_thread, NULL, handleGPIO, NULL)){
         endwin();
         fprintf(stderr, "ERRO: Falha na criacao de thread(5)\n");
         exit(-5);
@@ -207,111 +389,154 @@ int startThreads(WINDOW *inputWindow, WINDOW *sensorsWindow){
     return 0;
 }
 
-void *watchKeyboard(void *args){
-    WINDOW *inputWindow = (WINDOW *) args;
-    int op_code;
-    box(inputWindow, 0, 0);
-    wrefresh(inputWindow);
-    while((op_code = getch()) != CMD_EXIT){
-        // mvprintw(1, 1, "> %d", op_code);
-        switch(op_code){
-            case CMD_KEYBOARD_INPUT:{
-                input_mode = KEYBOARD_INPUT;
-                float new_temperature=0.0f;
-
-                echo();
-
-                mvwprintw(inputWindow, 1, 1, "Insira a nova temperatura de referência desejada");
-                mvwprintw(inputWindow, 2, 1, "> ");
-                wscanw(inputWindow, "%f", &new_temperature);
-                reference_temp = new_temperature;
-                reference_temp_ready=true;
-
-                noecho();
-
-                break;
-            }
-            case CMD_POTENTIOMETER_INPUT:{
-                input_mode = POTENTIOMETER_INPUT;
-                reference_temp_ready = true;
-                break;
-            }
-            case CMD_SET_HISTERESIS:{
-                float new_histeresis=0.0f;
-
-                echo();
+// Workers check stopping on every wake-up; the posts wake them now instead
+// of on the next alarm
+void stopThreads(void){
+    stopping = 1;
+    sem_post(&hold_sensors);
+    sem_post(&hold_logger);
+    sem_post(&hold_lcd);
+    sample_setpoint_changed();
+    pthread_join(sensors_thread, NULL);
+    pthread_join(log_thread, NULL);
+    pthread_join(lcd_thread, NULL);
+    pthread_join(control_thread, NULL);
+}
 
-                mvwprintw(inputWindow, 1, 1, "Insira a nova temperatura de histerese desejada");
-                mvwprintw(inputWindow, 2, 1, "> ");
-                wscanw(inputWindow, "%f", &new_histeresis);
-                histeresis_temp = new_histeresis;
-                histeresis_temp_ready = true;
+// Only thread calling ncurses once the other threads are running
+void *runUI(void *args){
+    struct ui_windows *windows = (struct ui_windows *) args;
+    WINDOW *inputWindow = windows->input;
+    WINDOW *sensorsWindow = windows->sensors;
+    struct ui_input input = {0};
+    bool quit = false;
+
+    nodelay(inputWindow, TRUE);
+    keypad(inputWindow, TRUE);
+    input.dirty = true;
+
+    // Trend chart starts from the history ring
+    uint64_t charted_seq = 0;
+    history_foreach(history_now_ms() - chart_span_ms(), seedChart, NULL);
+
+    struct pollfd fds[3];
+    fds[0].fd = STDIN_FILENO;
+    fds[0].events = POLLIN;
+    fds[1].fd = sample_eventfd();
+    fds[1].events = POLLIN;
+    fds[2].fd = exit_fd;
+    fds[2].events = POLLIN;
+
+    while(!quit){
+        ui_render_input(inputWindow, &input);
+        printData(sensorsWindow);
+        doupdate();
 
-                noecho();
-                break;
+        if(poll(fds, 3, UI_IDLE_MS) < 0){
+            continue;
+        }
+        if(fds[2].revents & POLLIN){
+            break;
+        }
+        if(fds[1].revents & POLLIN){
+            sample_drain_eventfd();
+            struct sample s;
+            if(sample_latest(&s) && s.seq != charted_seq){
+                chart_add(s.ts_ms, s.intern_temp, s.extern_temp, s.reference_temp, histeresis_temp);
+                charted_seq = s.seq;
             }
         }
-        if(histeresis_temp_ready && reference_temp_ready){
-            running=true;
+        if(fds[0].revents & POLLIN){
+            int ch;
+            while(!quit && (ch = wgetch(inputWindow)) != ERR){
+                if(input.active){
+                    if(ui_input_key(&input, ch) == UI_INPUT_DONE){
+                        handleInput(&input);
+                    }
+                }else if(ch == CMD_EXIT){
+                    quit = true;
+                }else{
+                    handleCommand(ch, &input);
+                }
+            }
         }
-        wclear(inputWindow);
-        box(inputWindow, 0, 0);
-        wrefresh(inputWindow);
     }
     return NULL;
 }
 
-void *watchSensors(void *args){
-    WINDOW *sensorsWindow = (WINDOW *) args;
-    while(true){
-        sem_wait(&hold_sensors);
-        wclear(sensorsWindow);
-        box(sensorsWindow, 0, 0);
-        wrefresh(sensorsWindow);
+void handleControlSignal(int signal){
+    if(signal == SIGUSR1){
+        toggle_requested = 1;
+    }else{
+        swap_requested = 1;
+    }
+}
 
-        printData(sensorsWindow);
-        
-        if(running){
-            // get_sensor_data()
-            float _temp;
-            int res = getTI(&_temp);
-            if (!res){
-                intern_temp = _temp;
-            }
-            if(input_mode == POTENTIOMETER_INPUT){
-                res = getTR(&_temp);
-                if (!res){
-                    reference_temp = _temp;
-                }
-            }else{
-                // usleep(250000);
-            }
-            
-            mvwprintw(sensorsWindow, 1, 1, "Retorno %d", res);
-            
-            int rslt = get_sensor_data_forced_mode(&dev, &_temp);
-            if (rslt == BME280_OK){
-                extern_temp = _temp;
-                reference_temp_ready = true;
-            }else{
-                endwin();
-                fprintf(stderr, "Falha na leitura do sensor BME280 (code %+d).\n", rslt);
-                exit(1);
-            }
+void handleCommand(int op_code, struct ui_input *input){
+    switch(op_code){
+        case CMD_KEYBOARD_INPUT:
+            ui_input_begin(input, op_code, "Insira a nova temperatura de referência desejada");
+            return;
+        case CMD_POTENTIOMETER_INPUT:
+            input_mode = POTENTIOMETER_INPUT;
+            reference_temp_ready = true;
+            break;
+        case CMD_SET_HISTERESIS:
+            ui_input_begin(input, op_code, "Insira a nova temperatura de histerese desejada");
+            return;
+        case CMD_TOGGLE_CONTROL:
+            toggleControl();
+            return;
+        case CMD_AUTOTUNE:
+            control_request_autotune();
+            return;
+        case CMD_SWAP_SHADOW:
+            control_request_swap();
+            return;
+        default:
+            return;
+    }
+    if(histeresis_temp_ready && reference_temp_ready){
+        running=true;
+    }
+    sample_setpoint_changed();
+    saveHistory();
+}
 
-            // // handleGPIO();
-        }else{
-            // usleep(500000);
-        }
+void handleInput(const struct ui_input *input){
+    float value;
+    if(sscanf(input->buf, "%f", &value) != 1){
+        return;
+    }
+    if(input->target == CMD_KEYBOARD_INPUT){
+        input_mode = KEYBOARD_INPUT;
+        reference_temp = value;
+        reference_temp_ready = true;
+    }else if(input->target == CMD_SET_HISTERESIS){
+        histeresis_temp = value;
+        histeresis_temp_ready = true;
     }
+    if(histeresis_temp_ready && reference_temp_ready){
+        running=true;
+    }
+    sample_setpoint_changed();
+    saveHistory();
 }
 
 void *handleCSV(void *args){
-    while(true){
+    while(!stopping){
         sem_wait(&hold_logger);
-        if(++time_it == 4){
+        if(stopping){
+            break;
+        }
+        if(++time_it == LOG_PERIODIC_TICKS){
             time_it=0;
-            writeCSV();
+            // Full rate samples are pushed by watchSensors
+            if(log_mode == LOG_MODE_PERIODIC){
+                logger_push_sample(reference_raw, intern_raw, extern_temp);
+            }
+            // Flush the history ring to disk
+            history_sync();
         }
     }
 
@@ -319,66 +544,54 @@ void *handleCSV(void *args){
 }
 
 void *handleLCD(void *args){
-    while(true){
+    while(!stopping){
         sem_wait(&hold_lcd);
+        if(stopping){
+            break;
+        }
         char STR_LINE1[16] = "";
         sprintf(STR_LINE1, "TR %.2f ", reference_temp);
-        lcdLoc(LINE1);
-        typeln(STR_LINE1);
+        hal->lcd->write_line(0, STR_LINE1);
 
         char STR_LINE2[16] = "";
         sprintf(STR_LINE2, "TI%.2f TE%.2f ", intern_temp, extern_temp);
-        lcdLoc(LINE2);
-        typeln(STR_LINE2);
+        hal->lcd->write_line(1, STR_LINE2);
 
     }
     return NULL;
 }
 
-void *handleGPIO(void *args){
-    while(true){
-        sem_wait(&hold_control);
-        // Controle
-        float histeresis_var = histeresis_temp / 2;
-        if(intern_temp < reference_temp - histeresis_var){
-            state = ST_WARMING_UP;
-            // liga resistor
-            bcm2835_gpio_write(RPI_V2_GPIO_P1_16, 0);
-            // desliga ventilador
-            bcm2835_gpio_write(RPI_V2_GPIO_P1_18, 1);
-        }else if(intern_temp > reference_temp + histeresis_var){
-            state = ST_COOLING_DOWN;
-            // desliga resistor
-            bcm2835_gpio_write(RPI_V2_GPIO_P1_16, 1);
-            // liga ventilador
-            bcm2835_gpio_write(RPI_V2_GPIO_P1_18, 0);
-        }else if(intern_temp < reference_temp){
-            state = ST_STAND_BY;
-            // desliga ventilador
-            bcm2835_gpio_write(RPI_V2_GPIO_P1_18, 1);
-        }else if(intern_temp > reference_temp){
-            // desliga resistor
-            state = ST_STAND_BY;
-            bcm2835_gpio_write(RPI_V2_GPIO_P1_16, 1);
-        }
-    }
-    return NULL;
+// Watch thread: a failed BME280 read ends the program
+void sensorFailed(int8_t rslt){
+    endwin();
+    fprintf(stderr, "Falha na leitura do sensor BME280 (code %+d).\n", rslt);
+    exit(1);
 }
 
+// Called from main only, never from a signal handler: everything below
+// takes locks or joins threads
 void safeExit(int signal){
-    // Finish threads
-    pthread_cancel(sensors_thread);
-    pthread_cancel(keyboard_thread);
-    pthread_cancel(log_thread);
-    pthread_cancel(lcd_thread);
-    pthread_cancel(control_thread);
-
-    // Turn actuators off
-    bcm2835_gpio_write(RPI_V2_GPIO_P1_18, 1); // Cooler
-    bcm2835_gpio_write(RPI_V2_GPIO_P1_16, 1); // Resist
-
-    echo();
-    endwin();
+    // Finish threads (the UI thread has already returned)
+    stopThreads();
+
+    // Stop the PWM thread and turn actuators off
+    control_shutdown();
+    int zones = zones_count();
+    struct zone_status zone_status[ZONE_MAX];
+    for(int i = 0; i < zones; i++){
+        zones_get_status(i, &zone_status[i]);
+    }
+    zones_stop();
+
+    // Flush pending log records
+    logger_stop();
+    history_close();
+    tiers_close();
+
+    if(!headless){
+        echo();
+        endwin();
+    }
 
     if(signal){
         printf("Execução abortada pelo signal: %d\n", signal);
@@ -386,88 +599,143 @@ void safeExit(int signal){
         printf("Execução finalizada pelo usuário\n");
     }
 
-    exit(signal);
-}
-
-void writeCSV(){
-    // Open csv
-    FILE *arq;
-    arq = fopen(CSV_DATA_PATH, "r+");
-    if(arq){
-        fseek(arq, 0, SEEK_END);
+    struct control_status status;
+    control_get_status(&status);
+    if(status.reactions){
+        printf("Latência sensor-atuador: média %lld us, máxima %lld us (%llu reações)\n",
+            (long long) status.latency_avg_us, (long long) status.latency_max_us,
+            (unsigned long long) status.reactions);
+    }
+    if(status.timing.iterations){
+        printf("Cálculo do controle (%s): média %.1f us, máximo %.1f us (%llu iterações)\n",
+            controller_name(status.mode), status.timing.sum_ns / 1000.0 / status.timing.iterations,
+            status.timing.max_ns / 1000.0, (unsigned long long) status.timing.iterations);
     }
-    else{
-        arq = fopen("./data.csv", "a");
-        // Header
-        fprintf(arq, "Temperatura referência (oC), Temperatura interna (oC), Temperatura externa (oC), Data e Hora\n");
+    const struct metrics_report *q = &status.metrics_total;
+    if(q->duration_s > 0){
+        printf("Qualidade do controle em %.0f s: IAE %.1f oC.s, ISE %.1f oC2.s, %.1f%% na faixa, %.1f comutações/h\n",
+            q->duration_s, q->iae, q->ise, q->in_band * 100, q->switches_per_hour);
+        printf("Energia: resistor %.1f%%, ventoinha %.1f%% do tempo (passos em %s)\n",
+            q->heater_duty * 100, q->fan_duty * 100, METRICS_PATH);
+    }
+    if(filter_enabled(&ti_filter.cfg) || filter_enabled(&tr_filter.cfg)){
+        printf("Filtros: %llu amostras de TI e %llu de TR rejeitadas; %llu comutações sem filtro, %llu com filtro\n",
+            (unsigned long long) ti_filter.stats.rejected, (unsigned long long) tr_filter.stats.rejected,
+            (unsigned long long) status.switches_unfiltered, (unsigned long long) status.switches_filtered);
+    }
+    for(int i = 0; i < status.shadows; i++){
+        const struct control_shadow_status *sh = &status.shadow[i];
+        printf("Sombra %d (%s): divergência média %.3f, resistor %.1f%%, ventoinha %.1f%%, %.1f comutações/h\n",
+            i + 1, controller_name(sh->type), sh->divergence, sh->metrics_total.heater_duty * 100,
+            sh->metrics_total.fan_duty * 100, sh->metrics_total.switches_per_hour);
+    }
+    for(int i = 0; i < zones; i++){
+        const struct zone_status *z = &zone_status[i];
+        printf("Zona %s (%s): %llu leituras (%llu falhas), IAE %.1f oC.s, %.1f%% na faixa, espera máxima do I2C %lld us, atualização máxima %lld us\n",
+            z->name, controller_name(z->controller), (unsigned long long) z->reads, (unsigned long long) z->read_errors,
+            z->metrics_total.iae, z->metrics_total.in_band * 100, (long long) z->bus_wait_max_us, (long long) z->update_max_us);
     }
 
-    if(arq){
-        time_t rawtime;
-        struct tm * timeinfo;
+    exit(signal);
+}
 
-        time(&rawtime);
-        timeinfo = localtime(&rawtime);
+void printUsage(const char *name){
+    printf("Uso: %s [-c arquivo] [-d] [-f] [-n horas] [-p] [-s] [-h]\n", name);
+    printf("  -c  Arquivo de configuração (chave = valor)\n");
+    printf("  -d  Modo headless: sem interface, referência e histerese da configuração\n");
+    printf("  -f  Registra todas as amostras no log (padrão: a cada %d ciclos)\n", LOG_PERIODIC_TICKS);
+    printf("  -n  Horas mantidas no histórico %s (padrão: %d)\n", HISTORY_PATH, HISTORY_DEFAULT_HOURS);
+    printf("  -p  Controle PID com PWM por software (padrão: histerese)\n");
+    printf("  -s  Simulação: câmara simulada no lugar de GPIO, LCD, UART e I2C\n");
+    printf("  -h  Mostra esta ajuda\n");
+}
 
-        fprintf(arq, "%0.2lf, %0.2lf, %0.2lf, %s", reference_temp, intern_temp, extern_temp, asctime (timeinfo));
+void restoreHistory(){
+    struct history_record rec;
+    if(!history_last(&rec)){
+        return;
     }
-    else{
-        endwin();
-        printf("Não foi possivel abrir o arquivo para csv.\n");
-        exit(-1);
+    reference_temp = rec.reference_temp;
+    reference_temp_ready = rec.ready & HISTORY_READY_REFERENCE;
+    histeresis_temp = rec.histeresis_temp;
+    histeresis_temp_ready = rec.ready & HISTORY_READY_HISTERESIS;
+    intern_temp = intern_raw = rec.intern_temp;
+    extern_temp = rec.extern_temp;
+    input_mode = rec.input_mode;
+    state = ST_STAND_BY;
+    running = reference_temp_ready && histeresis_temp_ready;
+}
+
+void seedChart(const struct history_record *rec, void *ctx){
+    // Only records taken while the controller was running
+    if(rec->ready == (HISTORY_READY_REFERENCE | HISTORY_READY_HISTERESIS)){
+        chart_add(rec->ts_ms, rec->intern_temp, rec->extern_temp, rec->reference_temp, rec->histeresis_temp);
     }
+}
 
-    // Close CSV
-    fclose(arq); 
+void applyConfig(const struct config *cfg){
+    if(cfg->has_input_mode){
+        input_mode = cfg->input_mode;
+        if(input_mode == POTENTIOMETER_INPUT){
+            reference_temp_ready = true;
+        }
+    }
+    if(cfg->has_reference){
+        reference_temp = cfg->reference_temp;
+        reference_temp_ready = true;
+    }
+    if(cfg->has_histeresis){
+        histeresis_temp = cfg->histeresis_temp;
+        histeresis_temp_ready = true;
+    }
+    running = reference_temp_ready && histeresis_temp_ready;
 }
 
 void printMenu(WINDOW *menuWindow){
     box(menuWindow, 0, 0);
     wrefresh(menuWindow);
-    mvwprintw(menuWindow, 1, 1, "Lista de comandos disponíveis:");
+    mvwprintw(menuWindow, 1, 1, "Lista de comandos disponíveis (0 ou CTRL+C - Sair):");
     mvwprintw(menuWindow, 2, 1, "1 - Definir temperatura de referência manualmente");
     mvwprintw(menuWindow, 3, 1, "2 - Definir temperatura de referência via potenciômetro");
     mvwprintw(menuWindow, 4, 1, "3 - Definir temperatura de histerese");
-    mvwprintw(menuWindow, 6, 1, "0 ou CTRL+C - Sair");
+    mvwprintw(menuWindow, 5, 1, "4 - Alternar controle: histerese, PID, Smith");
+    mvwprintw(menuWindow, 6, 1, "5 - Auto-sintonia do PID por relé");
+    mvwprintw(menuWindow, 6, 45, "6 - Trocar pelo controlador sombra");
     wrefresh(menuWindow);
 }
 
 void printData(WINDOW *sensorsWindow){
-    if(running){
-        mvwprintw(sensorsWindow, 1, 1, "> Executando");
-        if(state==ST_STAND_BY){
-            mvwprintw(sensorsWindow, 2, 1, "Status: Dentro da temperatura de histerese");
-        }else if(state==ST_WARMING_UP){
-            mvwprintw(sensorsWindow, 2, 1, "Status: Aquecendo");
-        }else if(state==ST_COOLING_DOWN){
-            mvwprintw(sensorsWindow, 2, 1, "Status: Resfriando");
-        }else{
-            mvwprintw(sensorsWindow, 2, 1, "Status: ?????????");
-        }
-    }else if(reference_temp_ready){
-        mvwprintw(sensorsWindow, 1, 1, "> Aguardando definição da temperatura de Histerese");
-    }else if(histeresis_temp_ready){
-        mvwprintw(sensorsWindow, 1, 1, "> Aguardando definição da temperatura de referência");
-    }else{
-        mvwprintw(sensorsWindow, 1, 1, "> Aguardando definição das variáveis de controle");
-    }
-    if(input_mode == KEYBOARD_INPUT){
-        mvwprintw(sensorsWindow, 3, 1, "TR: Temperatura de referência definida manualmente");
+    struct ui_model model;
+    struct sample s;
+    model.running = running;
+    model.state = state;
+    model.input_mode = input_mode;
+    model.reference_temp_ready = reference_temp_ready;
+    model.histeresis_temp_ready = histeresis_temp_ready;
+    model.reference_temp = reference_temp;
+    model.histeresis_temp = histeresis_temp;
+    if(sample_latest(&s)){
+        model.intern_temp = s.intern_temp;
+        model.extern_temp = s.extern_temp;
+        model.intern_raw = s.intern_raw;
+        model.reference_raw = s.reference_raw;
     }else{
-        mvwprintw(sensorsWindow, 3, 1, "TR: Temperatura de referência definida via potenciômetro");
+        // Values restored from the history ring
+        model.intern_temp = model.intern_raw = intern_temp;
+        model.extern_temp = extern_temp;
+        model.reference_raw = reference_temp;
     }
-    if(reference_temp_ready){
-        mvwprintw(sensorsWindow, 4, 1, "Temperatura de referência: %.2f oC", reference_temp);
-    }else{
-        mvwprintw(sensorsWindow, 4, 1, "Temperatura de referência: Não definida");
-    }
-    if(histeresis_temp_ready){
-        mvwprintw(sensorsWindow, 5, 1, "Histerese do sistema: %.2f oC", histeresis_temp);
-    }else{
-        mvwprintw(sensorsWindow, 5, 1, "Histerese do sistema: Não definida");
+    model.filter_ti = filter_enabled(&ti_filter.cfg);
+    model.filter_tr = filter_enabled(&tr_filter.cfg) && input_mode == POTENTIOMETER_INPUT;
+    model.ti_filter = ti_filter.stats;
+    model.tr_filter = tr_filter.stats;
+    model.log_mode = log_mode;
+    logger_get_stats(&model.log);
+    control_get_status(&model.control);
+    model.zones = zones_count();
+    for(int i = 0; i < model.zones; i++){
+        zones_get_status(i, &model.zone[i]);
     }
 
-    mvwprintw(sensorsWindow, 6, 1, "Temperatura interna %.2f oC", intern_temp);
-    mvwprintw(sensorsWindow, 7, 1, "Temperatura externa %.2f oC", extern_temp);
-    wrefresh(sensorsWindow);
+    ui_render_sensors(sensorsWindow, &model);
 }
\ No newline at end of file
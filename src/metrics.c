@@ -0,0 +1,120 @@
+#include <math.h>
+#include <string.h>
+
+#include <metrics.h>
+
+static void openStep(struct metrics *m, int64_t t_ms, float reference){
+    memset(&m->step, 0, sizeof(m->step));
+    m->step.start_ms = t_ms;
+    m->step.end_ms = t_ms;
+    m->step.from = m->last_temp;
+    m->step.reference = reference;
+    m->step.last_out_ms = -1;
+    m->split = false;
+}
+
+static void accumulate(struct metrics_totals *t, double dt, double error, double since_step_s, bool in_band,
+    const struct metrics_input *in){
+    t->duration_s += dt;
+    t->iae += fabs(error) * dt;
+    t->ise += error * error * dt;
+    t->itae += since_step_s * fabs(error) * dt;
+    if(in_band){
+        t->in_band_s += dt;
+    }
+    t->heater_s += in->heater * dt;
+    t->fan_s += in->fan * dt;
+    t->heater_transitions += in->heater_transitions;
+    t->fan_transitions += in->fan_transitions;
+}
+
+void metrics_init(struct metrics *m){
+    memset(m, 0, sizeof(*m));
+}
+
+bool metrics_update(struct metrics *m, const struct metrics_input *in, struct metrics_step *closed){
+    bool res = false;
+    if(!m->started){
+        m->started = true;
+        m->last_temp = in->temp;
+        openStep(m, in->t_ms, in->reference);
+        return false;
+    }
+
+    // The new reference applies to the interval that ends now
+    if(m->split || fabsf(in->reference - m->step.reference) > METRICS_REFERENCE_EPS){
+        if(closed){
+            *closed = m->step;
+        }
+        openStep(m, m->step.end_ms, in->reference);
+        res = true;
+    }
+
+    struct metrics_step *s = &m->step;
+    double dt = (in->t_ms - s->end_ms) / 1000.0;
+    if(dt > 0){
+        float band = in->band > METRICS_MIN_BAND ? in->band : METRICS_MIN_BAND;
+        double error = in->reference - in->temp;
+        bool in_band = fabs(error) <= band;
+        double since_step_s = (in->t_ms - s->start_ms) / 1000.0;
+        accumulate(&s->acc, dt, error, since_step_s, in_band, in);
+        accumulate(&m->total, dt, error, since_step_s, in_band, in);
+        if(!in_band){
+            s->last_out_ms = in->t_ms;
+        }
+        float beyond = s->reference >= s->from ? in->temp - in->reference : in->reference - in->temp;
+        if(beyond > s->overshoot){
+            s->overshoot = beyond;
+        }
+        s->end_ms = in->t_ms;
+    }
+    m->last_temp = in->temp;
+    return res;
+}
+
+void metrics_split(struct metrics *m){
+    m->split = true;
+}
+
+bool metrics_stop(struct metrics *m, struct metrics_step *closed){
+    if(!m->started){
+        return false;
+    }
+    if(closed){
+        *closed = m->step;
+    }
+    m->started = false;
+    return true;
+}
+
+float metrics_settling_s(const struct metrics_step *s){
+    if(s->last_out_ms < 0){
+        return 0;
+    }
+    if(s->end_ms - s->last_out_ms < METRICS_SETTLE_HOLD_MS){
+        return -1;
+    }
+    return (s->last_out_ms - s->start_ms) / 1000.0f;
+}
+
+void metrics_report_totals(const struct metrics_totals *t, struct metrics_report *out){
+    memset(out, 0, sizeof(*out));
+    out->duration_s = (float) t->duration_s;
+    out->settling_s = -1;
+    out->iae = (float) t->iae;
+    out->ise = (float) t->ise;
+    if(t->duration_s > 0){
+        out->in_band = (float) (t->in_band_s / t->duration_s);
+        out->switches_per_hour = (float) ((t->heater_transitions + t->fan_transitions) * 3600.0 / t->duration_s);
+        out->heater_duty = (float) (t->heater_s / t->duration_s);
+        out->fan_duty = (float) (t->fan_s / t->duration_s);
+    }
+}
+
+void metrics_report(const struct metrics_step *s, struct metrics_report *out){
+    metrics_report_totals(&s->acc, out);
+    out->reference = s->reference;
+    out->from = s->from;
+    out->overshoot = s->overshoot;
+    out->settling_s = metrics_settling_s(s);
+}
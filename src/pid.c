@@ -0,0 +1,57 @@
+#include <pid.h>
+
+void pid_init(struct pid *pid, float kp, float ki, float kd, float tf, float out_min, float out_max){
+    pid->kp = kp;
+    pid->ki = ki;
+    pid->kd = kd;
+    pid->tf = tf;
+    pid->out_min = out_min;
+    pid->out_max = out_max;
+    pid_reset(pid);
+}
+
+void pid_reset(struct pid *pid){
+    pid->integral = 0;
+    pid->derivative = 0;
+    pid->prev_measurement = 0;
+    pid->primed = false;
+}
+
+float pid_update(struct pid *pid, float setpoint, float measurement, float dt){
+    float error = setpoint - measurement;
+
+    if(!pid->primed){
+        pid->prev_measurement = measurement;
+        pid->primed = true;
+    }
+    if(dt <= 0){
+        dt = 1e-3f;
+    }
+
+    // Filtered derivative on measurement (no kick on setpoint changes)
+    float raw = -(measurement - pid->prev_measurement) / dt;
+    float alpha = dt / (pid->tf + dt);
+    pid->derivative += alpha * (raw - pid->derivative);
+    pid->prev_measurement = measurement;
+
+    float p = pid->kp * error;
+    float d = pid->kd * pid->derivative;
+    float integral = pid->integral + pid->ki * error * dt;
+    float out = p + integral + d;
+
+    // Anti-windup: keep the integral only if it does not push further into saturation
+    if(out > pid->out_max){
+        if(error < 0){
+            pid->integral = integral;
+        }
+        out = pid->out_max;
+    }else if(out < pid->out_min){
+        if(error > 0){
+            pid->integral = integral;
+        }
+        out = pid->out_min;
+    }else{
+        pid->integral = integral;
+    }
+    return out;
+}
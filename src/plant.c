@@ -0,0 +1,145 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include <plant.h>
+
+void plant_model_defaults(struct plant_model *m){
+    m->tau_s = 600;
+    m->dead_s = 20;
+    m->gain_heater = 40;
+    m->gain_fan = 15;
+    m->ambient = 25;
+    m->ambient_amplitude = 2;
+    m->noise = 0.05f;
+    m->initial = 25;
+}
+
+static float *modelField(struct plant_model *m, const char *key){
+    if(!strcmp(key, "tau_s")) return &m->tau_s;
+    if(!strcmp(key, "atraso_s")) return &m->dead_s;
+    if(!strcmp(key, "ganho_resistor")) return &m->gain_heater;
+    if(!strcmp(key, "ganho_ventoinha")) return &m->gain_fan;
+    if(!strcmp(key, "ambiente")) return &m->ambient;
+    if(!strcmp(key, "ambiente_amplitude")) return &m->ambient_amplitude;
+    if(!strcmp(key, "ruido")) return &m->noise;
+    if(!strcmp(key, "temperatura_inicial")) return &m->initial;
+    return NULL;
+}
+
+// Returns 0, -1 if the file can not be opened or the number of the first bad line
+int plant_model_load(const char *path, struct plant_model *m){
+    FILE *arq = fopen(path, "r");
+    if(!arq){
+        return -1;
+    }
+    char line[256];
+    int line_number = 0;
+    while(fgets(line, sizeof(line), arq)){
+        line_number++;
+        char *comment = strchr(line, '#');
+        if(comment){
+            *comment = '\0';
+        }
+        if(strspn(line, " \t\r\n") == strlen(line)){
+            continue;
+        }
+        char key[64], rest[8];
+        float value;
+        // Exactly "chave = numero"
+        float *field = NULL;
+        if(sscanf(line, " %63[^= \t] = %f %7s", key, &value, rest) == 2){
+            field = modelField(m, key);
+        }
+        if(!field){
+            fclose(arq);
+            return line_number;
+        }
+        *field = value;
+    }
+    fclose(arq);
+    if(m->tau_s <= 0 || m->dead_s < 0){
+        return line_number ? line_number : 1;
+    }
+    return 0;
+}
+
+int plant_model_save(const char *path, const struct plant_model *m, const char *comment){
+    FILE *arq = fopen(path, "w");
+    if(!arq){
+        return -1;
+    }
+    if(comment){
+        fprintf(arq, "# %s\n", comment);
+    }
+    fprintf(arq, "tau_s = %.1f\n", m->tau_s);
+    fprintf(arq, "atraso_s = %.1f\n", m->dead_s);
+    fprintf(arq, "ganho_resistor = %.3f\n", m->gain_heater);
+    fprintf(arq, "ganho_ventoinha = %.3f\n", m->gain_fan);
+    fprintf(arq, "ambiente = %.2f\n", m->ambient);
+    fprintf(arq, "ambiente_amplitude = %.2f\n", m->ambient_amplitude);
+    fprintf(arq, "ruido = %.3f\n", m->noise);
+    fprintf(arq, "temperatura_inicial = %.2f\n", m->initial);
+    return fclose(arq) ? -1 : 0;
+}
+
+int plant_init(struct plant *p, const struct plant_model *m, float step_s, uint64_t seed){
+    p->m = *m;
+    p->step_s = step_s;
+    p->t_s = 0;
+    p->temp = m->initial;
+    p->hist_len = (int) ceilf(m->dead_s / step_s) + 1;
+    p->hist_pos = 0;
+    p->heater_hist = calloc(p->hist_len, sizeof(float));
+    p->fan_hist = calloc(p->hist_len, sizeof(float));
+    p->rng = seed ? seed : 1;
+    if(!p->heater_hist || !p->fan_hist){
+        plant_free(p);
+        return -1;
+    }
+    return 0;
+}
+
+void plant_free(struct plant *p){
+    free(p->heater_hist);
+    free(p->fan_hist);
+    p->heater_hist = p->fan_hist = NULL;
+}
+
+float plant_ambient(const struct plant *p){
+    // Coldest at 04:00, warmest at 16:00 of the simulated day
+    return p->m.ambient - p->m.ambient_amplitude * cos(2 * M_PI * (p->t_s - 4 * 3600) / PLANT_DAY_S);
+}
+
+void plant_step(struct plant *p, float heater, float fan){
+    // The oldest slot holds the input from dead_s ago
+    p->heater_hist[p->hist_pos] = heater;
+    p->fan_hist[p->hist_pos] = fan;
+    p->hist_pos = (p->hist_pos + 1) % p->hist_len;
+    float h = p->heater_hist[p->hist_pos];
+    float f = p->fan_hist[p->hist_pos];
+
+    // Exact discretization of the first-order lag over one step
+    double target = plant_ambient(p) + p->m.gain_heater * h - p->m.gain_fan * f;
+    double alpha = 1 - exp(-p->step_s / p->m.tau_s);
+    p->temp += alpha * (target - p->temp);
+    p->t_s += p->step_s;
+}
+
+// xorshift64* uniform in (0, 1)
+static double uniform(struct plant *p){
+    p->rng ^= p->rng >> 12;
+    p->rng ^= p->rng << 25;
+    p->rng ^= p->rng >> 27;
+    return ((p->rng * 2685821657736338717ULL) >> 11) * (1.0 / 9007199254740992.0) + 1e-17;
+}
+
+float plant_measure(struct plant *p){
+    if(p->m.noise <= 0){
+        return p->temp;
+    }
+    // Box-Muller
+    double n = sqrt(-2 * log(uniform(p))) * cos(2 * M_PI * uniform(p));
+    return p->temp + p->m.noise * n;
+}
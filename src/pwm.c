@@ -0,0 +1,263 @@
+#include <time.h>
+#include <pthread.h>
+#include <sched.h>
+
+#include <pwm.h>
+#include <actuator.h>
+#include <vclock.h>
+
+static pthread_t pwm_thread;
+static pthread_mutex_t pwm_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t pwm_wake;
+static bool active = false;
+static bool threaded = false; // false on the virtual clock (pwm_advance)
+
+static bool levels[2]; // requested output levels
+static float duties[2];
+static int64_t period_ns;
+static int64_t min_on_ns, min_off_ns;
+static int64_t carry[2]; // on time owed to (or by) the output, from the dwell times
+
+// Current period
+static int64_t start;
+static int64_t want[2]; // duty on time plus the carry
+static int64_t on[2];   // falling edge from start; period_ns: stays on
+static int64_t fell[2]; // on time written before the falling edge
+
+static struct pwm_stats stats;
+
+#define HEATER 0
+#define FAN 1
+
+static struct timespec toTimespec(int64_t ns){
+    struct timespec ts;
+    ts.tv_sec = ns / 1000000000LL;
+    ts.tv_nsec = ns % 1000000000LL;
+    return ts;
+}
+
+// The actuator layer caches, applies dwell times and writes both pins at once
+static void writeLevels(bool heater_on, bool fan_on){
+    levels[HEATER] = heater_on;
+    levels[FAN] = fan_on;
+    actuator_set(heater_on, fan_on);
+}
+
+// Sleeps until the absolute deadline; false when woken first (stop or new
+// duty cycles). Called with pwm_lock held.
+static bool waitUntil(int64_t deadline){
+    struct timespec ts = toTimespec(deadline);
+    if(pthread_cond_timedwait(&pwm_wake, &pwm_lock, &ts) == 0){
+        return false;
+    }
+    int64_t late = (vclock_now_ns() - deadline) / 1000;
+    stats.last_jitter_us = late;
+    if(late > stats.max_jitter_us){
+        stats.max_jitter_us = late;
+    }
+    return true;
+}
+
+static int64_t wanted(int output){
+    int steps = (int) (duties[output] * PWM_STEPS + 0.5f);
+    if(steps <= 0){
+        return 0;
+    }
+    if(steps >= PWM_STEPS){
+        return period_ns;
+    }
+    return period_ns / PWM_STEPS * steps + carry[output];
+}
+
+// A pulse shorter than min_on is not written and neither is a gap shorter
+// than min_off; the difference is carried to the next periods, so the mean
+// duty holds
+static int64_t fallAt(int64_t on_ns){
+    if(on_ns < min_on_ns){
+        return 0;
+    }
+    if(on_ns > period_ns - min_off_ns){
+        return period_ns;
+    }
+    return on_ns;
+}
+
+static void beginPeriod(int64_t at){
+    for(int i = 0; i < 2; i++){
+        int64_t applied = levels[i] ? at - start : fell[i];
+        // Fully off or on owes nothing
+        carry[i] = want[i] > 0 && want[i] < period_ns ? want[i] - applied : 0;
+        want[i] = wanted(i);
+        on[i] = fallAt(want[i]);
+        fell[i] = 0;
+    }
+    start = at;
+    writeLevels(on[HEATER] > 0, on[FAN] > 0);
+    stats.periods++;
+}
+
+// A duty change moves the falling edges still due in this period; rises
+// wait for the next one
+static void retime(void){
+    int64_t elapsed = vclock_now_ns() - start;
+    for(int i = 0; i < 2; i++){
+        if(!levels[i]){
+            continue;
+        }
+        want[i] = wanted(i);
+        int64_t t = fallAt(want[i]);
+        // The pulse has started: at least min_on, never in the past
+        t = t > min_on_ns ? t : min_on_ns;
+        on[i] = t > elapsed ? t : elapsed;
+    }
+}
+
+// Earliest falling edge still due in this period, else the next period
+static int64_t nextEdge(void){
+    int64_t next = start + period_ns;
+    for(int i = 0; i < 2; i++){
+        if(levels[i] && on[i] < period_ns && start + on[i] < next){
+            next = start + on[i];
+        }
+    }
+    return next;
+}
+
+static void fireEdge(int64_t at){
+    if(at >= start + period_ns){
+        beginPeriod(at);
+        return;
+    }
+    bool next[2] = { levels[HEATER], levels[FAN] };
+    for(int i = 0; i < 2; i++){
+        if(levels[i] && on[i] < period_ns && start + on[i] <= at){
+            next[i] = false;
+            fell[i] = at - start;
+        }
+    }
+    writeLevels(next[HEATER], next[FAN]);
+}
+
+static void *runPwm(void *args){
+    struct sched_param param;
+    param.sched_priority = PWM_RT_PRIORITY;
+    // Best effort: needs CAP_SYS_NICE
+    pthread_setschedparam(pthread_self(), SCHED_FIFO, &param);
+
+    pthread_mutex_lock(&pwm_lock);
+    beginPeriod(vclock_now_ns());
+    while(active){
+        int64_t deadline = nextEdge();
+        if(waitUntil(deadline)){
+            fireEdge(deadline);
+        }
+    }
+    writeLevels(false, false);
+    pthread_mutex_unlock(&pwm_lock);
+    return NULL;
+}
+
+int pwm_start(int period_ms, int min_on_ms, int min_off_ms){
+    pthread_mutex_lock(&pwm_lock);
+    if(active){
+        pthread_mutex_unlock(&pwm_lock);
+        return 0;
+    }
+    pthread_condattr_t attr;
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    pthread_cond_init(&pwm_wake, &attr);
+    pthread_condattr_destroy(&attr);
+
+    levels[HEATER] = levels[FAN] = false;
+    duties[HEATER] = duties[FAN] = 0;
+    // Lateness is reported per activation
+    stats.last_jitter_us = stats.max_jitter_us = 0;
+    period_ns = (int64_t) (period_ms > 0 ? period_ms : PWM_DEFAULT_PERIOD_MS) * 1000000LL;
+    min_on_ns = (int64_t) (min_on_ms > 0 ? min_on_ms : 0) * 1000000LL;
+    min_off_ns = (int64_t) (min_off_ms > 0 ? min_off_ms : 0) * 1000000LL;
+    for(int i = 0; i < 2; i++){
+        carry[i] = want[i] = fell[i] = 0;
+    }
+    start = vclock_now_ns();
+    active = true;
+    threaded = !vclock_is_virtual();
+    if(!threaded){
+        // Edges are written by pwm_advance
+        beginPeriod(vclock_now_ns());
+    }else if(pthread_create(&pwm_thread, NULL, runPwm, NULL)){
+        active = false;
+        pthread_mutex_unlock(&pwm_lock);
+        return -1;
+    }
+    pthread_mutex_unlock(&pwm_lock);
+    return 0;
+}
+
+void pwm_stop(void){
+    pthread_mutex_lock(&pwm_lock);
+    if(!active){
+        pthread_mutex_unlock(&pwm_lock);
+        return;
+    }
+    active = false;
+    if(!threaded){
+        writeLevels(false, false);
+        pthread_mutex_unlock(&pwm_lock);
+        pthread_cond_destroy(&pwm_wake);
+        return;
+    }
+    pthread_cond_signal(&pwm_wake);
+    pthread_mutex_unlock(&pwm_lock);
+    pthread_join(pwm_thread, NULL);
+    pthread_cond_destroy(&pwm_wake);
+}
+
+void pwm_advance(int64_t ns){
+    int64_t end = vclock_now_ns() + ns;
+    pthread_mutex_lock(&pwm_lock);
+    if(active && !threaded){
+        int64_t t;
+        while((t = nextEdge()) <= end){
+            int64_t now = vclock_now_ns();
+            if(t > now){
+                vclock_advance(t - now);
+            }
+            fireEdge(t);
+        }
+    }
+    pthread_mutex_unlock(&pwm_lock);
+    vclock_advance(end - vclock_now_ns());
+}
+
+bool pwm_running(void){
+    pthread_mutex_lock(&pwm_lock);
+    bool res = active;
+    pthread_mutex_unlock(&pwm_lock);
+    return res;
+}
+
+static float clamp(float v){
+    return v < 0 ? 0 : (v > 1 ? 1 : v);
+}
+
+void pwm_set(float heater_duty, float fan_duty){
+    pthread_mutex_lock(&pwm_lock);
+    duties[HEATER] = clamp(heater_duty);
+    duties[FAN] = clamp(fan_duty);
+    stats.heater_duty = duties[HEATER];
+    stats.fan_duty = duties[FAN];
+    if(active){
+        retime();
+        if(threaded){
+            pthread_cond_signal(&pwm_wake);
+        }
+    }
+    pthread_mutex_unlock(&pwm_lock);
+}
+
+void pwm_get_stats(struct pwm_stats *out){
+    pthread_mutex_lock(&pwm_lock);
+    *out = stats;
+    pthread_mutex_unlock(&pwm_lock);
+}
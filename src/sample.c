@@ -0,0 +1,98 @@
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/eventfd.h>
+
+#include <sample.h>
+#include <vclock.h>
+
+static struct sample latest;
+static uint64_t setpoint_gen = 0;
+static pthread_mutex_t sample_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t sample_cond;
+static int event_fd = -1;
+
+int sample_init(bool with_eventfd){
+    pthread_condattr_t attr;
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    pthread_cond_init(&sample_cond, &attr);
+    pthread_condattr_destroy(&attr);
+
+    if(!with_eventfd){
+        return 0;
+    }
+    event_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    return event_fd < 0 ? -1 : 0;
+}
+
+int sample_eventfd(void){
+    return event_fd;
+}
+
+void sample_drain_eventfd(void){
+    uint64_t count;
+    while(read(event_fd, &count, sizeof(count)) == sizeof(count)){
+    }
+}
+
+int64_t sample_monotonic_ns(void){
+    return vclock_now_ns();
+}
+
+void sample_publish(struct sample *s){
+    pthread_mutex_lock(&sample_lock);
+    s->seq = latest.seq + 1;
+    latest = *s;
+    pthread_cond_broadcast(&sample_cond);
+    pthread_mutex_unlock(&sample_lock);
+
+    if(event_fd >= 0){
+        uint64_t one = 1;
+        ssize_t res = write(event_fd, &one, sizeof(one));
+        (void) res; // counter saturated: the reader is already due to wake
+    }
+}
+
+bool sample_latest(struct sample *s){
+    pthread_mutex_lock(&sample_lock);
+    *s = latest;
+    pthread_mutex_unlock(&sample_lock);
+    return s->seq != 0;
+}
+
+void sample_setpoint_changed(void){
+    pthread_mutex_lock(&sample_lock);
+    setpoint_gen++;
+    pthread_cond_broadcast(&sample_cond);
+    pthread_mutex_unlock(&sample_lock);
+}
+
+int sample_wait(struct sample_cursor *cur, struct sample *s, int timeout_ms){
+    // Real clock: the condition variable waits on CLOCK_MONOTONIC
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    int64_t deadline = (int64_t) now.tv_sec * 1000000000LL + now.tv_nsec + (int64_t) timeout_ms * 1000000;
+    struct timespec ts;
+    ts.tv_sec = deadline / 1000000000LL;
+    ts.tv_nsec = deadline % 1000000000LL;
+
+    int wake = 0;
+    pthread_mutex_lock(&sample_lock);
+    while(latest.seq == cur->seq && setpoint_gen == cur->setpoint_gen){
+        if(pthread_cond_timedwait(&sample_cond, &sample_lock, &ts) != 0){
+            break;
+        }
+    }
+    if(latest.seq != cur->seq){
+        wake |= SAMPLE_WAKE_NEW;
+        cur->seq = latest.seq;
+    }
+    if(setpoint_gen != cur->setpoint_gen){
+        wake |= SAMPLE_WAKE_SETPOINT;
+        cur->setpoint_gen = setpoint_gen;
+    }
+    *s = latest;
+    pthread_mutex_unlock(&sample_lock);
+    return wake;
+}
@@ -0,0 +1,293 @@
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include <tiers.h>
+
+struct tier_header {
+    int64_t resolution_ms;
+    uint32_t capacity;
+    uint32_t head; // slot of the newest (open) bucket
+    uint32_t count;
+    uint32_t reserved;
+    uint64_t offset; // first bucket, bytes from the start of the file
+};
+
+struct tiers_header {
+    uint64_t magic;
+    uint32_t version;
+    uint32_t bucket_size;
+    struct tier_header tier[TIER_COUNT];
+};
+
+static const int64_t RESOLUTION[TIER_COUNT] = {
+    TIER_RAW_RESOLUTION, TIER_1S_RESOLUTION, TIER_1MIN_RESOLUTION, TIER_1H_RESOLUTION
+};
+static const uint32_t CAPACITY[TIER_COUNT] = {
+    TIER_RAW_CAPACITY, TIER_1S_CAPACITY, TIER_1MIN_CAPACITY, TIER_1H_CAPACITY
+};
+
+static int fd = -1;
+static size_t map_size = 0;
+static struct tiers_header *header = NULL;
+static struct tier_bucket *rings[TIER_COUNT];
+
+static pthread_mutex_t tiers_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static size_t layout(void){
+    size_t offset = sizeof(struct tiers_header);
+    for(int t = 0; t < TIER_COUNT; t++){
+        offset += (size_t) CAPACITY[t] * sizeof(struct tier_bucket);
+    }
+    return offset;
+}
+
+static bool headerMatches(void){
+    if(header->magic != TIERS_MAGIC || header->version != TIERS_VERSION
+        || header->bucket_size != sizeof(struct tier_bucket)){
+        return false;
+    }
+    for(int t = 0; t < TIER_COUNT; t++){
+        if(header->tier[t].resolution_ms != RESOLUTION[t] || header->tier[t].capacity != CAPACITY[t]){
+            return false;
+        }
+    }
+    return true;
+}
+
+static void formatFile(void){
+    memset(header, 0, map_size);
+    header->version = TIERS_VERSION;
+    header->bucket_size = sizeof(struct tier_bucket);
+    uint64_t offset = sizeof(struct tiers_header);
+    for(int t = 0; t < TIER_COUNT; t++){
+        header->tier[t].resolution_ms = RESOLUTION[t];
+        header->tier[t].capacity = CAPACITY[t];
+        header->tier[t].head = CAPACITY[t] - 1;
+        header->tier[t].offset = offset;
+        offset += (uint64_t) CAPACITY[t] * sizeof(struct tier_bucket);
+    }
+    header->magic = TIERS_MAGIC;
+    msync(header, map_size, MS_SYNC);
+}
+
+int tiers_open(const char *path){
+    fd = open(path, O_RDWR | O_CREAT, 0644);
+    if(fd < 0){
+        return -1;
+    }
+    map_size = layout();
+
+    struct stat st;
+    if(fstat(fd, &st) < 0){
+        close(fd);
+        fd = -1;
+        return -1;
+    }
+    bool fresh = (size_t) st.st_size != map_size;
+    if(fresh && ftruncate(fd, map_size) < 0){
+        close(fd);
+        fd = -1;
+        return -1;
+    }
+
+    void *map = mmap(NULL, map_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if(map == MAP_FAILED){
+        close(fd);
+        fd = -1;
+        return -1;
+    }
+    header = (struct tiers_header *) map;
+    if(fresh || !headerMatches()){
+        formatFile();
+    }
+    for(int t = 0; t < TIER_COUNT; t++){
+        rings[t] = (struct tier_bucket *) ((uint8_t *) map + header->tier[t].offset);
+    }
+    return 0;
+}
+
+int tiers_open_readonly(const char *path){
+    fd = open(path, O_RDONLY);
+    if(fd < 0){
+        return -1;
+    }
+    map_size = layout();
+
+    struct stat st;
+    void *map = MAP_FAILED;
+    if(fstat(fd, &st) == 0 && (size_t) st.st_size == map_size){
+        map = mmap(NULL, map_size, PROT_READ, MAP_SHARED, fd, 0);
+    }
+    if(map == MAP_FAILED){
+        close(fd);
+        fd = -1;
+        return -1;
+    }
+    header = (struct tiers_header *) map;
+    if(!headerMatches()){
+        munmap(map, map_size);
+        header = NULL;
+        close(fd);
+        fd = -1;
+        return -1;
+    }
+    for(int t = 0; t < TIER_COUNT; t++){
+        rings[t] = (struct tier_bucket *) ((uint8_t *) map + header->tier[t].offset);
+    }
+    return 0;
+}
+
+int64_t tiers_resolution_ms(int tier){
+    return tier >= 0 && tier < TIER_COUNT ? RESOLUTION[tier] : -1;
+}
+
+void tiers_close(void){
+    pthread_mutex_lock(&tiers_lock);
+    if(header){
+        msync(header, map_size, MS_SYNC);
+        munmap(header, map_size);
+        close(fd);
+        header = NULL;
+        fd = -1;
+    }
+    pthread_mutex_unlock(&tiers_lock);
+}
+
+static void openBucket(struct tier_bucket *b, int64_t start_ms, const float values[TIER_CHANNELS]){
+    b->start_ms = start_ms;
+    b->count = 1;
+    b->reserved = 0;
+    for(int c = 0; c < TIER_CHANNELS; c++){
+        b->ch[c].min = b->ch[c].max = b->ch[c].last = values[c];
+        b->ch[c].reserved = 0;
+        b->ch[c].sum = values[c];
+    }
+}
+
+static void updateBucket(struct tier_bucket *b, const float values[TIER_CHANNELS]){
+    b->count++;
+    for(int c = 0; c < TIER_CHANNELS; c++){
+        if(values[c] < b->ch[c].min){
+            b->ch[c].min = values[c];
+        }
+        if(values[c] > b->ch[c].max){
+            b->ch[c].max = values[c];
+        }
+        b->ch[c].last = values[c];
+        b->ch[c].sum += values[c];
+    }
+}
+
+void tiers_add(int64_t ts_ms, const float values[TIER_CHANNELS]){
+    pthread_mutex_lock(&tiers_lock);
+    if(!header){
+        pthread_mutex_unlock(&tiers_lock);
+        return;
+    }
+    for(int t = 0; t < TIER_COUNT; t++){
+        struct tier_header *th = &header->tier[t];
+        int64_t res = th->resolution_ms;
+        int64_t start = res ? ts_ms - ts_ms % res : ts_ms;
+        struct tier_bucket *cur = &rings[t][th->head];
+
+        if(res && th->count && cur->start_ms == start){
+            updateBucket(cur, values);
+        }else if(th->count && start < cur->start_ms){
+            // Clock went backwards: fold into the open bucket
+            updateBucket(cur, values);
+        }else{
+            th->head = (th->head + 1) % th->capacity;
+            openBucket(&rings[t][th->head], start, values);
+            if(th->count < th->capacity){
+                th->count++;
+            }
+        }
+    }
+    pthread_mutex_unlock(&tiers_lock);
+}
+
+// Logical index 0 is the oldest bucket
+static const struct tier_bucket *bucketAt(int t, uint32_t i){
+    const struct tier_header *th = &header->tier[t];
+    uint32_t slot = (th->head + th->capacity + 1 - th->count + i) % th->capacity;
+    return &rings[t][slot];
+}
+
+static int selectTier(int64_t from_ms){
+    // Finest tier still holding the start of the range
+    for(int t = 0; t < TIER_COUNT; t++){
+        const struct tier_header *th = &header->tier[t];
+        if(th->count && bucketAt(t, 0)->start_ms <= from_ms){
+            return t;
+        }
+    }
+    return TIER_COUNT - 1;
+}
+
+int tiers_select(int64_t from_ms){
+    pthread_mutex_lock(&tiers_lock);
+    int t = header ? selectTier(from_ms) : -1;
+    pthread_mutex_unlock(&tiers_lock);
+    return t;
+}
+
+int tiers_query(int64_t from_ms, int64_t to_ms, int channel, struct tier_result *res){
+    if(channel < 0 || channel >= TIER_CHANNELS){
+        return -1;
+    }
+    memset(res, 0, sizeof(*res));
+    pthread_mutex_lock(&tiers_lock);
+    if(!header){
+        pthread_mutex_unlock(&tiers_lock);
+        return -1;
+    }
+    int t = selectTier(from_ms);
+    const struct tier_header *th = &header->tier[t];
+    int64_t width = th->resolution_ms ? th->resolution_ms : 1;
+
+    // Buckets are ordered by start time: binary search the first overlapping one
+    uint32_t lo = 0, hi = th->count;
+    while(lo < hi){
+        uint32_t mid = lo + (hi - lo) / 2;
+        if(bucketAt(t, mid)->start_ms + width <= from_ms){
+            lo = mid + 1;
+        }else{
+            hi = mid;
+        }
+    }
+
+    double sum = 0;
+    res->tier = t;
+    for(uint32_t i = lo; i < th->count; i++){
+        const struct tier_bucket *b = bucketAt(t, i);
+        if(b->start_ms > to_ms){
+            break;
+        }
+        const struct tier_channel *ch = &b->ch[channel];
+        if(res->count == 0){
+            res->first_ms = b->start_ms;
+            res->min = ch->min;
+            res->max = ch->max;
+        }
+        if(ch->min < res->min){
+            res->min = ch->min;
+        }
+        if(ch->max > res->max){
+            res->max = ch->max;
+        }
+        res->last = ch->last;
+        res->last_ms = b->start_ms;
+        res->count += b->count;
+        sum += ch->sum;
+    }
+    if(res->count){
+        res->mean = sum / res->count;
+    }
+    pthread_mutex_unlock(&tiers_lock);
+    return t;
+}
@@ -1,6 +1,10 @@
 #include <fcntl.h>
 #include <termios.h>
 #include <unistd.h>
+#include <string.h>
+#include <math.h>
+
+#include <uart_utils.h>
 
 static const char UART_PATH[] = "/dev/serial0";
 
@@ -22,60 +26,58 @@ int openUart(){
     return uart0;
 }
 
-int getTI(float *TI){
-    int uart = openUart();
-
-    if(uart != -1){
-        char op_buffer[] = {0xA1, 8, 8, 9, 1}; // 170038891
-
-        int res = write(uart, &op_buffer, sizeof(op_buffer));
-        if (res < 0){
-            close(uart);
-            return -2;
-        }
-
-        usleep(200000);
+void uart_encode_request(uint8_t cmd, uint8_t out[UART_REQUEST_SIZE]){
+    static const uint8_t id[] = {8, 8, 9, 1}; // 170038891
+    out[0] = cmd;
+    memcpy(out + 1, id, sizeof(id));
+}
 
-        res = read(uart, (void *) TI, sizeof(float));
-        if (res < 0){
-            close(uart);
-            return -3;
-            
-        }
-    }else{
+// Rejects short reads and values no sensor of the kit can produce
+int uart_decode_temperature(const uint8_t *buf, ssize_t len, float *out){
+    float value;
+    if(len != sizeof(float)){
         return -1;
     }
-
-    // usleep(250000);
-    // *TI = 33.5;
+    memcpy(&value, buf, sizeof(float));
+    if(!isfinite(value) || value < -55 || value > 150){
+        return -1;
+    }
+    *out = value;
     return 0;
 }
 
-int getTR(float *TR){
+static int request(uint8_t cmd, float *out){
     int uart = openUart();
+    if(uart == -1){
+        return -1;
+    }
 
-    if(uart != -1){
-        char op_buffer[] = {0xA2, 8, 8, 9, 1}; // 170038891
-
-        int res = write(uart, &op_buffer, sizeof(op_buffer));
-        if (res < 0){
-            close(uart);
-            return -2;
-        }
+    uint8_t op_buffer[UART_REQUEST_SIZE];
+    uart_encode_request(cmd, op_buffer);
+    int res = write(uart, op_buffer, sizeof(op_buffer));
+    if (res < 0){
+        close(uart);
+        return -2;
+    }
 
-        usleep(200000);
+    usleep(200000);
 
-        res = read(uart, (void *) TR, sizeof(float));
-        if (res < 0){
-            close(uart);
-            return -3;
-            
-        }
-    }else{
-        return -1;
+    uint8_t answer[sizeof(float)];
+    ssize_t len = read(uart, answer, sizeof(answer));
+    close(uart);
+    if (len < 0){
+        return -3;
+    }
+    if(uart_decode_temperature(answer, len, out)){
+        return -4;
     }
-
-    // usleep(250000);
-    // *TR = 35.5;
     return 0;
-}
\ No newline at end of file
+}
+
+int getTI(float *TI){
+    return request(UART_CMD_TI, TI);
+}
+
+int getTR(float *TR){
+    return request(UART_CMD_TR, TR);
+}
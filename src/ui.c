@@ -0,0 +1,321 @@
+#include <stdio.h>
+#include <stdarg.h>
+#include <string.h>
+
+#include <ui.h>
+#include <state.h>
+#include <chart.h>
+
+#define UI_FIELD_MAX 128
+
+// A region of the window redrawn only when its text changes
+struct ui_field {
+    int row;
+    int col;
+    int width; // display columns of the last text
+    bool valid;
+    char text[UI_FIELD_MAX];
+};
+
+// Static labels, drawn once by ui_init_sensors
+#define LABEL_REFERENCE "Temperatura de referência: "
+#define LABEL_HISTERESIS "Histerese do sistema: "
+#define LABEL_INTERN "Temperatura interna "
+#define LABEL_EXTERN "Temperatura externa "
+
+enum {
+    F_STATUS,
+    F_SHADOW,
+    F_LATENCY,
+    F_SOURCE,
+    F_REFERENCE,
+    F_HISTERESIS,
+    F_INTERN,
+    F_EXTERN,
+    F_QUALITY_ERROR,
+    F_QUALITY_BAND,
+    F_QUALITY_STEP,
+    F_QUALITY_ENERGY,
+    F_CONTROL,
+    F_LOG,
+    F_FILTER,
+    F_ZONES,
+    F_COUNT
+};
+
+static struct ui_field fields[F_COUNT];
+
+// Length of the longest prefix of text that fits cols cells. ncurses
+// counts every byte as a cell, so this only avoids cutting a UTF-8
+// character in half
+static int fitBytes(const char *text, int cols){
+    int n = (int) strlen(text);
+    if(n <= cols){
+        return n;
+    }
+    n = cols;
+    while(n > 0 && ((unsigned char) text[n] & 0xC0) == 0x80){
+        n--;
+    }
+    return n;
+}
+
+static void setField(WINDOW *w, struct ui_field *f, const char *fmt, ...){
+    char text[UI_FIELD_MAX];
+    va_list args;
+    va_start(args, fmt);
+    vsnprintf(text, sizeof(text), fmt, args);
+    va_end(args);
+
+    if(f->valid && !strcmp(text, f->text)){
+        return;
+    }
+
+    // Clipped before the right border, so a long text neither wraps nor
+    // takes the border cell
+    int room = getmaxx(w) - 1 - f->col;
+    mvwaddnstr(w, f->row, f->col, text, fitBytes(text, room > 0 ? room : 0));
+    // Cells taken as ncurses counts them
+    int width = getcurx(w) - f->col;
+    // Blank what is left of a longer previous text
+    for(int i = width; i < f->width; i++){
+        waddch(w, ' ');
+    }
+
+    strcpy(f->text, text);
+    f->width = width;
+    f->valid = true;
+}
+
+static void placeField(int id, int row, int col){
+    fields[id].row = row;
+    fields[id].col = col;
+    fields[id].width = 0;
+    fields[id].valid = false;
+}
+
+void ui_init_sensors(WINDOW *sensorsWindow){
+    werase(sensorsWindow);
+    box(sensorsWindow, 0, 0);
+    // Left column up to col 48, right one from col 50 to the border at
+    // MIN_COLS; fields that take a whole row stay below 88 columns
+    placeField(F_STATUS, 1, 1);
+    placeField(F_SHADOW, 1, 50);
+    placeField(F_SOURCE, 2, 1);
+    placeField(F_LATENCY, 2, 50);
+    // Rows 1..10 are all the window has at MIN_ROWS
+    placeField(F_ZONES, 3, 1);
+    // Values start where ncurses left the cursor after the label
+    mvwaddstr(sensorsWindow, 4, 1, LABEL_REFERENCE);
+    placeField(F_REFERENCE, 4, getcurx(sensorsWindow));
+    mvwaddstr(sensorsWindow, 5, 1, LABEL_HISTERESIS);
+    placeField(F_HISTERESIS, 5, getcurx(sensorsWindow));
+    mvwaddstr(sensorsWindow, 6, 1, LABEL_INTERN);
+    placeField(F_INTERN, 6, getcurx(sensorsWindow));
+    mvwaddstr(sensorsWindow, 7, 1, LABEL_EXTERN);
+    placeField(F_EXTERN, 7, getcurx(sensorsWindow));
+    placeField(F_QUALITY_ERROR, 4, 50);
+    placeField(F_QUALITY_BAND, 5, 50);
+    placeField(F_QUALITY_STEP, 6, 50);
+    placeField(F_QUALITY_ENERGY, 7, 50);
+    placeField(F_CONTROL, 8, 1);
+    placeField(F_LOG, 9, 1);
+    placeField(F_FILTER, 10, 1);
+
+    // Trend chart in the remaining rows
+    chart_init(sensorsWindow, 12, getmaxy(sensorsWindow) - 2);
+}
+
+void ui_render_sensors(WINDOW *sensorsWindow, const struct ui_model *m){
+    if(m->running){
+        if(m->state == ST_STAND_BY){
+            setField(sensorsWindow, &fields[F_STATUS], "> Executando: dentro da faixa de histerese");
+        }else if(m->state == ST_WARMING_UP){
+            setField(sensorsWindow, &fields[F_STATUS], "> Executando: aquecendo");
+        }else if(m->state == ST_COOLING_DOWN){
+            setField(sensorsWindow, &fields[F_STATUS], "> Executando: resfriando");
+        }else{
+            setField(sensorsWindow, &fields[F_STATUS], "> Executando: ?????????");
+        }
+    }else{
+        if(m->reference_temp_ready){
+            setField(sensorsWindow, &fields[F_STATUS], "> Aguardando a histerese");
+        }else if(m->histeresis_temp_ready){
+            setField(sensorsWindow, &fields[F_STATUS], "> Aguardando a temperatura de referência");
+        }else{
+            setField(sensorsWindow, &fields[F_STATUS], "> Aguardando referência e histerese");
+        }
+    }
+    if(m->control.shadows){
+        const struct control_shadow_status *sh = &m->control.shadow[0];
+        setField(sensorsWindow, &fields[F_SHADOW], "Sombra %s: u %+.2f, div. %.2f",
+            controller_name(sh->type), sh->output, sh->divergence);
+    }else{
+        setField(sensorsWindow, &fields[F_SHADOW], "");
+    }
+    if(m->control.reactions){
+        setField(sensorsWindow, &fields[F_LATENCY], "Reação: %.2f ms (máx %.2f ms)",
+            m->control.latency_last_us / 1000.0, m->control.latency_max_us / 1000.0);
+    }else{
+        setField(sensorsWindow, &fields[F_LATENCY], "");
+    }
+
+    // The raw TR sits on the source row: after LABEL_REFERENCE it would
+    // run into the right column
+    if(m->input_mode == KEYBOARD_INPUT){
+        setField(sensorsWindow, &fields[F_SOURCE], "TR: definida manualmente");
+    }else if(m->reference_temp_ready && m->filter_tr){
+        setField(sensorsWindow, &fields[F_SOURCE], "TR: definida via potenciômetro, bruta %.2f oC", m->reference_raw);
+    }else{
+        setField(sensorsWindow, &fields[F_SOURCE], "TR: definida via potenciômetro");
+    }
+    if(m->reference_temp_ready){
+        setField(sensorsWindow, &fields[F_REFERENCE], "%.2f oC", m->reference_temp);
+    }else{
+        setField(sensorsWindow, &fields[F_REFERENCE], "Não definida");
+    }
+    if(m->histeresis_temp_ready){
+        setField(sensorsWindow, &fields[F_HISTERESIS], "%.2f oC", m->histeresis_temp);
+    }else{
+        setField(sensorsWindow, &fields[F_HISTERESIS], "Não definida");
+    }
+    if(m->filter_ti){
+        setField(sensorsWindow, &fields[F_INTERN], "%.2f oC (bruta %.2f)", m->intern_temp, m->intern_raw);
+    }else{
+        setField(sensorsWindow, &fields[F_INTERN], "%.2f oC", m->intern_temp);
+    }
+    setField(sensorsWindow, &fields[F_EXTERN], "%.2f oC", m->extern_temp);
+
+    const struct control_status *c = &m->control;
+    const struct actuator_stats *a = &c->actuator;
+    // Quality of the current setpoint step
+    const struct metrics_report *q = &c->metrics_step;
+    if(q->duration_s > 0){
+        setField(sensorsWindow, &fields[F_QUALITY_ERROR], "Degrau: IAE %.0f oC.s, ISE %.0f", q->iae, q->ise);
+        setField(sensorsWindow, &fields[F_QUALITY_BAND], "Na faixa %.1f%%, %.1f comutações/h",
+            q->in_band * 100, q->switches_per_hour);
+        if(q->settling_s < 0){
+            setField(sensorsWindow, &fields[F_QUALITY_STEP], "Sobressinal %.2f oC, acomodando", q->overshoot);
+        }else{
+            setField(sensorsWindow, &fields[F_QUALITY_STEP], "Sobressinal %.2f oC, acomodação %.0f s",
+                q->overshoot, q->settling_s);
+        }
+        setField(sensorsWindow, &fields[F_QUALITY_ENERGY], "Energia: resistor %.0f%%, ventoinha %.0f%%",
+            q->heater_duty * 100, q->fan_duty * 100);
+    }else{
+        setField(sensorsWindow, &fields[F_QUALITY_ERROR], "");
+        setField(sensorsWindow, &fields[F_QUALITY_BAND], "");
+        setField(sensorsWindow, &fields[F_QUALITY_STEP], "");
+        setField(sensorsWindow, &fields[F_QUALITY_ENERGY], "");
+    }
+
+    unsigned long long transitions = a->out[ACTUATOR_HEATER].transitions + a->out[ACTUATOR_FAN].transitions;
+    if(c->autotune_status == AUTOTUNE_RUNNING){
+        setField(sensorsWindow, &fields[F_CONTROL], "Auto-sintonia por relé (%s): ciclo %d de %d",
+            autotune_rule_name(c->autotune_rule), c->autotune_cycle, c->autotune_cycles);
+    }else if(c->mode == CONTROL_PID){
+        setField(sensorsWindow, &fields[F_CONTROL], "Controle PID: resistor %3.0f%%, ventoinha %3.0f%%, jitter max %lld us, %llu transições",
+            c->pwm.heater_duty * 100, c->pwm.fan_duty * 100, (long long) c->pwm.max_jitter_us, transitions);
+    }else if(c->mode == CONTROL_SMITH){
+        setField(sensorsWindow, &fields[F_CONTROL], "Smith: resistor %3.0f%%, ventoinha %3.0f%%, TI prevista %.2f, cálculo %.1f/%.1f us",
+            c->pwm.heater_duty * 100, c->pwm.fan_duty * 100, c->predicted,
+            c->timing.last_ns / 1000.0, c->timing.max_ns / 1000.0);
+    }else if(c->autotune_status == AUTOTUNE_DONE){
+        setField(sensorsWindow, &fields[F_CONTROL], "Sintonia %s: kp %.3f ki %.5f kd %.2f, acomodação ~%.0f s%s",
+            autotune_rule_name(c->autotune_rule), c->autotune.kp, c->autotune.ki, c->autotune.kd,
+            c->autotune.settling_s, c->gains_saved ? "" : " (não salva)");
+    }else if(c->autotune_status == AUTOTUNE_FAILED){
+        setField(sensorsWindow, &fields[F_CONTROL], "Controle: histerese (auto-sintonia sem oscilação válida)");
+    }else{
+        setField(sensorsWindow, &fields[F_CONTROL], "Controle: histerese; resistor %.0f%%, ventoinha %.0f%% do tempo, %llu transições",
+            a->out[ACTUATOR_HEATER].duty * 100, a->out[ACTUATOR_FAN].duty * 100, transitions);
+    }
+
+    setField(sensorsWindow, &fields[F_LOG], "Log (%s): %llu amostras, %llu eventos, %llu descartados",
+        m->log_mode == LOG_MODE_FULL_RATE ? "completo" : "periódico",
+        (unsigned long long) m->log.samples_written, (unsigned long long) m->log.events_written,
+        (unsigned long long) (m->log.samples_dropped + m->log.events_dropped));
+
+    if(m->filter_ti || m->filter_tr){
+        setField(sensorsWindow, &fields[F_FILTER], "Filtros: %llu TI e %llu TR rejeitadas; %llu comutações sem filtro, %llu com filtro",
+            (unsigned long long) m->ti_filter.rejected, (unsigned long long) m->tr_filter.rejected,
+            (unsigned long long) c->switches_unfiltered, (unsigned long long) c->switches_filtered);
+    }else{
+        setField(sensorsWindow, &fields[F_FILTER], "");
+    }
+
+    // One "nome TI/TR" per zone, the whole zones that fit in the row
+    char zones[UI_FIELD_MAX] = "";
+    int len = 0;
+    int room = getmaxx(sensorsWindow) - 2 < (int) sizeof(zones) ? getmaxx(sensorsWindow) - 2 : (int) sizeof(zones) - 1;
+    for(int i = 0; i < m->zones; i++){
+        const struct zone_status *z = &m->zone[i];
+        const char *mark = z->state == ST_WARMING_UP ? "+" : z->state == ST_COOLING_DOWN ? "-" : "";
+        char item[UI_FIELD_MAX];
+        int n;
+        if(z->valid){
+            n = snprintf(item, sizeof(item), "%s%s %.1f/%.1f%s", i ? ", " : "Zonas: ",
+                z->name, z->intern_temp, z->reference_temp, mark);
+        }else{
+            n = snprintf(item, sizeof(item), "%s%s sem leitura", i ? ", " : "Zonas: ", z->name);
+        }
+        if(len + n > room){
+            break;
+        }
+        strcpy(zones + len, item);
+        len += n;
+    }
+    setField(sensorsWindow, &fields[F_ZONES], "%s", zones);
+
+    chart_render(sensorsWindow);
+
+    // The caller batches the terminal update with doupdate
+    wnoutrefresh(sensorsWindow);
+}
+
+void ui_input_begin(struct ui_input *in, int target, const char *prompt){
+    in->active = true;
+    in->dirty = true;
+    in->target = target;
+    in->prompt = prompt;
+    in->len = 0;
+    in->buf[0] = '\0';
+}
+
+int ui_input_key(struct ui_input *in, int ch){
+    if(ch == '\n' || ch == '\r' || ch == KEY_ENTER){
+        in->active = false;
+        in->dirty = true;
+        return UI_INPUT_DONE;
+    }
+    if(ch == 27){ // ESC
+        in->active = false;
+        in->dirty = true;
+        return UI_INPUT_CANCELLED;
+    }
+    if(ch == KEY_BACKSPACE || ch == 127 || ch == 8){
+        if(in->len > 0){
+            in->buf[--in->len] = '\0';
+            in->dirty = true;
+        }
+    }else if(((ch >= '0' && ch <= '9') || ch == '.' || ch == '-') && in->len < UI_INPUT_MAX){
+        in->buf[in->len++] = (char) ch;
+        in->buf[in->len] = '\0';
+        in->dirty = true;
+    }
+    return UI_INPUT_EDITING;
+}
+
+void ui_render_input(WINDOW *inputWindow, struct ui_input *in){
+    if(!in->dirty){
+        return;
+    }
+    werase(inputWindow);
+    box(inputWindow, 0, 0);
+    if(in->active){
+        mvwaddstr(inputWindow, 1, 1, in->prompt);
+        mvwprintw(inputWindow, 2, 1, "> %s_", in->buf);
+    }
+    wnoutrefresh(inputWindow);
+    in->dirty = false;
+}
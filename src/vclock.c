@@ -0,0 +1,33 @@
+#include <time.h>
+#include <stdatomic.h>
+
+#include <vclock.h>
+
+static atomic_bool virtual_clock = false;
+static atomic_llong virtual_ns = 0;
+
+int64_t vclock_now_ns(void){
+    if(atomic_load_explicit(&virtual_clock, memory_order_relaxed)){
+        return atomic_load_explicit(&virtual_ns, memory_order_acquire);
+    }
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t) ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+int64_t vclock_now_ms(void){
+    return vclock_now_ns() / 1000000;
+}
+
+void vclock_enable_virtual(int64_t start_ns){
+    atomic_store(&virtual_ns, start_ns);
+    atomic_store(&virtual_clock, true);
+}
+
+void vclock_advance(int64_t ns){
+    atomic_fetch_add_explicit(&virtual_ns, ns, memory_order_release);
+}
+
+bool vclock_is_virtual(void){
+    return atomic_load(&virtual_clock);
+}
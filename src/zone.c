@@ -0,0 +1,351 @@
+#include <stdio.h>
+#include <string.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <time.h>
+
+#include <zone.h>
+#include <bme280.h>
+#include <controller.h>
+#include <hal.h>
+#include <i2cbus.h>
+#include <logger.h>
+#include <state.h>
+#include <vclock.h>
+
+struct zone {
+    struct zone_config cfg;
+    struct controller ctl;
+    struct metrics metrics;
+    struct i2c_bus *bus;
+    struct hal_i2c_dev i2c;
+    struct bme280_dev dev;
+    pthread_t thread;
+    int stream; // logger stream of the zone's data/events files
+
+    // Outputs, owned by the zone thread
+    bool on[2];
+    int64_t on_ms[2];      // since the last metrics update
+    uint32_t transitions[2];
+    int errors;            // consecutive failed reads
+
+    struct zone_status status; // under zones_lock
+};
+
+static pthread_mutex_t zones_lock = PTHREAD_MUTEX_INITIALIZER;
+static struct zone zones[ZONE_MAX];
+static int zone_count = 0;
+static atomic_bool stopping = false;
+static float ambient = 25;
+static float main_reference = 0;
+static bool main_reference_set = false;
+
+void zones_set_ambient(float extern_temp){
+    pthread_mutex_lock(&zones_lock);
+    ambient = extern_temp;
+    pthread_mutex_unlock(&zones_lock);
+}
+
+void zones_set_reference(float reference_temp){
+    pthread_mutex_lock(&zones_lock);
+    main_reference = reference_temp;
+    main_reference_set = true;
+    pthread_mutex_unlock(&zones_lock);
+}
+
+static int64_t monotonicUs(void){
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t) ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static void writeOutputs(struct zone *z, int state){
+    uint32_t mask = (1u << z->cfg.heater_pin) | (1u << z->cfg.fan_pin);
+    uint32_t value = 0;
+    if(!z->on[0]){
+        value |= 1u << z->cfg.heater_pin; // active low
+    }
+    if(!z->on[1]){
+        value |= 1u << z->cfg.fan_pin;
+    }
+    hal->gpio->write_mask(value, mask);
+    logger_push_stream_event(z->stream, state, z->on[0] ? 0 : 1, z->on[1] ? 0 : 1);
+}
+
+// Levels for this tick: on/off laws as they are, pwm laws by the phase
+// within the PWM period
+static void setOutputs(struct zone *z, int64_t now_ms, int64_t tick_ms){
+    float demand[2] = { z->ctl.out.heater, z->ctl.out.fan };
+    bool want[2];
+    for(int i = 0; i < 2; i++){
+        if(z->errors >= ZONE_MAX_READ_ERRORS){
+            want[i] = false;
+        }else if(z->ctl.ops->pwm){
+            want[i] = now_ms % z->cfg.pwm_period_ms < demand[i] * z->cfg.pwm_period_ms;
+        }else{
+            want[i] = demand[i] > 0.5f;
+        }
+        if(z->on[i]){
+            z->on_ms[i] += tick_ms;
+        }
+    }
+    if(want[0] != z->on[0] || want[1] != z->on[1]){
+        for(int i = 0; i < 2; i++){
+            z->transitions[i] += want[i] != z->on[i];
+            z->on[i] = want[i];
+        }
+        writeOutputs(z, z->ctl.out.state);
+    }
+}
+
+// Forced conversion of the temperature only; the bus is free while it runs.
+// The reentrant driver calls leave z->dev untouched
+static int8_t readTemperature(struct zone *z, float *temp, int64_t *waited_us){
+    int64_t waited = i2c_bus_acquire(z->bus);
+    int8_t rslt = bme280_start_forced_r(&z->dev.settings, &z->dev);
+    i2c_bus_release(z->bus);
+    if(rslt != BME280_OK){
+        *waited_us = waited / 1000;
+        return rslt;
+    }
+    z->dev.delay_us(1000 * bme280_cal_meas_delay(&z->dev.settings), z->dev.intf_ptr);
+
+    struct bme280_data data;
+    waited += i2c_bus_acquire(z->bus);
+    rslt = bme280_get_sensor_data_r(BME280_TEMP, &data, &z->dev);
+    i2c_bus_release(z->bus);
+    *waited_us = waited / 1000;
+#ifdef BME280_FLOAT_ENABLE
+    *temp = data.temperature;
+#else
+    *temp = 0.01f * data.temperature;
+#endif
+    return rslt;
+}
+
+static void update(struct zone *z, int64_t now_ms, int64_t *last_ms){
+    int64_t start_us = monotonicUs();
+    float temp = 0, te, reference;
+    int64_t waited_us;
+    int8_t rslt = readTemperature(z, &temp, &waited_us);
+
+    pthread_mutex_lock(&zones_lock);
+    te = ambient;
+    reference = z->cfg.follow_reference ? main_reference : z->cfg.reference;
+    bool ready = !z->cfg.follow_reference || main_reference_set;
+    pthread_mutex_unlock(&zones_lock);
+
+    z->errors = rslt == BME280_OK ? 0 : z->errors + 1;
+    if(rslt == BME280_OK && ready){
+        struct controller_input in = { now_ms, reference, temp, z->cfg.histeresis / 2, te };
+        controller_update(&z->ctl, &in);
+        logger_push_stream_sample(z->stream, reference, temp, te);
+
+        float dt = (now_ms - *last_ms) / 1000.0f;
+        struct metrics_input mi = { now_ms, reference, temp, z->cfg.histeresis / 2,
+            dt > 0 ? z->on_ms[0] / 1000.0f / dt : 0, dt > 0 ? z->on_ms[1] / 1000.0f / dt : 0,
+            z->transitions[0], z->transitions[1] };
+        metrics_update(&z->metrics, &mi, NULL);
+        z->on_ms[0] = z->on_ms[1] = 0;
+        z->transitions[0] = z->transitions[1] = 0;
+        *last_ms = now_ms;
+    }
+
+    int64_t took_us = monotonicUs() - start_us;
+    pthread_mutex_lock(&zones_lock);
+    struct zone_status *s = &z->status;
+    s->reads++;
+    if(rslt != BME280_OK){
+        s->read_errors++;
+    }else{
+        s->valid = true;
+        s->intern_temp = temp;
+    }
+    s->reference_temp = reference;
+    s->heater = z->ctl.out.heater;
+    s->fan = z->ctl.out.fan;
+    s->state = z->errors >= ZONE_MAX_READ_ERRORS ? ST_STAND_BY : z->ctl.out.state;
+    if(waited_us > s->bus_wait_max_us){
+        s->bus_wait_max_us = waited_us;
+    }
+    if(took_us > s->update_max_us){
+        s->update_max_us = took_us;
+    }
+    metrics_report_totals(&z->metrics.total, &s->metrics_total);
+    pthread_mutex_unlock(&zones_lock);
+}
+
+static void addMs(struct timespec *ts, int ms){
+    ts->tv_sec += ms / 1000;
+    ts->tv_nsec += (long) (ms % 1000) * 1000000L;
+    if(ts->tv_nsec >= 1000000000L){
+        ts->tv_sec++;
+        ts->tv_nsec -= 1000000000L;
+    }
+}
+
+// Absolute deadlines: the period does not drift with the work done
+static void *runZone(void *args){
+    struct zone *z = args;
+    struct timespec next;
+    clock_gettime(CLOCK_MONOTONIC, &next);
+    int64_t last_ms = vclock_now_ms();
+    int64_t next_update_ms = last_ms;
+    while(!atomic_load(&stopping)){
+        int64_t now_ms = vclock_now_ms();
+        if(now_ms >= next_update_ms){
+            update(z, now_ms, &last_ms);
+            next_update_ms += z->cfg.period_ms;
+            if(next_update_ms <= now_ms){
+                next_update_ms = now_ms + z->cfg.period_ms;
+            }
+        }
+        setOutputs(z, vclock_now_ms(), ZONE_TICK_MS);
+        addMs(&next, ZONE_TICK_MS);
+        clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &next, NULL);
+    }
+    return NULL;
+}
+
+static bool pinsTaken(const struct zone_config *zones, int index){
+    const struct zone_config *z = &zones[index];
+    if(z->heater_pin == z->fan_pin || z->heater_pin >= 32 || z->fan_pin >= 32){
+        return true;
+    }
+    uint8_t pins[2] = { z->heater_pin, z->fan_pin };
+    for(int p = 0; p < 2; p++){
+        if(pins[p] == HAL_HEATER_PIN || pins[p] == HAL_FAN_PIN){
+            return true;
+        }
+        for(int i = 0; i < index; i++){
+            if(pins[p] == zones[i].heater_pin || pins[p] == zones[i].fan_pin){
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+static bool sensorTaken(const struct zone_config *zones, int index){
+    const struct zone_config *z = &zones[index];
+    // The main BME280 (TE)
+    if(z->addr == BME280_I2C_ADDR_PRIM && !strcmp(z->bus, ZONE_DEFAULT_BUS)){
+        return true;
+    }
+    for(int i = 0; i < index; i++){
+        if(zones[i].addr == z->addr && !strcmp(zones[i].bus, z->bus)){
+            return true;
+        }
+    }
+    return false;
+}
+
+static void closeSensor(struct zone *z){
+    if(z->i2c.fd >= 0){
+        hal->i2c->close(&z->i2c);
+    }
+}
+
+static int openSensor(struct zone *z){
+    z->bus = i2c_bus_get(z->cfg.bus);
+    if(!z->bus || hal->i2c->open(&z->i2c, z->cfg.bus, z->cfg.addr)){
+        z->i2c.fd = -1;
+        return -1;
+    }
+    z->dev.intf = BME280_I2C_INTF;
+    z->dev.read = hal->i2c->read;
+    z->dev.write = hal->i2c->write;
+    z->dev.delay_us = hal->i2c->delay_us;
+    z->dev.intf_ptr = &z->i2c;
+    i2c_bus_acquire(z->bus);
+    int8_t rslt = bme280_init(&z->dev);
+    if(rslt == BME280_OK){
+        z->dev.settings.osr_t = BME280_OVERSAMPLING_2X;
+        z->dev.settings.filter = BME280_FILTER_COEFF_OFF;
+        rslt = bme280_set_sensor_settings(BME280_OSR_TEMP_SEL | BME280_FILTER_SEL, &z->dev);
+    }
+    i2c_bus_release(z->bus);
+    if(rslt != BME280_OK){
+        closeSensor(z);
+        return -1;
+    }
+    return 0;
+}
+
+// Written by the logger thread, closed by logger_stop
+static int openLogs(struct zone *z){
+    char data_path[64], events_path[64];
+    snprintf(data_path, sizeof(data_path), "./%.*s_data.csv", ZONE_NAME_MAX - 1, z->cfg.name);
+    snprintf(events_path, sizeof(events_path), "./%.*s_events.csv", ZONE_NAME_MAX - 1, z->cfg.name);
+    z->stream = logger_add_stream(data_path, events_path);
+    return z->stream > 0 ? 0 : -1;
+}
+
+int zones_start(const struct zone_config *cfg, int count, const struct control_config *control, int *failed){
+    atomic_store(&stopping, false);
+    zone_count = 0;
+    int res = 0;
+    for(int i = 0; i < count && i < ZONE_MAX && !res; i++){
+        struct zone *z = &zones[i];
+        memset(z, 0, sizeof(*z));
+        z->cfg = cfg[i];
+        z->i2c.fd = -1;
+        *failed = i;
+        if(pinsTaken(cfg, i)){
+            res = ZONE_E_PINS;
+        }else if(sensorTaken(cfg, i) || openSensor(z)){
+            res = ZONE_E_SENSOR;
+        }else if(openLogs(z)){
+            res = ZONE_E_LOG;
+        }
+        if(res){
+            closeSensor(z);
+            break;
+        }
+
+        struct controller_config cc;
+        control_controller_config(control, z->cfg.controller, &cc);
+        controller_init(&z->ctl, &cc);
+        metrics_init(&z->metrics);
+        strcpy(z->status.name, z->cfg.name);
+        z->status.controller = z->cfg.controller;
+        hal->gpio->set_output(z->cfg.heater_pin);
+        hal->gpio->set_output(z->cfg.fan_pin);
+        writeOutputs(z, ST_STAND_BY);
+
+        if(pthread_create(&z->thread, NULL, runZone, z)){
+            res = ZONE_E_THREAD;
+            closeSensor(z);
+            break;
+        }
+        zone_count++;
+    }
+    if(res){
+        zones_stop();
+    }
+    return res;
+}
+
+void zones_stop(void){
+    atomic_store(&stopping, true);
+    for(int i = 0; i < zone_count; i++){
+        struct zone *z = &zones[i];
+        pthread_join(z->thread, NULL);
+        if(z->on[0] || z->on[1]){
+            z->on[0] = z->on[1] = false;
+            writeOutputs(z, ST_STAND_BY);
+        }
+        closeSensor(z);
+    }
+    zone_count = 0;
+}
+
+int zones_count(void){
+    return zone_count;
+}
+
+void zones_get_status(int index, struct zone_status *status){
+    pthread_mutex_lock(&zones_lock);
+    *status = zones[index].status;
+    pthread_mutex_unlock(&zones_lock);
+}
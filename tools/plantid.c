@@ -0,0 +1,584 @@
+/*
+* Thermal model identification from the recorded logs.
+*
+* Usage: plantid [-f data.csv] [-e events.csv] [-H histerese] [-a atraso_max] [-o planta.conf] [INICIO FIM]
+*
+* Fits the first-order-plus-dead-time model of plant.h to TI, TE and the
+* actuator levels by least squares and writes it in the model file format
+* (modelo_planta, simulate -m). The inputs come from events.csv or, without
+* it, are rebuilt from TI and TR with the hysteresis law.
+*
+* The data is cut into windows of WINDOW_S seconds without gaps. Over each
+* window the model integrates to
+*
+*   T(b) - T(a) = cT*int(T) + cE*int(TE) + ch*int(h(t - theta)) + cf*int(f(t - theta)) + c0*(b - a)
+*
+* with tau = -1/cT, Kh = ch*tau, Kf = -cf*tau, and TE entering as
+* Ta = k*TE + offset (k = cE*tau, offset = c0*tau). The integrals of the
+* inputs are piecewise linear, so one pass over the log accumulates the
+* normal equations of every dead time candidate at once.
+*/
+
+#define _XOPEN_SOURCE 700
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <unistd.h>
+#include <time.h>
+
+#include <csvlog.h>
+#include <controller.h>
+#include <plant.h>
+#include <state.h>
+
+#define WINDOW_S 30
+// Gaps longer than this (program stopped) split the windows
+#define MAX_GAP_MS 10000
+#define DEAD_STEP_S 2
+#define DEFAULT_MAX_DEAD_S 300
+// TE range below which its coupling is not identifiable and is fixed at 1
+#define TE_MIN_RANGE 1.0f
+
+// Window integrals, the regressors of the fit; X_Y is T(b) - T(a)
+enum { X_T, X_TE, X_H, X_F, X_1, X_Y, X_COUNT };
+
+#define WINDOW_CLASSES 4
+static const char *const CLASS_NAMES[WINDOW_CLASSES] = { "aquecimento", "resfriamento", "livre", "misto" };
+
+// Actuator levels from a given instant on, with their integrals up to it
+struct input_step {
+    int64_t ts_ms;
+    bool restart; // outputs off while the program was stopped
+    float heater;
+    float fan;
+    double cum_heater; // s
+    double cum_fan;
+};
+
+struct inputs {
+    struct input_step *v;
+    size_t n, cap;
+};
+
+struct window_stats {
+    size_t windows[WINDOW_CLASSES];
+    size_t segments[WINDOW_CLASSES];
+    int last_class;
+};
+
+static void printUsage(const char *name){
+    printf("Uso: %s [-f arquivo] [-e eventos] [-H histerese] [-a atraso_max] [-o modelo] [INICIO FIM]\n", name);
+    printf("  INICIO e FIM no formato \"AAAA-MM-DD HH:MM[:SS]\" (hora local; padrão: o log inteiro)\n");
+    printf("  -f  Log de temperaturas (padrão: ./data.csv)\n");
+    printf("  -e  Eventos dos atuadores (padrão: ./events.csv)\n");
+    printf("  -H  Sem eventos: reconstrói as saídas pela histerese H\n");
+    printf("  -a  Maior atraso testado, em segundos (padrão: %d)\n", DEFAULT_MAX_DEAD_S);
+    printf("  -o  Arquivo do modelo (padrão: planta.conf)\n");
+}
+
+static int64_t parseArgTime(const char *s){
+    struct tm tm;
+    memset(&tm, 0, sizeof(tm));
+    const char *rest = strptime(s, "%Y-%m-%d %H:%M:%S", &tm);
+    if(!rest){
+        memset(&tm, 0, sizeof(tm));
+        rest = strptime(s, "%Y-%m-%d %H:%M", &tm);
+    }
+    if(!rest || *rest){
+        return -1;
+    }
+    tm.tm_isdst = -1;
+    return (int64_t) mktime(&tm) * 1000;
+}
+
+static void pushInput(struct inputs *in, int64_t ts_ms, bool restart, float heater, float fan){
+    if(in->n == in->cap){
+        size_t cap = in->cap ? in->cap * 2 : 4096;
+        struct input_step *grown = realloc(in->v, cap * sizeof(*grown));
+        if(!grown){
+            fprintf(stderr, "Sem memória\n");
+            exit(3);
+        }
+        in->v = grown;
+        in->cap = cap;
+    }
+    in->v[in->n++] = (struct input_step) { ts_ms, restart, heater, fan, 0, 0 };
+}
+
+// By time; at the same instant a restart comes before the real events
+static int compareInput(const void *a, const void *b){
+    const struct input_step *x = a, *y = b;
+    if(x->ts_ms != y->ts_ms){
+        return (x->ts_ms > y->ts_ms) - (x->ts_ms < y->ts_ms);
+    }
+    return (int) y->restart - (int) x->restart;
+}
+
+static void integrateInputs(struct inputs *in){
+    qsort(in->v, in->n, sizeof(*in->v), compareInput);
+    for(size_t i = 1; i < in->n; i++){
+        double dt = (in->v[i].ts_ms - in->v[i - 1].ts_ms) / 1000.0;
+        in->v[i].cum_heater = in->v[i - 1].cum_heater + in->v[i - 1].heater * dt;
+        in->v[i].cum_fan = in->v[i - 1].cum_fan + in->v[i - 1].fan * dt;
+    }
+}
+
+// Integral of heater and fan up to t_ms. hint is the step of the previous
+// query and moves from there, so nearby queries cost O(1)
+static void cumulative(const struct inputs *in, int64_t t_ms, size_t *hint, double *heater, double *fan){
+    if(!in->n || t_ms < in->v[0].ts_ms){
+        // Off before the first event
+        *heater = *fan = 0;
+        return;
+    }
+    size_t i = *hint < in->n ? *hint : in->n - 1;
+    while(i > 0 && in->v[i].ts_ms > t_ms){
+        i--;
+    }
+    while(i + 1 < in->n && in->v[i + 1].ts_ms <= t_ms){
+        i++;
+    }
+    *hint = i;
+    double dt = (t_ms - in->v[i].ts_ms) / 1000.0;
+    *heater = in->v[i].cum_heater + in->v[i].heater * dt;
+    *fan = in->v[i].cum_fan + in->v[i].fan * dt;
+}
+
+static size_t findStep(const struct inputs *in, int64_t t_ms){
+    size_t lo = 0, hi = in->n;
+    while(hi - lo > 1){
+        size_t mid = lo + (hi - lo) / 2;
+        if(in->v[mid].ts_ms <= t_ms){
+            lo = mid;
+        }else{
+            hi = mid;
+        }
+    }
+    return lo;
+}
+
+// Events up to `to`; of those before `since` only the last one is kept
+static int loadEvents(const char *path, int64_t since, int64_t to, struct inputs *in){
+    struct csvlog log;
+    if(csvlog_open(&log, path)){
+        return -1;
+    }
+    int count = 0;
+    const char *p = log.data, *end = log.data + log.size;
+    while(p < end){
+        struct csvlog_event ev;
+        bool ok;
+        p = csvlog_next_event(p, end, &ev, &ok);
+        if(!ok || ev.ts_ms > to){
+            continue;
+        }
+        // Earlier events only set the levels at the start of the range
+        if(ev.ts_ms < since && in->n && in->v[in->n - 1].ts_ms < since){
+            in->n--;
+        }
+        pushInput(in, ev.ts_ms, false, ev.heater, ev.fan);
+        count += ev.ts_ms >= since;
+    }
+    csvlog_close(&log);
+    return count;
+}
+
+// Gaussian elimination with partial pivoting on n x n, in place
+static bool solve(int n, double a[X_COUNT][X_COUNT], double *b, double *x){
+    for(int c = 0; c < n; c++){
+        int pivot = c;
+        for(int r = c + 1; r < n; r++){
+            if(fabs(a[r][c]) > fabs(a[pivot][c])){
+                pivot = r;
+            }
+        }
+        if(fabs(a[pivot][c]) < 1e-12 * (fabs(a[c][c]) + 1)){
+            return false;
+        }
+        if(pivot != c){
+            for(int k = 0; k < n; k++){
+                double t = a[c][k];
+                a[c][k] = a[pivot][k];
+                a[pivot][k] = t;
+            }
+            double t = b[c];
+            b[c] = b[pivot];
+            b[pivot] = t;
+        }
+        for(int r = c + 1; r < n; r++){
+            double f = a[r][c] / a[c][c];
+            for(int k = c; k < n; k++){
+                a[r][k] -= f * a[c][k];
+            }
+            b[r] -= f * b[c];
+        }
+    }
+    for(int r = n - 1; r >= 0; r--){
+        double s = b[r];
+        for(int k = r + 1; k < n; k++){
+            s -= a[r][k] * x[k];
+        }
+        x[r] = s / a[r][r];
+    }
+    return true;
+}
+
+// Least squares on the regressors design[0..m-1] (combinations of the
+// window integrals) against X_Y. coef gets the coefficient of each window
+// integral; returns the residual sum of squares, or -1 if singular
+static double fit(const double g[X_COUNT][X_COUNT], const double design[][X_COUNT], int m, double coef[X_COUNT]){
+    double a[X_COUNT][X_COUNT], b[X_COUNT], x[X_COUNT];
+    for(int i = 0; i < m; i++){
+        for(int j = 0; j < m; j++){
+            a[i][j] = 0;
+            for(int k = 0; k < X_Y; k++){
+                for(int l = 0; l < X_Y; l++){
+                    a[i][j] += design[i][k] * g[k][l] * design[j][l];
+                }
+            }
+        }
+        b[i] = 0;
+        for(int k = 0; k < X_Y; k++){
+            b[i] += design[i][k] * g[k][X_Y];
+        }
+    }
+    double rhs[X_COUNT];
+    memcpy(rhs, b, sizeof(rhs));
+    if(!solve(m, a, rhs, x)){
+        return -1;
+    }
+    double sse = g[X_Y][X_Y];
+    for(int i = 0; i < m; i++){
+        sse -= x[i] * b[i];
+    }
+    for(int k = 0; k < X_Y; k++){
+        coef[k] = 0;
+        for(int i = 0; i < m; i++){
+            coef[k] += x[i] * design[i][k];
+        }
+    }
+    return sse > 0 ? sse : 0;
+}
+
+static int windowClass(double heater, double fan){
+    if(heater > 0 && fan == 0){
+        return 0;
+    }
+    if(fan > 0 && heater == 0){
+        return 1;
+    }
+    return heater == 0 && fan == 0 ? 2 : 3;
+}
+
+int main(int argc, char *argv[]){
+    const char *path = "./data.csv", *events_path = "./events.csv", *out_path = "planta.conf";
+    float histeresis = -1;
+    int max_dead_s = DEFAULT_MAX_DEAD_S;
+
+    int opt;
+    while((opt = getopt(argc, argv, "f:e:H:a:o:h")) != -1){
+        switch(opt){
+            case 'f': path = optarg; break;
+            case 'e': events_path = optarg; break;
+            case 'H': histeresis = atof(optarg); break;
+            case 'a': max_dead_s = atoi(optarg); break;
+            case 'o': out_path = optarg; break;
+            case 'h':
+                printUsage(argv[0]);
+                return 0;
+            default:
+                printUsage(argv[0]);
+                return 1;
+        }
+    }
+    int64_t from = INT64_MIN, to = INT64_MAX;
+    if(argc - optind == 2){
+        from = parseArgTime(argv[optind]);
+        to = parseArgTime(argv[optind + 1]);
+        if(from < 0 || to < 0 || to < from){
+            fprintf(stderr, "Intervalo inválido\n");
+            return 1;
+        }
+    }else if(argc != optind || max_dead_s < 0){
+        printUsage(argv[0]);
+        return 1;
+    }
+
+    struct timespec wall_start, wall_end;
+    clock_gettime(CLOCK_MONOTONIC, &wall_start);
+
+    struct csvlog log;
+    if(csvlog_open(&log, path)){
+        fprintf(stderr, "Não foi possivel abrir %s\n", path);
+        return 2;
+    }
+    const char *start = log.data, *end = log.data + log.size;
+    if(from != INT64_MIN){
+        char index_path[4096];
+        snprintf(index_path, sizeof(index_path), "%s.idx", path);
+        if(csvlog_index(&log, index_path)){
+            fprintf(stderr, "Aviso: índice %s indisponível, lendo o log inteiro\n", index_path);
+        }
+        start = log.data + csvlog_seek(&log, from);
+    }
+
+    // Inputs: events.csv or the hysteresis law replayed over TI and TR
+    struct inputs in = {0};
+    int events = -1;
+    if(histeresis < 0){
+        int64_t since = from == INT64_MIN ? from : from - (int64_t) max_dead_s * 1000;
+        events = loadEvents(events_path, since, to, &in);
+        if(events < 0){
+            fprintf(stderr, "Não foi possivel abrir %s; use -H para reconstruir as saídas pela histerese\n", events_path);
+            return 2;
+        }
+    }
+    struct controller hyst;
+    struct controller_config hyst_cfg = { .type = CONTROL_HYSTERESIS };
+    controller_init(&hyst, &hyst_cfg);
+
+    // First pass: gaps, TE range, TI noise and the rebuilt inputs
+    size_t samples = 0, gaps = 0, curvature_n = 0;
+    int64_t prev_ts = -1, first_ts = -1;
+    float te_min = 0, te_max = 0, first_ti = 0, ti1 = 0, ti2 = 0;
+    double te_sum = 0, curvature = 0, covered_ms = 0;
+    int run = 0; // consecutive samples without a gap
+    for(const char *p = start; p < end;){
+        struct csvlog_row row;
+        bool ok;
+        p = csvlog_next(p, end, &row, &ok);
+        if(!ok || row.ts_ms < from){
+            continue;
+        }
+        if(row.ts_ms > to){
+            break;
+        }
+        if(prev_ts >= 0 && row.ts_ms - prev_ts > MAX_GAP_MS){
+            gaps++;
+            run = 0;
+            // Outputs went off when the program stopped
+            pushInput(&in, prev_ts + 1000, true, 0, 0);
+            controller_reset(&hyst);
+        }else if(prev_ts >= 0){
+            covered_ms += row.ts_ms - prev_ts;
+        }
+        if(histeresis >= 0){
+            struct controller_input ci = { row.ts_ms, row.reference_temp, row.intern_temp, histeresis / 2, row.extern_temp };
+            bool heater = hyst.out.heater > 0, fan = hyst.out.fan > 0;
+            controller_update(&hyst, &ci);
+            if(samples == 0 || run == 0 || heater != (hyst.out.heater > 0) || fan != (hyst.out.fan > 0)){
+                pushInput(&in, row.ts_ms, false, hyst.out.heater, hyst.out.fan);
+            }
+        }
+        // Second difference of white noise has variance 6 sigma^2
+        if(run >= 2){
+            double d2 = row.intern_temp - 2 * ti1 + ti2;
+            curvature += d2 * d2;
+            curvature_n++;
+        }
+        ti2 = ti1;
+        ti1 = row.intern_temp;
+        run++;
+
+        if(!samples){
+            first_ts = row.ts_ms;
+            first_ti = row.intern_temp;
+            te_min = te_max = row.extern_temp;
+        }
+        te_min = row.extern_temp < te_min ? row.extern_temp : te_min;
+        te_max = row.extern_temp > te_max ? row.extern_temp : te_max;
+        te_sum += row.extern_temp;
+        samples++;
+        prev_ts = row.ts_ms;
+    }
+    if(!samples){
+        printf("Nenhuma amostra no intervalo\n");
+        csvlog_close(&log);
+        return 0;
+    }
+    integrateInputs(&in);
+
+    // Second pass: window integrals, normal equations per dead time
+    int dead_count = max_dead_s / DEAD_STEP_S + 1;
+    double (*g)[X_COUNT][X_COUNT] = calloc(dead_count, sizeof(*g));
+    if(!g){
+        fprintf(stderr, "Sem memória\n");
+        return 3;
+    }
+    struct window_stats ws = { .last_class = -1 };
+    size_t window_count = 0;
+    int64_t wa_ts = -1;
+    prev_ts = -1;
+    float wa_ti = 0, prev_ti = 0, prev_te = 0;
+    double int_ti = 0, int_te = 0;
+    for(const char *p = start; p < end;){
+        struct csvlog_row row;
+        bool ok;
+        p = csvlog_next(p, end, &row, &ok);
+        if(!ok || row.ts_ms < from){
+            continue;
+        }
+        if(row.ts_ms > to){
+            break;
+        }
+        if(prev_ts < 0 || row.ts_ms - prev_ts > MAX_GAP_MS){
+            // Start over after a gap
+            wa_ts = row.ts_ms;
+            wa_ti = row.intern_temp;
+            int_ti = int_te = 0;
+            ws.last_class = -1;
+        }else{
+            double dt = (row.ts_ms - prev_ts) / 1000.0;
+            int_ti += (row.intern_temp + prev_ti) / 2 * dt;
+            int_te += (row.extern_temp + prev_te) / 2 * dt;
+        }
+        prev_ts = row.ts_ms;
+        prev_ti = row.intern_temp;
+        prev_te = row.extern_temp;
+        if(row.ts_ms - wa_ts < WINDOW_S * 1000){
+            continue;
+        }
+
+        double x[X_COUNT];
+        x[X_T] = int_ti;
+        x[X_TE] = int_te;
+        x[X_1] = (row.ts_ms - wa_ts) / 1000.0;
+        x[X_Y] = row.intern_temp - wa_ti;
+        size_t ha = findStep(&in, wa_ts), hb = findStep(&in, row.ts_ms);
+        for(int k = 0; k < dead_count; k++){
+            int64_t dead_ms = (int64_t) k * DEAD_STEP_S * 1000;
+            double ha_heater, ha_fan, hb_heater, hb_fan;
+            cumulative(&in, wa_ts - dead_ms, &ha, &ha_heater, &ha_fan);
+            cumulative(&in, row.ts_ms - dead_ms, &hb, &hb_heater, &hb_fan);
+            x[X_H] = hb_heater - ha_heater;
+            x[X_F] = hb_fan - ha_fan;
+            if(k == 0){
+                int c = windowClass(x[X_H], x[X_F]);
+                ws.windows[c]++;
+                if(c != ws.last_class){
+                    ws.segments[c]++;
+                    ws.last_class = c;
+                }
+            }
+            for(int i = 0; i < X_COUNT; i++){
+                for(int j = i; j < X_COUNT; j++){
+                    g[k][i][j] += x[i] * x[j];
+                }
+            }
+        }
+        window_count++;
+        wa_ts = row.ts_ms;
+        wa_ti = row.intern_temp;
+        int_ti = int_te = 0;
+    }
+    for(int k = 0; k < dead_count; k++){
+        for(int i = 0; i < X_COUNT; i++){
+            for(int j = 0; j < i; j++){
+                g[k][i][j] = g[k][j][i];
+            }
+        }
+    }
+    csvlog_close(&log);
+
+    if(window_count < X_COUNT || g[0][X_H][X_H] == 0){
+        fprintf(stderr, "Dados insuficientes: é preciso ao menos um trecho com o resistor ligado\n");
+        return 4;
+    }
+    // Without TE variation its coupling is fixed at 1: regressor TE - T
+    bool te_free = te_max - te_min >= TE_MIN_RANGE;
+    bool fan_used = g[0][X_F][X_F] > 0;
+    double design[X_COUNT][X_COUNT];
+    int m = 0;
+    memset(design, 0, sizeof(design));
+    if(te_free){
+        design[m++][X_T] = 1;
+        design[m++][X_TE] = 1;
+    }else{
+        design[m][X_T] = -1;
+        design[m++][X_TE] = 1;
+    }
+    design[m++][X_H] = 1;
+    if(fan_used){
+        design[m++][X_F] = 1;
+    }
+    design[m++][X_1] = 1;
+
+    int best = -1;
+    double best_sse = 0, best_coef[X_COUNT], coef[X_COUNT];
+    for(int k = 0; k < dead_count; k++){
+        double sse = fit(g[k], design, m, coef);
+        if(sse >= 0 && (best < 0 || sse < best_sse)){
+            best = k;
+            best_sse = sse;
+            memcpy(best_coef, coef, sizeof(coef));
+        }
+    }
+    double sse0 = fit(g[0], design, m, coef);
+    free(g);
+    if(best < 0 || best_coef[X_T] >= 0 || best_coef[X_H] <= 0){
+        fprintf(stderr, "O ajuste não tem sentido físico (constante de tempo ou ganho do resistor <= 0)\n");
+        return 4;
+    }
+
+    struct plant_model model;
+    plant_model_defaults(&model);
+    double tau = -1 / best_coef[X_T];
+    double coupling = best_coef[X_TE] * tau;
+    double offset = best_coef[X_1] * tau;
+    double te_mean = te_sum / samples;
+    model.tau_s = (float) tau;
+    model.dead_s = (float) best * DEAD_STEP_S;
+    model.gain_heater = (float) (best_coef[X_H] * tau);
+    if(fan_used){
+        model.gain_fan = (float) (-best_coef[X_F] * tau);
+    }
+    model.ambient = (float) (coupling * te_mean + offset);
+    model.ambient_amplitude = (float) (coupling * (te_max - te_min) / 2);
+    model.noise = curvature_n ? (float) sqrt(curvature / curvature_n / 6) : 0;
+    model.initial = first_ti;
+
+    clock_gettime(CLOCK_MONOTONIC, &wall_end);
+    double wall = (wall_end.tv_sec - wall_start.tv_sec) + (wall_end.tv_nsec - wall_start.tv_nsec) / 1e9;
+    double residual = sqrt(best_sse / window_count);
+
+    printf("Amostras: %zu em %.1f h de log (%zu lacunas), processadas em %.2f s\n", samples,
+        covered_ms / 3600000.0, gaps, wall);
+    if(events >= 0){
+        printf("Entradas: %d eventos de %s\n", events, events_path);
+    }else{
+        printf("Entradas: reconstruídas pela histerese %.2f oC\n", histeresis);
+    }
+    printf("Janelas de %d s: %zu\n", WINDOW_S, window_count);
+    for(int c = 0; c < WINDOW_CLASSES; c++){
+        printf("  %-13s %zu trechos, %.1f h\n", CLASS_NAMES[c], ws.segments[c], ws.windows[c] * WINDOW_S / 3600.0);
+    }
+    printf("Resíduo: %.3f oC por janela (sem atraso: %.3f oC)\n", residual,
+        sse0 >= 0 ? sqrt(sse0 / window_count) : NAN);
+    printf("Modelo: tau %.0f s, atraso %.0f s, ganhos %.1f / %.1f oC%s\n", model.tau_s, model.dead_s,
+        model.gain_heater, model.gain_fan, fan_used ? "" : " (ventoinha sem uso: ganho padrão)");
+    if(te_free){
+        printf("TE: acoplamento %.2f, deslocamento %+.2f oC; ambiente efetivo %.1f +- %.1f oC\n", coupling, offset,
+            model.ambient, model.ambient_amplitude);
+    }else{
+        printf("TE: variação de %.2f oC, acoplamento fixo em 1, deslocamento %+.2f oC\n", te_max - te_min, offset);
+    }
+    printf("Ruído de TI: %.3f oC\n", model.noise);
+
+    char comment[160];
+    struct tm tm;
+    time_t first = (time_t) (first_ts / 1000);
+    char date[32];
+    localtime_r(&first, &tm);
+    strftime(date, sizeof(date), "%Y-%m-%d %H:%M", &tm);
+    snprintf(comment, sizeof(comment), "plantid: %s desde %s, %zu janelas, resíduo %.3f oC, acoplamento TE %.2f",
+        path, date, window_count, residual, te_free ? coupling : 1.0);
+    if(plant_model_save(out_path, &model, comment)){
+        fprintf(stderr, "Não foi possivel gravar %s\n", out_path);
+        return 2;
+    }
+    printf("Modelo gravado em %s\n", out_path);
+    free(in.v);
+    return 0;
+}
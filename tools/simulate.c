@@ -0,0 +1,343 @@
+/*
+* Closed-loop simulation of the chamber.
+*
+* Usage: simulate [-c controle.conf] [-m planta.conf] [-n horas] [-r TR] [-H histerese]
+*                 [-s "h:TR,h:TR,..."] [-x fator] [-o trace.csv] [-S semente]
+*
+* The program's own acquisition and control (loop.c: BME280 TE, UART TI and
+* TR, input filters, control.c, pwm.c, actuator.c, logger.c) run on the
+* simulated HAL (hal_sim.c, the FOPDT plant of plant.c) and a virtual clock.
+* Each tick is one pass of watchSensors and handleGPIO; pwm_advance then
+* moves the clock to the next tick, writing the PWM edges on the way.
+* Without -x the simulation runs as fast as the CPU allows.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <math.h>
+#include <time.h>
+
+#include <control.h>
+#include <config.h>
+#include <filter.h>
+#include <hal.h>
+#include <hal_sim.h>
+#include <logger.h>
+#include <loop.h>
+#include <metrics.h>
+#include <plant.h>
+#include <pwm.h>
+#include <state.h>
+#include <vclock.h>
+
+#define CONTROL_TICK_MS 500 // acquisition period of watchSensors
+#define STEADY_AFTER_S 3600 // steady state: from this long after each setpoint step
+#define MAX_STEPS 64
+
+struct setpoint_step {
+    double at_s;
+    float reference;
+};
+
+static void printUsage(const char *name){
+    printf("Uso: %s [-c arquivo] [-m modelo] [-n horas] [-r TR] [-H histerese] [-s agenda] [-x fator] [-o trace.csv] [-S semente]\n", name);
+    printf("  -c  Configuração do controlador (controle, kp, ki, kd, referencia, histerese, ...)\n");
+    printf("  -m  Modelo da planta (padrão: modelo interno, ver plant.h)\n");
+    printf("  -n  Horas simuladas (padrão: 24)\n");
+    printf("  -r  Temperatura de referência (padrão: configuração ou 40)\n");
+    printf("  -H  Histerese; a faixa de acomodação é TR +- H/2 (padrão: configuração ou 1)\n");
+    printf("  -s  Agenda de referências \"hora:TR,...\" (ex.: \"0:35,6:45,12:30\")\n");
+    printf("  -x  Velocidade em relação ao tempo real (padrão: máxima)\n");
+    printf("  -o  Grava a trajetória em CSV\n");
+    printf("  -S  Semente do ruído de medida\n");
+}
+
+static int parseSchedule(const char *s, struct setpoint_step *steps){
+    int n = 0;
+    while(*s && n < MAX_STEPS){
+        double hour;
+        float reference;
+        int used;
+        if(sscanf(s, "%lf:%f%n", &hour, &reference, &used) != 2 || hour < 0){
+            return -1;
+        }
+        steps[n].at_s = hour * 3600;
+        steps[n].reference = reference;
+        n++;
+        s += used;
+        if(*s == ','){
+            s++;
+        }else if(*s){
+            return -1;
+        }
+    }
+    return n;
+}
+
+static void printStep(int i, const struct metrics_step *s){
+    float settling = metrics_settling_s(s);
+    printf("  %2d  %6.2f h  %6.2f -> %6.2f  sobressinal %5.2f oC  ", i, s->start_ms / 3600000.0,
+        s->from, s->reference, s->overshoot);
+    if(settling < 0){
+        printf("não acomodou em %.0f s\n", (s->end_ms - s->start_ms) / 1000.0);
+    }else{
+        printf("acomodação %.0f s\n", settling);
+    }
+}
+
+int main(int argc, char *argv[]){
+    const char *config_path = NULL, *model_path = NULL, *trace_path = NULL, *schedule = NULL;
+    double hours = 24, speed = 0;
+    float cli_reference = NAN, cli_histeresis = NAN;
+    uint64_t seed = 1;
+
+    int opt;
+    while((opt = getopt(argc, argv, "c:m:n:r:H:s:x:o:S:h")) != -1){
+        switch(opt){
+            case 'c': config_path = optarg; break;
+            case 'm': model_path = optarg; break;
+            case 'n': hours = atof(optarg); break;
+            case 'r': cli_reference = atof(optarg); break;
+            case 'H': cli_histeresis = atof(optarg); break;
+            case 's': schedule = optarg; break;
+            case 'x': speed = atof(optarg); break;
+            case 'o': trace_path = optarg; break;
+            case 'S': seed = strtoull(optarg, NULL, 10); break;
+            case 'h':
+                printUsage(argv[0]);
+                return 0;
+            default:
+                printUsage(argv[0]);
+                return 1;
+        }
+    }
+    if(hours <= 0){
+        printUsage(argv[0]);
+        return 1;
+    }
+
+    struct config cfg;
+    config_defaults(&cfg);
+    if(config_path){
+        int res = config_load(config_path, &cfg);
+        if(res){
+            fprintf(stderr, res < 0 ? "Não foi possivel abrir %s\n" : "Configuração inválida em %s:%d\n", config_path, res);
+            return 1;
+        }
+    }
+    float reference = !isnan(cli_reference) ? cli_reference : (cfg.has_reference ? cfg.reference_temp : 40);
+    float histeresis = !isnan(cli_histeresis) ? cli_histeresis : (cfg.has_histeresis ? cfg.histeresis_temp : 1);
+    float band = histeresis / 2 > METRICS_MIN_BAND ? histeresis / 2 : METRICS_MIN_BAND;
+
+    struct setpoint_step steps[MAX_STEPS];
+    int step_count = 1;
+    steps[0].at_s = 0;
+    steps[0].reference = reference;
+    if(schedule && (step_count = parseSchedule(schedule, steps)) <= 0){
+        fprintf(stderr, "Agenda inválida: %s\n", schedule);
+        return 1;
+    }
+
+    struct plant_model model;
+    plant_model_defaults(&model);
+    if(model_path){
+        int res = plant_model_load(model_path, &model);
+        if(res){
+            fprintf(stderr, res < 0 ? "Não foi possivel abrir %s\n" : "Modelo inválido em %s:%d\n", model_path, res);
+            return 1;
+        }
+    }
+
+    FILE *trace = NULL;
+    if(trace_path){
+        trace = fopen(trace_path, "w");
+        if(!trace){
+            fprintf(stderr, "Não foi possivel abrir %s\n", trace_path);
+            return 1;
+        }
+        fprintf(trace, "t_s,tr,ti,te,resistor,ventoinha,estado\n");
+    }
+
+    // As main.c with -s, on the virtual clock
+    vclock_enable_virtual(0);
+    hal_select("sim");
+    hal_sim_configure(&model, reference, seed);
+    thermal_model = model;
+    filter_init(&ti_filter, &cfg.filter_ti);
+    filter_init(&tr_filter, &cfg.filter_tr);
+    input_mode = cfg.has_input_mode ? cfg.input_mode : KEYBOARD_INPUT;
+    reference_temp = reference;
+    histeresis_temp = histeresis;
+    reference_temp_ready = histeresis_temp_ready = running = true;
+    sample_init(false);
+    int8_t rslt;
+    if(loop_sensor_open(&rslt)){
+        fprintf(stderr, "Falha na inicialização do BME280 simulado (%+d)\n", rslt);
+        return 1;
+    }
+    // Only its counters are reported
+    if(logger_start("/dev/null", "/dev/null", NULL, NULL)){
+        fprintf(stderr, "Não foi possivel iniciar o log\n");
+        return 1;
+    }
+    cfg.control.gains_path = NULL;
+    cfg.control.model = model;
+    cfg.control.raw_compare = filter_enabled(&cfg.filter_ti) || filter_enabled(&cfg.filter_tr);
+    hal->gpio->init();
+    control_init(&cfg.control);
+
+    struct timespec wall_start, wall_now;
+    clock_gettime(CLOCK_MONOTONIC, &wall_start);
+
+    // Metrics on the true chamber temperature, one closed step per schedule entry
+    struct metrics metrics;
+    struct metrics_step done[MAX_STEPS];
+    struct actuator_stats last_a = {0}, a;
+    int current = -1, closed = 0;
+    double steady_s = 0, steady_abs = 0, steady_sum = 0;
+    double tick_s = CONTROL_TICK_MS / 1000.0;
+    float temp, ambient;
+    metrics_init(&metrics);
+    int64_t ticks = (int64_t) (hours * 3600 / tick_s);
+
+    for(int64_t k = 0; k < ticks; k++){
+        double t = k * tick_s;
+        if(current + 1 < step_count && t >= steps[current + 1].at_s){
+            current++;
+            reference = steps[current].reference;
+            if(input_mode == POTENTIOMETER_INPUT){
+                hal_sim_set_potentiometer(reference);
+            }else{
+                reference_temp = reference;
+            }
+            if(current){
+                metrics_split(&metrics);
+            }
+        }
+        if(k == 0){
+            hal_sim_temperatures(&temp, &ambient);
+            struct metrics_input start = { 0, reference, temp, band, 0, 0, 0, 0 };
+            metrics_update(&metrics, &start, NULL);
+        }
+
+        // watchSensors + handleGPIO, one pass each
+        struct sample s;
+        if(loop_acquire() != BME280_OK || !sample_latest(&s)){
+            fprintf(stderr, "Falha na leitura do BME280 simulado\n");
+            return 1;
+        }
+        int state = loop_control(SAMPLE_WAKE_NEW, &s);
+        if(trace){
+            float heater, fan;
+            control_get_outputs(&heater, &fan);
+            fprintf(trace, "%.1f,%.2f,%.3f,%.3f,%.2f,%.2f,%d\n", t, reference_temp, intern_temp,
+                extern_temp, heater, fan, state);
+        }
+        pwm_advance((int64_t) CONTROL_TICK_MS * 1000000);
+
+        // Over the tick just simulated: the true chamber temperature and
+        // what the pins did, PWM edges included
+        hal_sim_temperatures(&temp, &ambient);
+        actuator_get_stats(&a);
+        struct metrics_input mi;
+        mi.t_ms = (k + 1) * (int64_t) CONTROL_TICK_MS;
+        mi.reference = reference;
+        mi.temp = temp;
+        mi.band = band;
+        mi.heater = (float) (a.out[ACTUATOR_HEATER].on_ms - last_a.out[ACTUATOR_HEATER].on_ms) / CONTROL_TICK_MS;
+        mi.fan = (float) (a.out[ACTUATOR_FAN].on_ms - last_a.out[ACTUATOR_FAN].on_ms) / CONTROL_TICK_MS;
+        mi.heater_transitions = a.out[ACTUATOR_HEATER].transitions - last_a.out[ACTUATOR_HEATER].transitions;
+        mi.fan_transitions = a.out[ACTUATOR_FAN].transitions - last_a.out[ACTUATOR_FAN].transitions;
+        last_a = a;
+        if(t - steps[current].at_s >= STEADY_AFTER_S){
+            steady_s += tick_s;
+            steady_sum += (reference - temp) * tick_s;
+            steady_abs += fabs(reference - temp) * tick_s;
+        }
+        if(metrics_update(&metrics, &mi, closed < MAX_STEPS ? &done[closed] : NULL) && closed < MAX_STEPS){
+            closed++;
+        }
+
+        if(speed > 0){
+            // Pace the virtual clock at speed x real time
+            clock_gettime(CLOCK_MONOTONIC, &wall_now);
+            double wall = (wall_now.tv_sec - wall_start.tv_sec) + (wall_now.tv_nsec - wall_start.tv_nsec) / 1e9;
+            double ahead = (t + tick_s) / speed - wall;
+            if(ahead > 0.001){
+                usleep((useconds_t) (ahead * 1e6));
+            }
+        }
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &wall_now);
+    double wall = (wall_now.tv_sec - wall_start.tv_sec) + (wall_now.tv_nsec - wall_start.tv_nsec) / 1e9;
+    double total_s = ticks * tick_s;
+
+    struct control_status status;
+    control_get_status(&status);
+    const struct metrics_totals *m = &metrics.total;
+    control_shutdown();
+    // Everything pushed is either written or dropped once stopped
+    struct log_stats log;
+    logger_stop();
+    logger_get_stats(&log);
+
+    printf("Simulação: %.1f h em %.2f s (%.0fx o tempo real)\n", total_s / 3600, wall, wall > 0 ? total_s / wall : 0);
+    printf("Controle: %s, histerese %.2f oC, faixa TR +- %.2f oC\n",
+        status.mode == CONTROL_PID ? "PID" : status.mode == CONTROL_SMITH ? "Smith" : "histerese", histeresis, band);
+    printf("Planta: tau %.0f s, atraso %.0f s, ganhos %.1f / %.1f oC, ambiente %.1f +- %.1f oC\n",
+        model.tau_s, model.dead_s, model.gain_heater, model.gain_fan, model.ambient, model.ambient_amplitude);
+    printf("IAE: %.1f oC.s\n", m->iae);
+    printf("ISE: %.1f oC2.s\n", m->ise);
+    printf("ITAE: %.4g oC.s2\n", m->itae);
+    printf("Dentro da faixa: %.1f%%\n", total_s > 0 ? 100 * m->in_band_s / total_s : 0);
+    if(steady_s > 0){
+        printf("Erro em regime (a partir de %d min de cada degrau): médio %+.3f oC, absoluto médio %.3f oC\n",
+            STEADY_AFTER_S / 60, steady_sum / steady_s, steady_abs / steady_s);
+    }
+    printf("Resistor: %.1f%% do tempo, %llu transições\n", 100 * m->heater_s / total_s,
+        (unsigned long long) m->heater_transitions);
+    printf("Ventoinha: %.1f%% do tempo, %llu transições\n", 100 * m->fan_s / total_s,
+        (unsigned long long) m->fan_transitions);
+    printf("Comutações por hora: %.1f\n", (m->heater_transitions + m->fan_transitions) / (total_s / 3600));
+    printf("Eventos enviados ao log: %llu\n", (unsigned long long) (log.events_written + log.events_dropped));
+    if(status.timing.iterations){
+        printf("Cálculo do controle: média %.2f us, máximo %.2f us (%llu iterações)\n",
+            status.timing.sum_ns / 1000.0 / status.timing.iterations, status.timing.max_ns / 1000.0,
+            (unsigned long long) status.timing.iterations);
+    }
+    if(filter_enabled(&cfg.filter_ti)){
+        printf("Filtro de TI: %llu amostras rejeitadas; comutações %llu sem filtro, %llu com filtro\n",
+            (unsigned long long) ti_filter.stats.rejected, (unsigned long long) status.switches_unfiltered,
+            (unsigned long long) status.switches_filtered);
+    }
+    printf("Degraus de referência:\n");
+    for(int i = 0; i < closed; i++){
+        printStep(i, &done[i]);
+    }
+    printStep(closed, &metrics.step);
+    if(status.autotune_status == AUTOTUNE_DONE){
+        printf("Auto-sintonia (%s): Ku %.4f, Pu %.1f s -> kp %.4f ki %.6f kd %.3f, acomodação esperada %.0f s\n",
+            autotune_rule_name(status.autotune_rule), status.autotune.ku, status.autotune.period_s,
+            status.autotune.kp, status.autotune.ki, status.autotune.kd, status.autotune.settling_s);
+    }else if(status.autotune_status == AUTOTUNE_FAILED){
+        printf("Auto-sintonia: sem oscilação válida\n");
+    }
+    for(int i = 0; i < status.shadows; i++){
+        const struct control_shadow_status *sh = &status.shadow[i];
+        printf("Sombra %d (%s", i + 1, controller_name(sh->type));
+        if(sh->type == CONTROL_PID){
+            printf(" kp %.4f ki %.6f kd %.3f", sh->config.pid.kp, sh->config.pid.ki, sh->config.pid.kd);
+        }
+        printf("): divergência média %.3f, resistor %.1f%%, ventoinha %.1f%%, %.1f comutações/h\n",
+            sh->divergence, sh->metrics_total.heater_duty * 100, sh->metrics_total.fan_duty * 100,
+            sh->metrics_total.switches_per_hour);
+    }
+
+    if(trace){
+        fclose(trace);
+    }
+    return 0;
+}
@@ -0,0 +1,352 @@
+/*
+* Range queries over data.csv.
+*
+* Usage: tlquery [-f data.csv | -g data.gor | -t tiers.bin] [-c ti|te|tr] [-H histerese] INICIO FIM
+* INICIO and FIM are local times as "AAAA-MM-DD HH:MM[:SS]".
+*
+* The log is memory-mapped and a sparse time index (data.csv.idx) is built
+* or extended on each run, so only the requested range is parsed. With -g
+* the compressed blocks are decoded instead, skipping the blocks that start
+* after FIM; the statistics are the same as for the CSV. With -t the
+* aggregates of the tier store are read: only the finest tier still
+* holding INICIO is touched, and there are no percentiles.
+*/
+
+#define _XOPEN_SOURCE 700
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include <csvlog.h>
+#include <gorilla.h>
+#include <tiers.h>
+
+// Gaps longer than this (program stopped) do not count as time in band
+#define MAX_GAP_MS 10000
+
+static const double PERCENTILES[] = { 1, 5, 25, 50, 75, 95, 99 };
+
+static void printUsage(const char *name){
+    printf("Uso: %s [-f arquivo | -g arquivo | -t arquivo] [-c ti|te|tr] [-H histerese] INICIO FIM\n", name);
+    printf("  INICIO e FIM no formato \"AAAA-MM-DD HH:MM[:SS]\" (hora local)\n");
+    printf("  -f  Log a consultar (padrão: ./data.csv)\n");
+    printf("  -g  Consulta os blocos comprimidos (data.gor)\n");
+    printf("  -t  Consulta os agregados do armazenamento em camadas (tiers.bin)\n");
+    printf("  -c  Canal: ti (padrão), te ou tr\n");
+    printf("  -H  Histerese para o tempo dentro da faixa TR +- H/2\n");
+}
+
+static int64_t parseArgTime(const char *s){
+    struct tm tm;
+    memset(&tm, 0, sizeof(tm));
+    const char *rest = strptime(s, "%Y-%m-%d %H:%M:%S", &tm);
+    if(!rest){
+        memset(&tm, 0, sizeof(tm));
+        rest = strptime(s, "%Y-%m-%d %H:%M", &tm);
+    }
+    if(!rest || *rest){
+        return -1;
+    }
+    tm.tm_isdst = -1;
+    return (int64_t) mktime(&tm) * 1000;
+}
+
+static int queryTiers(const char *path, int channel, int64_t from, int64_t to){
+    if(tiers_open_readonly(path)){
+        fprintf(stderr, "Não foi possivel abrir %s\n", path);
+        return 2;
+    }
+    struct tier_result res;
+    int tier = tiers_query(from, to, channel, &res);
+    tiers_close();
+    if(tier < 0 || res.count == 0){
+        printf("Nenhuma amostra no intervalo\n");
+        return 0;
+    }
+    int64_t width = tiers_resolution_ms(tier);
+    if(width){
+        printf("Camada: %lld s por balde\n", (long long) (width / 1000));
+    }else{
+        printf("Camada: amostras\n");
+    }
+    time_t first = res.first_ms / 1000, last = res.last_ms / 1000;
+    char first_s[32], last_s[32];
+    strftime(first_s, sizeof(first_s), "%Y-%m-%d %H:%M:%S", localtime(&first));
+    strftime(last_s, sizeof(last_s), "%Y-%m-%d %H:%M:%S", localtime(&last));
+    printf("Baldes de %s a %s\n", first_s, last_s);
+    printf("Amostras: %llu\n", (unsigned long long) res.count);
+    printf("Mínimo: %.2f oC\n", res.min);
+    printf("Máximo: %.2f oC\n", res.max);
+    printf("Média: %.3f oC\n", res.mean);
+    printf("Último: %.2f oC\n", res.last);
+    return 0;
+}
+
+static int compareFloat(const void *a, const void *b){
+    float x = *(const float *) a, y = *(const float *) b;
+    return (x > y) - (x < y);
+}
+
+// Samples of the range, fed in time order from either log
+struct stats {
+    float *values;
+    size_t n;
+    size_t cap;
+    double sum;
+    float min;
+    float max;
+    float histeresis; // < 0: no time in band
+    int64_t in_band_ms;
+    int64_t covered_ms;
+    int64_t prev_ts;
+    bool prev_in_band;
+};
+
+static int statsInit(struct stats *st, float histeresis){
+    memset(st, 0, sizeof(*st));
+    st->cap = 1 << 16;
+    st->values = malloc(st->cap * sizeof(float));
+    st->histeresis = histeresis;
+    st->prev_ts = -1;
+    return st->values ? 0 : -1;
+}
+
+static int statsAdd(struct stats *st, int64_t ts_ms, float v, float reference){
+    if(st->n == st->cap){
+        float *grown = realloc(st->values, st->cap * 2 * sizeof(float));
+        if(!grown){
+            return -1;
+        }
+        st->values = grown;
+        st->cap *= 2;
+    }
+    st->values[st->n++] = v;
+    st->sum += v;
+    if(st->n == 1 || v < st->min){
+        st->min = v;
+    }
+    if(st->n == 1 || v > st->max){
+        st->max = v;
+    }
+
+    // Each sample holds until the next one
+    if(st->prev_ts >= 0 && ts_ms - st->prev_ts <= MAX_GAP_MS){
+        st->covered_ms += ts_ms - st->prev_ts;
+        if(st->prev_in_band){
+            st->in_band_ms += ts_ms - st->prev_ts;
+        }
+    }
+    st->prev_ts = ts_ms;
+    st->prev_in_band = st->histeresis >= 0 && v >= reference - st->histeresis / 2
+        && v <= reference + st->histeresis / 2;
+    return 0;
+}
+
+static void statsPrint(struct stats *st){
+    if(st->n == 0){
+        printf("Nenhuma amostra no intervalo\n");
+        return;
+    }
+    size_t n = st->n;
+    qsort(st->values, n, sizeof(float), compareFloat);
+    printf("Amostras: %zu\n", n);
+    printf("Mínimo: %.2f oC\n", st->min);
+    printf("Máximo: %.2f oC\n", st->max);
+    printf("Média: %.3f oC\n", st->sum / n);
+    for(size_t i = 0; i < sizeof(PERCENTILES) / sizeof(PERCENTILES[0]); i++){
+        size_t k = (size_t) (PERCENTILES[i] / 100.0 * (n - 1) + 0.5);
+        printf("P%02.0f: %.2f oC\n", PERCENTILES[i], st->values[k]);
+    }
+    if(st->histeresis >= 0){
+        printf("Dentro da faixa TR +- %.2f: %.0f s de %.0f s (%.1f%%)\n", st->histeresis / 2,
+            st->in_band_ms / 1000.0, st->covered_ms / 1000.0,
+            st->covered_ms ? 100.0 * st->in_band_ms / st->covered_ms : 0.0);
+    }
+}
+
+static float rowValue(const struct csvlog_row *row, int channel){
+    if(channel == TIER_CH_TE){
+        return row->extern_temp;
+    }
+    if(channel == TIER_CH_TR){
+        return row->reference_temp;
+    }
+    return row->intern_temp;
+}
+
+static int queryCsv(const char *path, int channel, int64_t from, int64_t to, struct stats *st){
+    struct csvlog log;
+    if(csvlog_open(&log, path)){
+        fprintf(stderr, "Não foi possivel abrir %s\n", path);
+        return 2;
+    }
+    char index_path[4096];
+    snprintf(index_path, sizeof(index_path), "%s.idx", path);
+    if(csvlog_index(&log, index_path)){
+        fprintf(stderr, "Aviso: índice %s indisponível, lendo o log inteiro\n", index_path);
+    }
+
+    int ret = 0;
+    const char *p = log.data + csvlog_seek(&log, from);
+    const char *end = log.data + log.size;
+    while(p < end){
+        struct csvlog_row row;
+        bool ok;
+        p = csvlog_next(p, end, &row, &ok);
+        if(!ok || row.ts_ms < from){
+            continue;
+        }
+        if(row.ts_ms > to){
+            break;
+        }
+        if(statsAdd(st, row.ts_ms, rowValue(&row, channel), row.reference_temp)){
+            fprintf(stderr, "Sem memória\n");
+            ret = 3;
+            break;
+        }
+    }
+    csvlog_close(&log);
+    return ret;
+}
+
+// Blocks as the logger appends them: TR, TI, TE per sample
+static int queryGorilla(const char *path, int channel, int64_t from, int64_t to, struct stats *st){
+    int fd = open(path, O_RDONLY);
+    struct stat sb;
+    if(fd < 0 || fstat(fd, &sb) < 0){
+        fprintf(stderr, "Não foi possivel abrir %s\n", path);
+        if(fd >= 0){
+            close(fd);
+        }
+        return 2;
+    }
+    size_t size = (size_t) sb.st_size;
+    const uint8_t *data = size ? mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0) : NULL;
+    close(fd);
+    if(data == MAP_FAILED){
+        fprintf(stderr, "Não foi possivel abrir %s\n", path);
+        return 2;
+    }
+
+    static int64_t ts[GORILLA_BLOCK_SAMPLES];
+    static float values[GORILLA_BLOCK_SAMPLES * GORILLA_MAX_CHANNELS];
+    int column = channel == TIER_CH_TR ? 0 : channel == TIER_CH_TI ? 1 : 2;
+    int ret = 0;
+    size_t pos = 0;
+    while(pos < size && !ret){
+        struct gorilla_block_info info;
+        if(gorilla_block_info(data + pos, size - pos, &info)){
+            // Truncated by a crash while appending: the rest is unreadable
+            fprintf(stderr, "Aviso: bloco inválido no byte %zu de %s, ignorando o resto\n", pos, path);
+            break;
+        }
+        size_t next = pos + info.size;
+        if(info.t0 > to || info.channels != 3){
+            pos = next;
+            continue;
+        }
+        int n = gorilla_decode(data + pos, size - pos, ts, values, GORILLA_BLOCK_SAMPLES);
+        if(n < 0){
+            fprintf(stderr, "Aviso: bloco inválido no byte %zu de %s\n", pos, path);
+            pos = next;
+            continue;
+        }
+        for(int i = 0; i < n; i++){
+            if(ts[i] < from || ts[i] > to){
+                continue;
+            }
+            if(statsAdd(st, ts[i], values[i * 3 + column], values[i * 3])){
+                fprintf(stderr, "Sem memória\n");
+                ret = 3;
+                break;
+            }
+        }
+        pos = next;
+    }
+    if(size){
+        munmap((void *) data, size);
+    }
+    return ret;
+}
+
+int main(int argc, char *argv[]){
+    const char *path = "./data.csv";
+    const char *gorilla_path = NULL;
+    const char *tiers_path = NULL;
+    int channel = TIER_CH_TI;
+    float histeresis = -1;
+
+    int opt;
+    while((opt = getopt(argc, argv, "f:g:t:c:H:h")) != -1){
+        switch(opt){
+            case 'f':
+                path = optarg;
+                break;
+            case 'g':
+                gorilla_path = optarg;
+                break;
+            case 't':
+                tiers_path = optarg;
+                break;
+            case 'c':
+                if(!strcmp(optarg, "ti")){
+                    channel = TIER_CH_TI;
+                }else if(!strcmp(optarg, "te")){
+                    channel = TIER_CH_TE;
+                }else if(!strcmp(optarg, "tr")){
+                    channel = TIER_CH_TR;
+                }else{
+                    printUsage(argv[0]);
+                    return 1;
+                }
+                break;
+            case 'H':
+                histeresis = atof(optarg);
+                break;
+            case 'h':
+                printUsage(argv[0]);
+                return 0;
+            default:
+                printUsage(argv[0]);
+                return 1;
+        }
+    }
+    if(argc - optind != 2){
+        printUsage(argv[0]);
+        return 1;
+    }
+    int64_t from = parseArgTime(argv[optind]);
+    int64_t to = parseArgTime(argv[optind + 1]);
+    if(from < 0 || to < 0 || to < from){
+        fprintf(stderr, "Intervalo inválido\n");
+        return 1;
+    }
+    if(tiers_path){
+        // data.csv keeps whole seconds: FIM includes its whole second there too
+        return queryTiers(tiers_path, channel, from, to + 999);
+    }
+
+    struct stats st;
+    if(statsInit(&st, histeresis)){
+        fprintf(stderr, "Sem memória\n");
+        return 3;
+    }
+    int ret;
+    if(gorilla_path){
+        // Millisecond timestamps: FIM includes its whole second, as in data.csv
+        ret = queryGorilla(gorilla_path, channel, from, to + 999, &st);
+    }else{
+        ret = queryCsv(path, channel, from, to, &st);
+    }
+    if(!ret){
+        statsPrint(&st);
+    }
+    free(st.values);
+    return ret;
+}